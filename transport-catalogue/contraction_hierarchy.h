@@ -0,0 +1,466 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// ContractionHierarchyRouter ------------------------------------------------------------------
+// Иерархия сжатия (Contraction Hierarchies). При построении вершины по одной стягиваются
+// в порядке возрастания важности; чтобы расстояния между оставшимися вершинами не изменились,
+// вместо путей через стянутую вершину добавляются рёбра-сокращения. Запрос - двунаправленный
+// поиск Дейкстры только по рёбрам, ведущим к более важным вершинам, поэтому просматривается
+// малая часть графа. Память линейна относительно числа рёбер и сокращений; найденный путь
+// разворачивается в исходные рёбра графа.
+template <typename Weight>
+class ContractionHierarchyRouter {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    // ребро-сокращение: путь из двух рёбер иерархии first и second
+    struct Shortcut {
+        VertexId from;
+        VertexId to;
+        Weight weight;
+        EdgeId first;
+        EdgeId second;
+    };
+
+    // Рёбра иерархии нумеруются так: id меньше числа рёбер графа - исходные рёбра,
+    // остальные - сокращения shortcuts[id - число рёбер графа]
+    // массивы иерархии могут лежать в чужой памяти, например в базе, отображённой в память
+    struct Hierarchy {
+        ranges::FrozenArray<Shortcut> shortcuts;
+        // рёбра из вершины v к более важным вершинам (прямой поиск):
+        // upward_edges[upward_offsets[v]] .. upward_edges[upward_offsets[v + 1] - 1]
+        ranges::FrozenArray<size_t> upward_offsets;
+        ranges::FrozenArray<EdgeId> upward_edges;
+        // рёбра в вершину v из более важных вершин (обратный поиск)
+        ranges::FrozenArray<size_t> downward_offsets;
+        ranges::FrozenArray<EdgeId> downward_edges;
+    };
+
+    struct BuildStatistics {
+        std::chrono::nanoseconds duration{0};
+        size_t shortcut_count = 0;
+    };
+
+    // cancel - необязательный флаг отмены: при его установке построение прерывается
+    // исключением BuildCancelled
+    explicit ContractionHierarchyRouter(const Graph& graph, const std::atomic<bool>* cancel = nullptr);
+    // Восстанавливает маршрутизатор по ранее построенной иерархии (без повторного построения)
+    ContractionHierarchyRouter(const Graph& graph, Hierarchy hierarchy);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+
+    const Hierarchy& GetHierarchy() const {
+        return hierarchy_;
+    }
+
+    const BuildStatistics& GetBuildStatistics() const {
+        return build_statistics_;
+    }
+
+    SearchStatistics GetSearchStatistics() const {
+        return {queries_.load(), settled_vertices_.load()};
+    }
+
+private:
+    // ребро оставшегося (ещё не стянутого) графа при построении
+    struct Arc {
+        VertexId vertex;
+        Weight weight;
+        EdgeId edge;
+    };
+    using QueueItem = std::pair<Weight, VertexId>;
+    using Queue = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>;
+
+    // сколько вершин может просмотреть поиск свидетеля, прежде чем сокращение будет добавлено
+    // без проверки; лишнее сокращение не нарушает корректность, а только увеличивает иерархию
+    static constexpr size_t WITNESS_SEARCH_LIMIT = 500;
+
+    class Builder;
+
+    void CheckHierarchy() const;
+
+    VertexId GetEdgeFrom(EdgeId edge_id) const {
+        return edge_id < graph_.GetEdgeCount() ? graph_.GetEdge(edge_id).from
+                                               : hierarchy_.shortcuts[edge_id - graph_.GetEdgeCount()].from;
+    }
+    VertexId GetEdgeTo(EdgeId edge_id) const {
+        return edge_id < graph_.GetEdgeCount() ? graph_.GetEdge(edge_id).to
+                                               : hierarchy_.shortcuts[edge_id - graph_.GetEdgeCount()].to;
+    }
+    Weight GetEdgeWeight(EdgeId edge_id) const {
+        return edge_id < graph_.GetEdgeCount() ? graph_.GetEdge(edge_id).weight
+                                               : hierarchy_.shortcuts[edge_id - graph_.GetEdgeCount()].weight;
+    }
+    // добавляет в edges исходные рёбра графа, из которых состоит ребро иерархии
+    void UnpackEdge(EdgeId edge_id, std::vector<EdgeId>& edges) const;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    static constexpr Weight INFINITE_WEIGHT = std::numeric_limits<Weight>::max();
+    const Graph& graph_;
+    Hierarchy hierarchy_;
+    BuildStatistics build_statistics_;
+
+    mutable std::atomic<size_t> queries_{0};
+    mutable std::atomic<size_t> settled_vertices_{0};
+};
+
+// Стягивает вершины графа в порядке возрастания приоритета: разность числа добавляемых
+// сокращений и числа удаляемых рёбер плюс число уже стянутых соседей (чтобы стягивание шло
+// равномерно по графу). Приоритеты пересчитываются лениво при извлечении из очереди.
+template <typename Weight>
+class ContractionHierarchyRouter<Weight>::Builder {
+public:
+    Builder(const Graph& graph, Hierarchy& hierarchy, const std::atomic<bool>* cancel)
+        : graph_(graph)
+        , hierarchy_(hierarchy)
+        , cancel_(cancel)
+        , out_arcs_(graph.GetVertexCount())
+        , in_arcs_(graph.GetVertexCount())
+        , contracted_neighbours_(graph.GetVertexCount())
+        , witness_weights_(graph.GetVertexCount(), INFINITE_WEIGHT)
+        , upward_edges_(graph.GetVertexCount())
+        , downward_edges_(graph.GetVertexCount())
+    {
+        for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            const auto& edge = graph.GetEdge(edge_id);
+            if (edge.weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+            AddArc(edge.from, edge.to, edge.weight, edge_id);
+        }
+    }
+
+    void Build() {
+        using PriorityItem = std::pair<int, VertexId>;
+        const size_t vertex_count = graph_.GetVertexCount();
+        std::priority_queue<PriorityItem, std::vector<PriorityItem>, std::greater<PriorityItem>> queue;
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            queue.push({GetPriority(vertex), vertex});
+        }
+        while (!queue.empty()) {
+            CheckBuildCancelled(cancel_);
+            const VertexId vertex = queue.top().second;
+            queue.pop();
+            // приоритет мог вырасти после стягивания соседей
+            const int priority = GetPriority(vertex);
+            if (!queue.empty() && priority > queue.top().first) {
+                queue.push({priority, vertex});
+                continue;
+            }
+            Contract(vertex);
+        }
+
+        FillSearchEdges(upward_edges_, hierarchy_.upward_offsets, hierarchy_.upward_edges);
+        FillSearchEdges(downward_edges_, hierarchy_.downward_offsets, hierarchy_.downward_edges);
+    }
+
+private:
+    // добавляет ребро from -> to, если между этими вершинами ещё нет ребра не тяжелее
+    void AddArc(VertexId from, VertexId to, Weight weight, EdgeId edge_id) {
+        if (from == to) {
+            return;
+        }
+        auto& out_arcs = out_arcs_[from];
+        const auto it = std::find_if(out_arcs.begin(), out_arcs.end(), [to](const Arc& arc) {
+            return arc.vertex == to;
+        });
+        if (it == out_arcs.end()) {
+            out_arcs.push_back({to, weight, edge_id});
+            in_arcs_[to].push_back({from, weight, edge_id});
+            return;
+        }
+        if (it->weight <= weight) {
+            return;
+        }
+        *it = {to, weight, edge_id};
+        for (Arc& arc : in_arcs_[to]) {
+            if (arc.vertex == from) {
+                arc = {from, weight, edge_id};
+                break;
+            }
+        }
+    }
+
+    // ищет кратчайшие пути из from в обход вершины skipped не длиннее max_weight
+    void FindWitnesses(VertexId from, VertexId skipped, Weight max_weight) {
+        for (const VertexId vertex : touched_vertices_) {
+            witness_weights_[vertex] = INFINITE_WEIGHT;
+        }
+        touched_vertices_.clear();
+
+        Queue queue;
+        witness_weights_[from] = ZERO_WEIGHT;
+        touched_vertices_.push_back(from);
+        queue.push({ZERO_WEIGHT, from});
+        for (size_t settled = 0; !queue.empty() && settled < WITNESS_SEARCH_LIMIT; ++settled) {
+            const auto [weight, vertex] = queue.top();
+            queue.pop();
+            if (witness_weights_[vertex] < weight) {
+                continue;
+            }
+            if (weight > max_weight) {
+                break;
+            }
+            for (const Arc& arc : out_arcs_[vertex]) {
+                if (arc.vertex == skipped) {
+                    continue;
+                }
+                const Weight candidate_weight = weight + arc.weight;
+                if (candidate_weight < witness_weights_[arc.vertex]) {
+                    if (witness_weights_[arc.vertex] == INFINITE_WEIGHT) {
+                        touched_vertices_.push_back(arc.vertex);
+                    }
+                    witness_weights_[arc.vertex] = candidate_weight;
+                    queue.push({candidate_weight, arc.vertex});
+                }
+            }
+        }
+    }
+
+    // вызывает on_shortcut(in_arc, out_arc) для каждого сокращения, нужного при стягивании vertex
+    template <typename OnShortcut>
+    void ForEachShortcut(VertexId vertex, OnShortcut on_shortcut) {
+        const auto& out_arcs = out_arcs_[vertex];
+        if (out_arcs.empty()) {
+            return;
+        }
+        Weight max_out_weight = ZERO_WEIGHT;
+        for (const Arc& arc : out_arcs) {
+            max_out_weight = std::max(max_out_weight, arc.weight);
+        }
+        for (const Arc& in_arc : in_arcs_[vertex]) {
+            FindWitnesses(in_arc.vertex, vertex, in_arc.weight + max_out_weight);
+            for (const Arc& out_arc : out_arcs) {
+                if (out_arc.vertex != in_arc.vertex
+                    && witness_weights_[out_arc.vertex] > in_arc.weight + out_arc.weight) {
+                    on_shortcut(in_arc, out_arc);
+                }
+            }
+        }
+    }
+
+    int GetPriority(VertexId vertex) {
+        int shortcut_count = 0;
+        ForEachShortcut(vertex, [&shortcut_count](const Arc&, const Arc&) {
+            ++shortcut_count;
+        });
+        const int removed_count = static_cast<int>(out_arcs_[vertex].size() + in_arcs_[vertex].size());
+        return shortcut_count - removed_count + contracted_neighbours_[vertex];
+    }
+
+    void Contract(VertexId vertex) {
+        std::vector<Shortcut> shortcuts;
+        ForEachShortcut(vertex, [&](const Arc& in_arc, const Arc& out_arc) {
+            shortcuts.push_back({in_arc.vertex, out_arc.vertex, in_arc.weight + out_arc.weight,
+                                 in_arc.edge, out_arc.edge});
+        });
+
+        // оставшиеся рёбра вершины ведут к более важным вершинам
+        for (const Arc& arc : out_arcs_[vertex]) {
+            upward_edges_[vertex].push_back(arc.edge);
+            RemoveArc(in_arcs_[arc.vertex], vertex);
+            ++contracted_neighbours_[arc.vertex];
+        }
+        for (const Arc& arc : in_arcs_[vertex]) {
+            downward_edges_[vertex].push_back(arc.edge);
+            RemoveArc(out_arcs_[arc.vertex], vertex);
+            ++contracted_neighbours_[arc.vertex];
+        }
+        out_arcs_[vertex].clear();
+        in_arcs_[vertex].clear();
+
+        for (const Shortcut& shortcut : shortcuts) {
+            const EdgeId edge_id = graph_.GetEdgeCount() + hierarchy_.shortcuts.size();
+            hierarchy_.shortcuts.push_back(shortcut);
+            AddArc(shortcut.from, shortcut.to, shortcut.weight, edge_id);
+        }
+    }
+
+    static void RemoveArc(std::vector<Arc>& arcs, VertexId vertex) {
+        arcs.erase(std::remove_if(arcs.begin(), arcs.end(), [vertex](const Arc& arc) {
+            return arc.vertex == vertex;
+        }), arcs.end());
+    }
+
+    static void FillSearchEdges(const std::vector<std::vector<EdgeId>>& edges_by_vertex,
+                                ranges::FrozenArray<size_t>& offsets, ranges::FrozenArray<EdgeId>& edges) {
+        std::vector<size_t> built_offsets(1, 0);
+        std::vector<EdgeId> built_edges;
+        for (const auto& vertex_edges : edges_by_vertex) {
+            built_edges.insert(built_edges.end(), vertex_edges.begin(), vertex_edges.end());
+            built_offsets.push_back(built_edges.size());
+        }
+        offsets = std::move(built_offsets);
+        edges = std::move(built_edges);
+    }
+
+    const Graph& graph_;
+    Hierarchy& hierarchy_;
+    const std::atomic<bool>* cancel_;
+    std::vector<std::vector<Arc>> out_arcs_;
+    std::vector<std::vector<Arc>> in_arcs_;
+    std::vector<int> contracted_neighbours_;
+
+    std::vector<Weight> witness_weights_;
+    std::vector<VertexId> touched_vertices_;
+
+    std::vector<std::vector<EdgeId>> upward_edges_;
+    std::vector<std::vector<EdgeId>> downward_edges_;
+};
+
+template <typename Weight>
+ContractionHierarchyRouter<Weight>::ContractionHierarchyRouter(const Graph& graph, const std::atomic<bool>* cancel)
+    : graph_(graph)
+{
+    const auto start = std::chrono::steady_clock::now();
+    Builder(graph, hierarchy_, cancel).Build();
+    build_statistics_.duration = std::chrono::steady_clock::now() - start;
+    build_statistics_.shortcut_count = hierarchy_.shortcuts.size();
+}
+
+template <typename Weight>
+ContractionHierarchyRouter<Weight>::ContractionHierarchyRouter(const Graph& graph, Hierarchy hierarchy)
+    : graph_(graph)
+    , hierarchy_(std::move(hierarchy))
+{
+    CheckHierarchy();
+    build_statistics_.shortcut_count = hierarchy_.shortcuts.size();
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::CheckHierarchy() const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    const size_t edge_count = graph_.GetEdgeCount() + hierarchy_.shortcuts.size();
+    const auto check_edges = [vertex_count, edge_count](const ranges::FrozenArray<size_t>& offsets,
+                                                        const ranges::FrozenArray<EdgeId>& edges) {
+        return offsets.size() == vertex_count + 1 && offsets.front() == 0 && offsets.back() == edges.size()
+            && std::is_sorted(offsets.begin(), offsets.end())
+            && std::all_of(edges.begin(), edges.end(), [edge_count](EdgeId edge_id) {
+                   return edge_id < edge_count;
+               });
+    };
+    bool correct = check_edges(hierarchy_.upward_offsets, hierarchy_.upward_edges)
+        && check_edges(hierarchy_.downward_offsets, hierarchy_.downward_edges);
+    for (size_t n = 0; correct && n < hierarchy_.shortcuts.size(); ++n) {
+        // сокращение ссылается только на рёбра, существовавшие до него
+        const Shortcut& shortcut = hierarchy_.shortcuts[n];
+        correct = shortcut.from < vertex_count && shortcut.to < vertex_count
+            && shortcut.first < graph_.GetEdgeCount() + n && shortcut.second < graph_.GetEdgeCount() + n;
+    }
+    if (!correct) {
+        throw std::invalid_argument("Contraction hierarchy doesn't match the graph");
+    }
+}
+
+template <typename Weight>
+std::optional<typename ContractionHierarchyRouter<Weight>::RouteInfo>
+ContractionHierarchyRouter<Weight>::BuildRoute(VertexId from, VertexId to) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex is out of graph");
+    }
+    ++queries_;
+
+    // индекс 0 - прямой поиск от from вверх по иерархии, 1 - обратный поиск от to
+    std::vector<Weight> weights[2] = {std::vector<Weight>(vertex_count, INFINITE_WEIGHT),
+                                      std::vector<Weight>(vertex_count, INFINITE_WEIGHT)};
+    std::vector<EdgeId> route_edges[2] = {std::vector<EdgeId>(vertex_count), std::vector<EdgeId>(vertex_count)};
+    Queue queues[2];
+    size_t settled_vertices = 0;
+
+    Weight best_weight = INFINITE_WEIGHT;
+    VertexId meeting_vertex = from;
+    weights[0][from] = ZERO_WEIGHT;
+    weights[1][to] = ZERO_WEIGHT;
+    queues[0].push({ZERO_WEIGHT, from});
+    queues[1].push({ZERO_WEIGHT, to});
+
+    // каждый поиск идёт, пока в его очереди есть вершины ближе лучшего найденного пути
+    const auto is_active = [&](size_t direction) {
+        return !queues[direction].empty() && queues[direction].top().first < best_weight;
+    };
+    while (is_active(0) || is_active(1)) {
+        const size_t direction = !is_active(1)
+            || (is_active(0) && queues[0].top().first <= queues[1].top().first) ? 0 : 1;
+        const auto [weight, vertex] = queues[direction].top();
+        queues[direction].pop();
+        if (weights[direction][vertex] < weight) {
+            continue;  // устаревшая запись очереди
+        }
+        ++settled_vertices;
+        if (weights[1 - direction][vertex] != INFINITE_WEIGHT
+            && weight + weights[1 - direction][vertex] < best_weight) {
+            best_weight = weight + weights[1 - direction][vertex];
+            meeting_vertex = vertex;
+        }
+
+        const auto& offsets = direction == 0 ? hierarchy_.upward_offsets : hierarchy_.downward_offsets;
+        const auto& edges = direction == 0 ? hierarchy_.upward_edges : hierarchy_.downward_edges;
+        for (size_t n = offsets[vertex]; n < offsets[vertex + 1]; ++n) {
+            const EdgeId edge_id = edges[n];
+            const VertexId next = direction == 0 ? GetEdgeTo(edge_id) : GetEdgeFrom(edge_id);
+            const Weight candidate_weight = weight + GetEdgeWeight(edge_id);
+            if (candidate_weight < weights[direction][next]) {
+                weights[direction][next] = candidate_weight;
+                route_edges[direction][next] = edge_id;
+                queues[direction].push({candidate_weight, next});
+            }
+        }
+    }
+    settled_vertices_ += settled_vertices;
+
+    if (best_weight == INFINITE_WEIGHT) {
+        return std::nullopt;
+    }
+    // рёбра иерархии от from до точки встречи и от неё до to
+    std::vector<EdgeId> hierarchy_edges;
+    for (VertexId vertex = meeting_vertex; vertex != from; vertex = GetEdgeFrom(hierarchy_edges.back())) {
+        hierarchy_edges.push_back(route_edges[0][vertex]);
+    }
+    std::reverse(hierarchy_edges.begin(), hierarchy_edges.end());
+    for (VertexId vertex = meeting_vertex; vertex != to; vertex = GetEdgeTo(hierarchy_edges.back())) {
+        hierarchy_edges.push_back(route_edges[1][vertex]);
+    }
+
+    std::vector<EdgeId> route;
+    for (const EdgeId edge_id : hierarchy_edges) {
+        UnpackEdge(edge_id, route);
+    }
+    return RouteInfo{best_weight, std::move(route)};
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::UnpackEdge(EdgeId edge_id, std::vector<EdgeId>& edges) const {
+    std::vector<EdgeId> stack{edge_id};
+    while (!stack.empty()) {
+        const EdgeId current = stack.back();
+        stack.pop_back();
+        if (current < graph_.GetEdgeCount()) {
+            edges.push_back(current);
+            continue;
+        }
+        const Shortcut& shortcut = hierarchy_.shortcuts[current - graph_.GetEdgeCount()];
+        stack.push_back(shortcut.second);
+        stack.push_back(shortcut.first);
+    }
+}
+
+}  // namespace graph
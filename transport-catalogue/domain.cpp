@@ -1,5 +1,7 @@
 #include "domain.h"
 
+#include <algorithm>
+
 /*
  * В этом файле вы можете разместить классы/структуры, которые являются частью предметной области
  * (domain) вашего приложения и не зависят от транспортного справочника. Например Автобусные
@@ -18,6 +20,11 @@ bool operator==(const Stop &lhs, const Stop &rhs)
     return (lhs.name == rhs.name) && (lhs.coordinate == rhs.coordinate);
 }
 
+bool operator==(const RouteStops &lhs, const RouteStops &rhs)
+{
+    return std::equal(lhs.GetIds(), lhs.GetIds() + lhs.size(), rhs.GetIds(), rhs.GetIds() + rhs.size());
+}
+
 bool operator==(const Route &lhs, const Route &rhs)
 {
     return (lhs.name == rhs.name) && (lhs.route_type == rhs.route_type) && (lhs.stops == rhs.stops);
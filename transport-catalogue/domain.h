@@ -5,9 +5,14 @@
  * приложения и не зависят от транспортного справочника.
  */
 
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
 #include <string>
 #include <vector>
 
+#include "frozen_array.h"
 #include "geo.h"
 
 // тип маршрута
@@ -22,20 +27,95 @@ enum class RouteType
 // остановка состоит из имени и координат. Считаем, что имена уникальны.
 struct Stop
 {
-	std::string name;			 // название остановки
+	std::string_view name;		 // название остановки (в пуле названий справочника)
+	uint32_t name_id = 0;		 // id названия в пуле
 	geo::Coordinates coordinate; // координаты
 	uint32_t id = 0;
 
 	friend bool operator==(const Stop &lhs, const Stop &rhs);
 };
 
+// Остановки маршрута - отрезок общего для всех маршрутов пула 32-битных id остановок.
+// Обход даёт указатели на остановки: остановка с id n хранится в stops[n].
+class RouteStops
+{
+public:
+	class Iterator
+	{
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = const Stop *;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const Stop *const *;
+		using reference = const Stop *;
+
+		Iterator() = default;
+		Iterator(const uint32_t *stop_id, const std::deque<Stop> *stops) : stop_id_(stop_id), stops_(stops) {}
+
+		const Stop *operator*() const { return &(*stops_)[*stop_id_]; }
+		const Stop *operator[](difference_type n) const { return &(*stops_)[stop_id_[n]]; }
+		uint32_t GetStopId() const { return *stop_id_; }
+
+		Iterator &operator++() { ++stop_id_; return *this; }
+		Iterator &operator--() { --stop_id_; return *this; }
+		Iterator operator++(int) { Iterator it = *this; ++stop_id_; return it; }
+		Iterator operator--(int) { Iterator it = *this; --stop_id_; return it; }
+		Iterator &operator+=(difference_type n) { stop_id_ += n; return *this; }
+		Iterator &operator-=(difference_type n) { stop_id_ -= n; return *this; }
+		Iterator operator+(difference_type n) const { return Iterator(stop_id_ + n, stops_); }
+		Iterator operator-(difference_type n) const { return Iterator(stop_id_ - n, stops_); }
+		difference_type operator-(const Iterator &other) const { return stop_id_ - other.stop_id_; }
+
+		bool operator==(const Iterator &other) const { return stop_id_ == other.stop_id_; }
+		bool operator!=(const Iterator &other) const { return stop_id_ != other.stop_id_; }
+		bool operator<(const Iterator &other) const { return stop_id_ < other.stop_id_; }
+		bool operator>(const Iterator &other) const { return stop_id_ > other.stop_id_; }
+		bool operator<=(const Iterator &other) const { return stop_id_ <= other.stop_id_; }
+		bool operator>=(const Iterator &other) const { return stop_id_ >= other.stop_id_; }
+
+	private:
+		const uint32_t *stop_id_ = nullptr;
+		const std::deque<Stop> *stops_ = nullptr;
+	};
+
+	RouteStops() = default;
+	// пул может расти после создания маршрута, поэтому храним смещение в пуле, а не указатель
+	RouteStops(const ranges::FrozenArray<uint32_t> *stop_ids, const std::deque<Stop> *stops, size_t offset, size_t count)
+		: stop_ids_(stop_ids), stops_(stops), offset_(offset), count_(count) {}
+
+	Iterator begin() const { return Iterator(GetIds(), stops_); }
+	Iterator end() const { return Iterator(GetIds() + count_, stops_); }
+	std::reverse_iterator<Iterator> rbegin() const { return std::reverse_iterator<Iterator>(end()); }
+	std::reverse_iterator<Iterator> rend() const { return std::reverse_iterator<Iterator>(begin()); }
+
+	size_t size() const { return count_; }
+	bool empty() const { return count_ == 0; }
+	const Stop *operator[](size_t n) const { return begin()[n]; }
+	const Stop *front() const { return (*this)[0]; }
+	const Stop *back() const { return (*this)[count_ - 1]; }
+
+	// id остановок маршрута, лежащие в памяти подряд
+	const uint32_t *GetIds() const { return stop_ids_ == nullptr ? nullptr : stop_ids_->data() + offset_; }
+	// номер первой остановки маршрута в пуле
+	size_t GetOffset() const { return offset_; }
+
+	friend bool operator==(const RouteStops &lhs, const RouteStops &rhs);
+
+private:
+	const ranges::FrozenArray<uint32_t> *stop_ids_ = nullptr;
+	const std::deque<Stop> *stops_ = nullptr;
+	size_t offset_ = 0;
+	size_t count_ = 0;
+};
+
 // Автобусные маршруты
 // Маршрут состоит из имени (номера автобуса), типа и списка остановок. Считаем, что имена уникальны.
 struct Route
 {
-	std::string name; // название маршрута
+	std::string_view name; // название маршрута (в пуле названий справочника)
+	uint32_t name_id = 0;  // id названия в пуле
 	RouteType route_type = RouteType::UNKNOWN;
-	std::vector<const Stop *> stops; // указатели на остановки
+	RouteStops stops; // остановки маршрута
 	uint16_t id = 0;
 
 	friend bool operator==(const Route &lhs, const Route &rhs);
@@ -52,11 +132,48 @@ struct RouteInfo
 	double curvature = 0.0;					   // извилистость
 };
 
+// способ поиска кратчайших маршрутов
+enum class RouterEngine
+{
+	ALL_PAIRS,			 // заранее рассчитанные маршруты между всеми парами остановок
+	DIJKSTRA,			 // поиск по запросу с кэшем деревьев кратчайших путей
+	ASTAR,				 // поиск A* по запросу с оценкой по расстоянию между остановками
+	BIDIRECTIONAL_ASTAR, // двунаправленный поиск A* по запросу
+	CONTRACTION_HIERARCHY, // иерархия сжатия, построенная при make_base
+};
+
+// способ расчёта маршрутов между всеми парами остановок (ALL_PAIRS)
+enum class AllPairsBuild
+{
+	FLOYD_WARSHALL, // алгоритм Флойда-Уоршелла
+	DIJKSTRA,		// поиск Дейкстры из каждой остановки (для разреженных графов)
+};
+
+// формат хранения таблицы маршрутов между всеми парами остановок (ALL_PAIRS)
+enum class RoutesTableFormat
+{
+	WIDE,	 // веса double и 64-битные id рёбер, 16 байт на пару остановок
+	COMPACT, // веса в миллисекундах (32 бита) и 32-битные id рёбер, 8 байт на пару остановок
+};
+
+// модель графа маршрутов
+enum class GraphModel
+{
+	STOP_PAIRS,		 // ребро на каждую пару остановок маршрута, O(k^2) рёбер на маршрут из k остановок
+	STOP_BUS_STATES, // вершины "ожидание на остановке" и "в автобусе на остановке", O(k) рёбер
+};
+
 // настройки маршрутов
 struct RoutingSettings
 {
 	int bus_wait_time = 0;	   // время ожидания автобуса на остановке, в минутах
 	double bus_velocity = 0.0; // скорость автобуса, в км/ч
+	RouterEngine router_engine = RouterEngine::ALL_PAIRS; // способ поиска маршрутов
+	size_t route_cache_size = 64; // количество деревьев кратчайших путей в кэше (DIJKSTRA)
+	AllPairsBuild all_pairs_build = AllPairsBuild::FLOYD_WARSHALL; // способ расчёта таблицы (ALL_PAIRS)
+	size_t router_threads = 0;	  // число потоков расчёта таблицы; 0 - по числу ядер
+	RoutesTableFormat routes_table = RoutesTableFormat::WIDE; // формат таблицы маршрутов (ALL_PAIRS)
+	GraphModel graph_model = GraphModel::STOP_PAIRS; // модель графа маршрутов
 };
 
 struct RouteData
@@ -69,6 +186,20 @@ struct RouteData
 	int span_count = 0;
 };
 
+// проезд между двумя остановками по одному маршруту (запрос Segment)
+struct SegmentInfo
+{
+	uint64_t distance = 0; // расстояние по дорогам, м
+	double time = 0.0;	   // время в пути без ожидания, мин
+};
+
+// остановка рядом с точкой (запрос NearbyStops)
+struct NearbyStop
+{
+	const Stop* stop = nullptr;
+	double distance = 0.0; // расстояние по прямой, м
+};
+
 struct DistanceBeetweenPairStops
 {
 	uint32_t id_stop_from;
@@ -0,0 +1,285 @@
+#pragma once
+
+#include "graph.h"
+#include "routes_table.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// На x86 с GCC и Clang векторные ядра собираются с атрибутом target независимо от флагов
+// компилятора, а нужное выбирается по процессору во время работы. Иначе используются ядра,
+// разрешённые флагами компилятора (__AVX2__, __SSE4_1__), или скалярный вариант
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FLOYD_WARSHALL_DISPATCH
+#define FLOYD_WARSHALL_AVX2
+#define FLOYD_WARSHALL_SSE41
+#define FLOYD_WARSHALL_TARGET(isa) __attribute__((target(isa)))
+#else
+#if defined(__AVX2__)
+#define FLOYD_WARSHALL_AVX2
+#endif
+#if defined(__SSE4_1__)
+#define FLOYD_WARSHALL_SSE41
+#endif
+#define FLOYD_WARSHALL_TARGET(isa)
+#endif
+
+#if defined(FLOYD_WARSHALL_AVX2) || defined(FLOYD_WARSHALL_SSE41)
+#include <immintrin.h>
+#endif
+
+/*
+ * Блочный алгоритм Флойда-Уоршелла над плоской таблицей RoutesTable.
+ *
+ * Матрица делится на квадратные блоки FLOYD_WARSHALL_BLOCK_SIZE x FLOYD_WARSHALL_BLOCK_SIZE.
+ * Для каждого блока промежуточных вершин kb выполняются три фазы:
+ *   1) релаксация диагонального блока (kb, kb);
+ *   2) релаксация блоков строки kb и столбца kb - они зависят только от диагонального блока;
+ *   3) релаксация всех остальных блоков - они зависят только от блоков фазы 2.
+ * Блоки внутри фаз 2 и 3 независимы и обрабатываются параллельно. Три блока, с которыми
+ * работает релаксация, помещаются в кэш L2, а внутренний цикл (min-plus над отрезком строки)
+ * векторизован под AVX2/SSE4.1 (веса double и 32-битные веса компактной таблицы)
+ * со скалярным вариантом для остальных процессоров и платформ.
+ */
+
+namespace graph {
+
+inline constexpr size_t FLOYD_WARSHALL_BLOCK_SIZE = 64;
+
+namespace detail {
+
+// Векторные ядра релаксации строки: обрабатывают начало строки целыми векторами и
+// возвращают число обработанных значений, остаток досчитывает скалярный цикл
+
+#if defined(FLOYD_WARSHALL_AVX2)
+template <typename StoredEdge>
+FLOYD_WARSHALL_TARGET("avx2")
+size_t RelaxRowAvx2(double* weights_i, StoredEdge* prev_edges_i, const double* weights_k,
+                    const StoredEdge* prev_edges_k, double weight_ik, StoredEdge prev_edge_ik,
+                    StoredEdge no_edge_value, size_t count) {
+    const __m256d through = _mm256_set1_pd(weight_ik);
+    const __m256i through_edge = _mm256_set1_epi64x(static_cast<long long>(prev_edge_ik));
+    const __m256i no_edge = _mm256_set1_epi64x(static_cast<long long>(no_edge_value));
+    size_t j = 0;
+    for (; j + 4 <= count; j += 4) {
+        const __m256d candidate = _mm256_add_pd(through, _mm256_loadu_pd(weights_k + j));
+        const __m256d current = _mm256_loadu_pd(weights_i + j);
+        const __m256d better = _mm256_cmp_pd(candidate, current, _CMP_LT_OQ);
+        _mm256_storeu_pd(weights_i + j, _mm256_blendv_pd(current, candidate, better));
+
+        const __m256i edge_kj = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev_edges_k + j));
+        const __m256i new_edge = _mm256_blendv_epi8(edge_kj, through_edge, _mm256_cmpeq_epi64(edge_kj, no_edge));
+        const __m256i edge_ij = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev_edges_i + j));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(prev_edges_i + j),
+                            _mm256_blendv_epi8(edge_ij, new_edge, _mm256_castpd_si256(better)));
+    }
+    return j;
+}
+
+// беззнакового сравнения в AVX2/SSE нет: candidate < current <=> min(candidate, current) != current
+FLOYD_WARSHALL_TARGET("avx2")
+inline size_t RelaxRowAvx2(uint32_t* weights_i, uint32_t* prev_edges_i, const uint32_t* weights_k,
+                           const uint32_t* prev_edges_k, uint32_t weight_ik, uint32_t prev_edge_ik,
+                           uint32_t no_edge_value, size_t count) {
+    const __m256i through = _mm256_set1_epi32(static_cast<int>(weight_ik));
+    const __m256i through_edge = _mm256_set1_epi32(static_cast<int>(prev_edge_ik));
+    const __m256i no_edge = _mm256_set1_epi32(static_cast<int>(no_edge_value));
+    size_t j = 0;
+    for (; j + 8 <= count; j += 8) {
+        const __m256i candidate = _mm256_add_epi32(through,
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights_k + j)));
+        const __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights_i + j));
+        const __m256i not_better = _mm256_cmpeq_epi32(_mm256_min_epu32(candidate, current), current);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(weights_i + j),
+                            _mm256_blendv_epi8(candidate, current, not_better));
+
+        const __m256i edge_kj = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev_edges_k + j));
+        const __m256i new_edge = _mm256_blendv_epi8(edge_kj, through_edge, _mm256_cmpeq_epi32(edge_kj, no_edge));
+        const __m256i edge_ij = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev_edges_i + j));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(prev_edges_i + j),
+                            _mm256_blendv_epi8(new_edge, edge_ij, not_better));
+    }
+    return j;
+}
+#endif
+
+#if defined(FLOYD_WARSHALL_SSE41)
+template <typename StoredEdge>
+FLOYD_WARSHALL_TARGET("sse4.1")
+size_t RelaxRowSse41(double* weights_i, StoredEdge* prev_edges_i, const double* weights_k,
+                     const StoredEdge* prev_edges_k, double weight_ik, StoredEdge prev_edge_ik,
+                     StoredEdge no_edge_value, size_t count) {
+    const __m128d through = _mm_set1_pd(weight_ik);
+    const __m128i through_edge = _mm_set1_epi64x(static_cast<long long>(prev_edge_ik));
+    const __m128i no_edge = _mm_set1_epi64x(static_cast<long long>(no_edge_value));
+    size_t j = 0;
+    for (; j + 2 <= count; j += 2) {
+        const __m128d candidate = _mm_add_pd(through, _mm_loadu_pd(weights_k + j));
+        const __m128d current = _mm_loadu_pd(weights_i + j);
+        const __m128d better = _mm_cmplt_pd(candidate, current);
+        _mm_storeu_pd(weights_i + j, _mm_blendv_pd(current, candidate, better));
+
+        const __m128i edge_kj = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_edges_k + j));
+        const __m128i new_edge = _mm_blendv_epi8(edge_kj, through_edge, _mm_cmpeq_epi64(edge_kj, no_edge));
+        const __m128i edge_ij = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_edges_i + j));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(prev_edges_i + j),
+                         _mm_blendv_epi8(edge_ij, new_edge, _mm_castpd_si128(better)));
+    }
+    return j;
+}
+
+FLOYD_WARSHALL_TARGET("sse4.1")
+inline size_t RelaxRowSse41(uint32_t* weights_i, uint32_t* prev_edges_i, const uint32_t* weights_k,
+                            const uint32_t* prev_edges_k, uint32_t weight_ik, uint32_t prev_edge_ik,
+                            uint32_t no_edge_value, size_t count) {
+    const __m128i through = _mm_set1_epi32(static_cast<int>(weight_ik));
+    const __m128i through_edge = _mm_set1_epi32(static_cast<int>(prev_edge_ik));
+    const __m128i no_edge = _mm_set1_epi32(static_cast<int>(no_edge_value));
+    size_t j = 0;
+    for (; j + 4 <= count; j += 4) {
+        const __m128i candidate = _mm_add_epi32(through,
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights_k + j)));
+        const __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights_i + j));
+        const __m128i not_better = _mm_cmpeq_epi32(_mm_min_epu32(candidate, current), current);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(weights_i + j), _mm_blendv_epi8(candidate, current, not_better));
+
+        const __m128i edge_kj = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_edges_k + j));
+        const __m128i new_edge = _mm_blendv_epi8(edge_kj, through_edge, _mm_cmpeq_epi32(edge_kj, no_edge));
+        const __m128i edge_ij = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_edges_i + j));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(prev_edges_i + j), _mm_blendv_epi8(new_edge, edge_ij, not_better));
+    }
+    return j;
+}
+#endif
+
+// набор векторных инструкций процессора, определяется один раз
+enum class VectorIsa { SCALAR, SSE41, AVX2 };
+
+inline VectorIsa GetVectorIsa() {
+#if defined(FLOYD_WARSHALL_DISPATCH)
+    static const VectorIsa isa = __builtin_cpu_supports("avx2") ? VectorIsa::AVX2
+        : __builtin_cpu_supports("sse4.1") ? VectorIsa::SSE41 : VectorIsa::SCALAR;
+    return isa;
+#elif defined(FLOYD_WARSHALL_AVX2)
+    return VectorIsa::AVX2;
+#elif defined(FLOYD_WARSHALL_SSE41)
+    return VectorIsa::SSE41;
+#else
+    return VectorIsa::SCALAR;
+#endif
+}
+
+}  // namespace detail
+
+// Релаксирует count маршрутов строки i через вершину k:
+// маршрут i -> j заменяется на i -> k -> j, если он короче.
+// Последним ребром нового маршрута становится последнее ребро маршрута k -> j
+// (или i -> k, если маршрут k -> j пустой).
+template <typename StoredWeight, typename StoredEdge>
+void RelaxRowThroughVertex(StoredWeight* weights_i, StoredEdge* prev_edges_i,
+                           const StoredWeight* weights_k, const StoredEdge* prev_edges_k,
+                           StoredWeight weight_ik, StoredEdge prev_edge_ik, size_t count) {
+    constexpr StoredEdge NO_EDGE = RoutesTable<StoredWeight, StoredEdge>::NO_EDGE;
+    size_t j = 0;
+
+    constexpr bool vectorized = (std::is_same_v<StoredWeight, double> && sizeof(StoredEdge) == sizeof(long long))
+        || (std::is_same_v<StoredWeight, uint32_t> && std::is_same_v<StoredEdge, uint32_t>);
+    if constexpr (vectorized) {
+        switch (detail::GetVectorIsa()) {
+#if defined(FLOYD_WARSHALL_AVX2)
+            case detail::VectorIsa::AVX2:
+                j = detail::RelaxRowAvx2(weights_i, prev_edges_i, weights_k, prev_edges_k, weight_ik, prev_edge_ik,
+                                         NO_EDGE, count);
+                break;
+#endif
+#if defined(FLOYD_WARSHALL_SSE41)
+            case detail::VectorIsa::SSE41:
+                j = detail::RelaxRowSse41(weights_i, prev_edges_i, weights_k, prev_edges_k, weight_ik, prev_edge_ik,
+                                          NO_EDGE, count);
+                break;
+#endif
+            default:
+                break;
+        }
+    }
+
+    for (; j < count; ++j) {
+        const StoredWeight candidate = weight_ik + weights_k[j];
+        if (candidate < weights_i[j]) {
+            weights_i[j] = candidate;
+            prev_edges_i[j] = prev_edges_k[j] != NO_EDGE ? prev_edges_k[j] : prev_edge_ik;
+        }
+    }
+}
+
+// Релаксирует блок (block_from, block_to) через вершины блока block_through
+template <typename Table>
+void RelaxBlock(Table& table, size_t block_through, size_t block_from, size_t block_to) {
+    constexpr size_t BLOCK = FLOYD_WARSHALL_BLOCK_SIZE;
+    const size_t vertex_count = table.GetVertexCount();
+
+    const size_t through_end = std::min(vertex_count, (block_through + 1) * BLOCK);
+    const size_t from_end = std::min(vertex_count, (block_from + 1) * BLOCK);
+    const size_t to_begin = block_to * BLOCK;
+    const size_t to_count = std::min(vertex_count, to_begin + BLOCK) - to_begin;
+
+    for (VertexId vertex_through = block_through * BLOCK; vertex_through < through_end; ++vertex_through) {
+        const auto* weights_k = table.GetWeightsRow(vertex_through) + to_begin;
+        const auto* prev_edges_k = table.GetPrevEdgesRow(vertex_through) + to_begin;
+        for (VertexId vertex_from = block_from * BLOCK; vertex_from < from_end; ++vertex_from) {
+            const auto weight_ik = table.GetWeight(vertex_from, vertex_through);
+            if (weight_ik == Table::NO_ROUTE) {
+                continue;
+            }
+            RelaxRowThroughVertex(table.GetWeightsRow(vertex_from) + to_begin,
+                                  table.GetPrevEdgesRow(vertex_from) + to_begin,
+                                  weights_k, prev_edges_k,
+                                  weight_ik, table.GetPrevEdge(vertex_from, vertex_through), to_count);
+        }
+    }
+}
+
+// Достраивает таблицу, в которой заданы маршруты из одного ребра, до кратчайших маршрутов
+// между всеми парами вершин. Возвращает суммарную статистику потоков пула. Флаг cancel
+// проверяется перед каждым блоком-посредником; при отмене бросается BuildCancelled
+template <typename Table>
+std::vector<thread_pool::ThreadStatistics> RunBlockedFloydWarshall(Table& table,
+                                                                   thread_pool::ThreadPool& pool,
+                                                                   const std::atomic<bool>* cancel = nullptr) {
+    std::vector<thread_pool::ThreadStatistics> statistics(pool.GetThreadCount());
+    const size_t block_count =
+        (table.GetVertexCount() + FLOYD_WARSHALL_BLOCK_SIZE - 1) / FLOYD_WARSHALL_BLOCK_SIZE;
+    if (block_count == 0) {
+        return statistics;
+    }
+    const size_t other_blocks = block_count - 1;
+
+    for (size_t block_through = 0; block_through < block_count; ++block_through) {
+        CheckBuildCancelled(cancel);
+        // номер блока, отличного от block_through, по его порядковому номеру среди таких блоков
+        const auto other_block = [block_through](size_t index) {
+            return index < block_through ? index : index + 1;
+        };
+
+        RelaxBlock(table, block_through, block_through, block_through);
+
+        thread_pool::AccumulateStatistics(statistics, pool.ParallelFor(2 * other_blocks, [&](size_t task, size_t) {
+            const size_t block = other_block(task / 2);
+            if (task % 2 == 0) {
+                RelaxBlock(table, block_through, block_through, block);
+            } else {
+                RelaxBlock(table, block_through, block, block_through);
+            }
+        }));
+
+        thread_pool::AccumulateStatistics(statistics, pool.ParallelFor(other_blocks * other_blocks, [&](size_t task, size_t) {
+            RelaxBlock(table, block_through, other_block(task / other_blocks), other_block(task % other_blocks));
+        }));
+    }
+    return statistics;
+}
+
+}  // namespace graph
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ranges {
+
+// FrozenArray - массив только для чтения: свой (из вектора) или чужой блок памяти, например
+// часть отображённой в память базы. Чужой блок держит owner, как у TableMemory. Свой массив
+// можно дополнять в конец, пока он строится; чужой не меняется. Обход - по указателям, поэтому
+// код, читающий массив, не зависит от того, чей он.
+template <typename T>
+class FrozenArray {
+public:
+    using value_type = T;
+    using const_iterator = const T*;
+    using iterator = const_iterator;
+
+    FrozenArray() = default;
+    FrozenArray(std::vector<T> values)
+        : values_(std::move(values))
+        , data_(values_.data())
+        , size_(values_.size()) {
+    }
+    // чужой блок: data[0, size) живёт, пока жив owner
+    FrozenArray(std::shared_ptr<const void> owner, const T* data, size_t size)
+        : data_(data)
+        , size_(size)
+        , owner_(std::move(owner)) {
+        static_assert(std::is_trivially_copyable_v<T>);
+    }
+
+    FrozenArray(const FrozenArray& other)
+        : values_(other.values_)
+        , data_(other.owner_ ? other.data_ : values_.data())
+        , size_(other.size_)
+        , owner_(other.owner_) {
+    }
+    FrozenArray(FrozenArray&& other) noexcept
+        : values_(std::move(other.values_))
+        , data_(other.owner_ ? other.data_ : values_.data())
+        , size_(other.size_)
+        , owner_(std::move(other.owner_)) {
+        other.Reset();
+    }
+    FrozenArray& operator=(const FrozenArray& other) {
+        if (this != &other) {
+            *this = FrozenArray(other);
+        }
+        return *this;
+    }
+    FrozenArray& operator=(FrozenArray&& other) noexcept {
+        if (this != &other) {
+            values_ = std::move(other.values_);
+            data_ = other.owner_ ? other.data_ : values_.data();
+            size_ = other.size_;
+            owner_ = std::move(other.owner_);
+            other.Reset();
+        }
+        return *this;
+    }
+
+    const T* data() const {
+        return data_;
+    }
+    size_t size() const {
+        return size_;
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+    const T* begin() const {
+        return data_;
+    }
+    const T* end() const {
+        return data_ + size_;
+    }
+    const T& operator[](size_t index) const {
+        return data_[index];
+    }
+    const T& at(size_t index) const {
+        if (index >= size_) {
+            throw std::out_of_range("Frozen array index is out of range");
+        }
+        return data_[index];
+    }
+    const T& front() const {
+        return data_[0];
+    }
+    const T& back() const {
+        return data_[size_ - 1];
+    }
+
+    // массив лежит в чужой памяти
+    bool IsBorrowed() const {
+        return owner_ != nullptr;
+    }
+
+    // дополняет свой массив; чужой менять нельзя
+    void push_back(const T& value) {
+        if (owner_) {
+            throw std::logic_error("Borrowed array is read-only");
+        }
+        values_.push_back(value);
+        data_ = values_.data();
+        size_ = values_.size();
+    }
+
+    friend bool operator==(const FrozenArray& lhs, const FrozenArray& rhs) {
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    }
+    friend bool operator!=(const FrozenArray& lhs, const FrozenArray& rhs) {
+        return !(lhs == rhs);
+    }
+
+private:
+    void Reset() noexcept {
+        values_.clear();
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    std::vector<T> values_;
+    const T* data_ = nullptr;
+    size_t size_ = 0;
+    std::shared_ptr<const void> owner_;
+};
+
+}  // namespace ranges
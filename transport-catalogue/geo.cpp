@@ -1,5 +1,7 @@
 #include "geo.h"
 
+#include <algorithm>
+
 // geo — объявляет координаты на земной поверхности и вычисляет расстояние между ними
 
 namespace geo
@@ -22,4 +24,95 @@ namespace geo
         return acos(sin(from.lat * dr) * sin(to.lat * dr) + cos(from.lat * dr) * cos(to.lat * dr) * cos(abs(from.lng - to.lng) * dr)) * Earth_radius;
     }
 
+    namespace
+    {
+        // размер пакета: промежуточные массивы помещаются на стеке и в кеше L1
+        constexpr size_t BATCH_SIZE = 64;
+
+        // расстояние по квадрату длины хорды между единичными векторами: угол 2 * asin(chord / 2).
+        // В отличие от угла по косинусу (acos скалярного произведения) формула точна и для близких
+        // точек: у совпадающих векторов хорда и расстояние ровно 0
+        double ChordToDistance(double chord_squared)
+        {
+            return 2.0 * std::asin(std::min(1.0, std::sqrt(chord_squared) / 2.0)) * Earth_radius;
+        }
+
+        double ChordSquared(double dx, double dy, double dz)
+        {
+            return dx * dx + dy * dy + dz * dz;
+        }
+    } // namespace
+
+    UnitVector ToUnitVector(Coordinates coordinates)
+    {
+        const double dr = M_PI / 180.0;
+        const double cos_lat = std::cos(coordinates.lat * dr);
+        return {cos_lat * std::cos(coordinates.lng * dr), cos_lat * std::sin(coordinates.lng * dr),
+                std::sin(coordinates.lat * dr)};
+    }
+
+    double ComputeDistance(const UnitVector& from, const UnitVector& to)
+    {
+        return ChordToDistance(ChordSquared(from.x - to.x, from.y - to.y, from.z - to.z));
+    }
+
+    void UnitVectors::Add(Coordinates coordinates)
+    {
+        const UnitVector vector = ToUnitVector(coordinates);
+        x.push_back(vector.x);
+        y.push_back(vector.y);
+        z.push_back(vector.z);
+    }
+
+    UnitVector UnitVectors::operator[](size_t index) const
+    {
+        return {x[index], y[index], z[index]};
+    }
+
+    size_t UnitVectors::size() const
+    {
+        return x.size();
+    }
+
+    void ComputeDistances(const UnitVector& from, const UnitVectors& to, size_t begin, size_t count,
+                          double* distances)
+    {
+        const double* x = to.x.data() + begin;
+        const double* y = to.y.data() + begin;
+        const double* z = to.z.data() + begin;
+        for (size_t n = 0; n < count; ++n) {
+            distances[n] = ChordSquared(from.x - x[n], from.y - y[n], from.z - z[n]);
+        }
+        for (size_t n = 0; n < count; ++n) {
+            distances[n] = ChordToDistance(distances[n]);
+        }
+    }
+
+    double ComputePathLength(const UnitVectors& points, const uint32_t* ids, size_t count)
+    {
+        double result = 0.0;
+        double chords[BATCH_SIZE];
+        // отрезки [ids[begin], ids[begin + 1]] пакетами: сначала собираем координаты концов,
+        // затем считаем квадраты хорд одним векторизуемым циклом
+        for (size_t begin = 0; begin + 1 < count; begin += BATCH_SIZE) {
+            const size_t size = std::min(BATCH_SIZE, count - 1 - begin);
+            double x[BATCH_SIZE + 1];
+            double y[BATCH_SIZE + 1];
+            double z[BATCH_SIZE + 1];
+            for (size_t n = 0; n <= size; ++n) {
+                const uint32_t id = ids[begin + n];
+                x[n] = points.x[id];
+                y[n] = points.y[id];
+                z[n] = points.z[id];
+            }
+            for (size_t n = 0; n < size; ++n) {
+                chords[n] = ChordSquared(x[n] - x[n + 1], y[n] - y[n + 1], z[n] - z[n + 1]);
+            }
+            for (size_t n = 0; n < size; ++n) {
+                result += ChordToDistance(chords[n]);
+            }
+        }
+        return result;
+    }
+
 } // namespace geo
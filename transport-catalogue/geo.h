@@ -6,6 +6,11 @@
 #endif
 
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frozen_array.h"
 
 // функции для работы с географическими координатами
 
@@ -20,4 +25,42 @@ namespace geo {
     };
 
     double ComputeDistance(Coordinates from, Coordinates to);
+
+    // точка на единичной сфере: sin и cos широты и долготы вычислены заранее, и расстояние
+    // сводится к длине хорды между точками и одному asin
+    struct UnitVector {
+        double x;
+        double y;
+        double z;
+    };
+
+    UnitVector ToUnitVector(Coordinates coordinates);
+
+    // то же, что ComputeDistance для исходных координат (с точностью округления); для близких
+    // точек точнее: у совпадающих точек ровно 0
+    double ComputeDistance(const UnitVector& from, const UnitVector& to);
+
+    // единичные векторы точек в отдельных массивах по осям для пакетных вычислений; массивы
+    // могут лежать в чужой памяти, например в базе, отображённой в память
+    struct UnitVectors {
+        ranges::FrozenArray<double> x;
+        ranges::FrozenArray<double> y;
+        ranges::FrozenArray<double> z;
+
+        void Add(Coordinates coordinates);
+        UnitVector operator[](size_t index) const;
+        size_t size() const;
+    };
+
+    // расстояния от from до точек to с номерами [begin, begin + count) в distances[0, count).
+    // Квадраты хорд считаются отдельным циклом без ветвлений и зависимостей между итерациями:
+    // его векторизует оптимизирующий компилятор (GCC с -O3, Clang с -O2) на ширину целевого
+    // набора инструкций, в переносимой сборке x86-64 - SSE2, по два double. sqrt и asin
+    // считаются затем по одному элементу функциями стандартной библиотеки
+    void ComputeDistances(const UnitVector& from, const UnitVectors& to, size_t begin, size_t count,
+                          double* distances);
+
+    // длина ломаной через точки points с номерами ids[0, count); квадраты хорд считаются так же,
+    // как в ComputeDistances
+    double ComputePathLength(const UnitVectors& points, const uint32_t* ids, size_t count);
 }
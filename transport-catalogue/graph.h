@@ -1,8 +1,16 @@
 #pragma once
 
+#include "frozen_array.h"
 #include "ranges.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <cstdlib>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
 namespace graph {
@@ -10,68 +18,259 @@ namespace graph {
 using VertexId = size_t;
 using EdgeId = size_t;
 
+// построение маршрутизатора (таблицы всех пар, иерархии сжатия) прервано по флагу отмены
+class BuildCancelled : public std::runtime_error {
+public:
+    BuildCancelled()
+        : std::runtime_error("Router build is cancelled") {
+    }
+};
+
+// флаг отмены необязателен: nullptr - построение не прерывается
+inline void CheckBuildCancelled(const std::atomic<bool>* cancel) {
+    if (cancel != nullptr && cancel->load(std::memory_order_relaxed)) {
+        throw BuildCancelled();
+    }
+}
+
+// в рёбрах id вершин хранятся в 32 битах: ребро double-графа занимает 24 байта вместо 40
 template <typename Weight>
 struct Edge {
-    VertexId from;
-    VertexId to;
+    uint32_t from;
+    uint32_t to;
     Weight weight;
     uint32_t span_count = 0;
     uint32_t bus_name_id;
 };
 
+// итератор по последовательным id рёбер; разыменование даёт ссылку на id внутри итератора,
+// как у счётных итераторов, поэтому operator[] возвращает id по значению
+class EdgeIdIterator {
+public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = EdgeId;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const EdgeId*;
+    using reference = const EdgeId&;
+
+    EdgeIdIterator() = default;
+    explicit EdgeIdIterator(EdgeId edge_id)
+        : edge_id_(edge_id) {
+    }
+
+    reference operator*() const {
+        return edge_id_;
+    }
+    pointer operator->() const {
+        return &edge_id_;
+    }
+    value_type operator[](difference_type n) const {
+        return edge_id_ + n;
+    }
+
+    EdgeIdIterator& operator++() {
+        ++edge_id_;
+        return *this;
+    }
+    EdgeIdIterator operator++(int) {
+        EdgeIdIterator old = *this;
+        ++edge_id_;
+        return old;
+    }
+    EdgeIdIterator& operator--() {
+        --edge_id_;
+        return *this;
+    }
+    EdgeIdIterator operator--(int) {
+        EdgeIdIterator old = *this;
+        --edge_id_;
+        return old;
+    }
+    EdgeIdIterator& operator+=(difference_type n) {
+        edge_id_ += n;
+        return *this;
+    }
+    EdgeIdIterator& operator-=(difference_type n) {
+        edge_id_ -= n;
+        return *this;
+    }
+
+    friend EdgeIdIterator operator+(EdgeIdIterator it, difference_type n) {
+        return it += n;
+    }
+    friend EdgeIdIterator operator+(difference_type n, EdgeIdIterator it) {
+        return it += n;
+    }
+    friend EdgeIdIterator operator-(EdgeIdIterator it, difference_type n) {
+        return it -= n;
+    }
+    friend difference_type operator-(EdgeIdIterator lhs, EdgeIdIterator rhs) {
+        return static_cast<difference_type>(lhs.edge_id_ - rhs.edge_id_);
+    }
+
+    friend bool operator==(EdgeIdIterator lhs, EdgeIdIterator rhs) {
+        return lhs.edge_id_ == rhs.edge_id_;
+    }
+    friend bool operator!=(EdgeIdIterator lhs, EdgeIdIterator rhs) {
+        return lhs.edge_id_ != rhs.edge_id_;
+    }
+    friend bool operator<(EdgeIdIterator lhs, EdgeIdIterator rhs) {
+        return lhs.edge_id_ < rhs.edge_id_;
+    }
+    friend bool operator>(EdgeIdIterator lhs, EdgeIdIterator rhs) {
+        return lhs.edge_id_ > rhs.edge_id_;
+    }
+    friend bool operator<=(EdgeIdIterator lhs, EdgeIdIterator rhs) {
+        return lhs.edge_id_ <= rhs.edge_id_;
+    }
+    friend bool operator>=(EdgeIdIterator lhs, EdgeIdIterator rhs) {
+        return lhs.edge_id_ >= rhs.edge_id_;
+    }
+
+private:
+    EdgeId edge_id_ = 0;
+};
+
+// Граф строится добавлением рёбер, после чего "замораживается" (Freeze) в сжатый построчный
+// формат (CSR): рёбра упорядочиваются по начальной вершине, так что исходящие рёбра вершины v
+// имеют id подряд из [offsets[v], offsets[v + 1]). Отдельных списков смежности нет.
+// Заморозка перенумеровывает рёбра; запросы смежности возможны только к замороженному графу.
 template <typename Weight>
 class DirectedWeightedGraph {
 private:
-    using IncidenceList = std::vector<EdgeId>;
-    using IncidentEdgesRange = ranges::Range<typename IncidenceList::const_iterator>;
+    using IncidentEdgesRange = ranges::Range<EdgeIdIterator>;
+    using EdgesRange = ranges::Range<const Edge<Weight>*>;
 
 public:
     DirectedWeightedGraph() = default;
     explicit DirectedWeightedGraph(size_t vertex_count);
-    explicit DirectedWeightedGraph(std::vector<Edge<Weight>> edges,
-            std::vector<std::vector<EdgeId>> incidence_lists);
+    // сразу замороженный граф
+    DirectedWeightedGraph(size_t vertex_count, std::vector<Edge<Weight>> edges);
+    // замороженный граф по рёбрам, уже упорядоченным по начальной вершине, и смещениям
+    // offsets (как после Freeze); массивы могут лежать в чужой памяти, например в базе,
+    // отображённой в память. Бросает std::invalid_argument, если они не согласованы
+    DirectedWeightedGraph(size_t vertex_count, ranges::FrozenArray<Edge<Weight>> edges,
+                          ranges::FrozenArray<EdgeId> offsets);
     EdgeId AddEdge(const Edge<Weight>& edge);
+    // упорядочивает рёбра по начальной вершине (сохраняя порядок добавления) и строит смещения
+    void Freeze();
+    bool IsFrozen() const;
 
     size_t GetVertexCount() const;
     size_t GetEdgeCount() const;
     const Edge<Weight>& GetEdge(EdgeId edge_id) const;
+    // id рёбер, исходящих из вершины
     IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
+    // рёбра, исходящие из вершины, лежащие в памяти подряд
+    EdgesRange GetOutgoingEdges(VertexId vertex) const;
 
-    const std::vector<Edge<Weight>>& GetEdges() const {
+    const ranges::FrozenArray<Edge<Weight>>& GetEdges() const {
         return edges_;
     }
-
-    const std::vector<IncidenceList>& GetIncidenceLists() const {
-	    return incidence_lists_;
+    // смещения рёбер по вершинам замороженного графа
+    const ranges::FrozenArray<EdgeId>& GetOffsets() const {
+        return offsets_;
     }
-    
+
 private:
-    std::vector<Edge<Weight>> edges_;
-    std::vector<IncidenceList> incidence_lists_;
+    void CheckFrozen() const;
+
+    size_t vertex_count_ = 0;
+    ranges::FrozenArray<Edge<Weight>> edges_;
+    // offsets_[v] - id первого ребра из вершины v; пуст, пока граф не заморожен
+    ranges::FrozenArray<EdgeId> offsets_;
 };
 
 template <typename Weight>
 DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
-    : incidence_lists_(vertex_count) {
+    : vertex_count_(vertex_count) {
+    if (vertex_count > std::numeric_limits<uint32_t>::max()) {
+        throw std::out_of_range("Too many vertices");
+    }
 }
 
 template <typename Weight>
-    DirectedWeightedGraph<Weight>::DirectedWeightedGraph(std::vector<Edge<Weight>> edges,
-        std::vector<std::vector<EdgeId>> incidence_lists)
-        : edges_(edges)
-        , incidence_lists_(incidence_lists) {}
+DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count, std::vector<Edge<Weight>> edges)
+    : DirectedWeightedGraph(vertex_count) {
+    edges_ = std::move(edges);
+    Freeze();
+}
+
+template <typename Weight>
+DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count, ranges::FrozenArray<Edge<Weight>> edges,
+                                                     ranges::FrozenArray<EdgeId> offsets)
+    : DirectedWeightedGraph(vertex_count) {
+    if (offsets.size() != vertex_count + 1 || offsets.front() != 0 || offsets.back() != edges.size()
+        || !std::is_sorted(offsets.begin(), offsets.end())) {
+        throw std::invalid_argument("Graph offsets do not match edges");
+    }
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        for (EdgeId edge_id = offsets[vertex]; edge_id < offsets[vertex + 1]; ++edge_id) {
+            if (edges[edge_id].from != vertex || edges[edge_id].to >= vertex_count) {
+                throw std::invalid_argument("Graph offsets do not match edges");
+            }
+        }
+    }
+    edges_ = std::move(edges);
+    offsets_ = std::move(offsets);
+}
 
 template <typename Weight>
 EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
+    if (IsFrozen()) {
+        throw std::logic_error("Graph is frozen");
+    }
+    if (edge.from >= vertex_count_ || edge.to >= vertex_count_) {
+        throw std::out_of_range("Vertex is out of graph");
+    }
     edges_.push_back(edge);
-    const EdgeId id = edges_.size() - 1;
-    incidence_lists_.at(edge.from).push_back(id);
-    return id;
+    return edges_.size() - 1;
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::Freeze() {
+    if (IsFrozen()) {
+        return;
+    }
+    std::vector<EdgeId> offsets(vertex_count_ + 1, 0);
+    for (const auto& edge : edges_) {
+        if (edge.from >= vertex_count_ || edge.to >= vertex_count_) {
+            throw std::out_of_range("Vertex is out of graph");
+        }
+        ++offsets[edge.from + 1];
+    }
+    for (size_t vertex = 0; vertex < vertex_count_; ++vertex) {
+        offsets[vertex + 1] += offsets[vertex];
+    }
+    // устойчивая раскладка рёбер по начальным вершинам подсчётом за O(V + E)
+    if (!std::is_sorted(edges_.begin(), edges_.end(), [](const Edge<Weight>& lhs, const Edge<Weight>& rhs) {
+            return lhs.from < rhs.from;
+        })) {
+        std::vector<Edge<Weight>> edges(edges_.size());
+        std::vector<EdgeId> positions(offsets.begin(), offsets.end() - 1);
+        for (const auto& edge : edges_) {
+            edges[positions[edge.from]++] = edge;
+        }
+        edges_ = std::move(edges);
+    }
+    offsets_ = std::move(offsets);
+}
+
+template <typename Weight>
+bool DirectedWeightedGraph<Weight>::IsFrozen() const {
+    return !offsets_.empty();
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::CheckFrozen() const {
+    if (!IsFrozen()) {
+        throw std::logic_error("Graph should be frozen");
+    }
 }
 
 template <typename Weight>
 size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-    return incidence_lists_.size();
+    return vertex_count_;
 }
 
 template <typename Weight>
@@ -87,7 +286,15 @@ const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const
 template <typename Weight>
 typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
 DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
-    return ranges::AsRange(incidence_lists_.at(vertex));
+    CheckFrozen();
+    return {EdgeIdIterator(offsets_.at(vertex)), EdgeIdIterator(offsets_.at(vertex + 1))};
+}
+
+template <typename Weight>
+typename DirectedWeightedGraph<Weight>::EdgesRange
+DirectedWeightedGraph<Weight>::GetOutgoingEdges(VertexId vertex) const {
+    CheckFrozen();
+    return {edges_.begin() + offsets_.at(vertex), edges_.begin() + offsets_.at(vertex + 1)};
 }
 
 }  // namespace graph
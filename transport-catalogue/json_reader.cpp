@@ -211,6 +211,8 @@ namespace json_reader
             if (request.AsDict().empty()) {
                 continue;
             }
+            // весь запрос отвечается по одной версии справочника
+            handler_.RefreshVersion();
             if (request.AsDict().at("type").AsString() == "Stop") {
                 json::Node dict_node_stop = RequestStop(request);
                 arr_answer.push_back(std::move(dict_node_stop));
@@ -239,6 +241,30 @@ namespace json_reader
                 arr_answer.push_back(std::move(dict_node_route));
                 continue;
             }
+
+            else if (request.AsDict().at("type").AsString() == "Segment") {
+                json::Node dict_node_segment = RequestSegment(request);
+                arr_answer.push_back(std::move(dict_node_segment));
+                continue;
+            }
+
+            else if (request.AsDict().at("type").AsString() == "NearbyStops") {
+                json::Node dict_node_nearby = RequestNearbyStops(request);
+                arr_answer.push_back(std::move(dict_node_nearby));
+                continue;
+            }
+
+            else if (request.AsDict().at("type").AsString() == "SuggestStops") {
+                json::Node dict_node_suggest = RequestSuggestStops(request);
+                arr_answer.push_back(std::move(dict_node_suggest));
+                continue;
+            }
+
+            else if (request.AsDict().at("type").AsString() == "Update") {
+                json::Node dict_node_update = RequestUpdate(request);
+                arr_answer.push_back(std::move(dict_node_update));
+                continue;
+            }
         }
         json::Print(json::Document{ arr_answer }, output_);
     }
@@ -277,12 +303,11 @@ namespace json_reader
         if (!handler_.StopIs(name)) {
             return CreateEmptyAnswer(value);
         }
-        auto buses = handler_.GetRoutesOnStop(name);
+        const auto buses = handler_.GetRoutesOnStop(name);
         json::Array arr;
-        if (buses != nullptr) {
-            for (std::string_view bus : *buses) {
-                arr.push_back(std::string(bus));
-            }
+        arr.reserve(buses.end() - buses.begin());
+        for (const uint32_t bus_id : buses) {
+            arr.push_back(std::string(handler_.GetRouteNameById(bus_id)));
         }
         return json::Builder{}.StartDict()
                 .Key("buses"s).Value(arr)
@@ -520,6 +545,209 @@ namespace json_reader
 
     }
 
+    /*
+    Запрос Segment - проезд между двумя остановками на одном автобусе:
+    {
+      "type": "Segment",
+      "bus": "297",
+      "from": "Biryulyovo Zapadnoye",
+      "to": "Universam",
+      "id": 5
+    }
+    Ответ:
+    {
+      "distance": 5950,
+      "request_id": 5,
+      "time": 8.925
+    }
+      - distance — расстояние по дорогам в метрах, целое число;
+      - time — время в пути в минутах со скоростью bus_velocity, без ожидания автобуса.
+    Автобус едет в пределах одного рейса: по кольцевому маршруту только вперёд, по некольцевому
+    в любую сторону. Если остановка встречается несколько раз, берётся кратчайший проезд.
+    Если автобуса или остановок нет или автобус не идёт от from до to, ответ содержит
+    "error_message": "not found".
+    */
+    json::Node JsonReader::RequestSegment(const json::Node& value) {
+        const std::optional<SegmentInfo> segment_info = handler_.GetSegmentInfo(
+                value.AsDict().at("bus"s).AsString(), value.AsDict().at("from"s).AsString(),
+                value.AsDict().at("to"s).AsString());
+        if (!segment_info) {
+            return CreateEmptyAnswer(value);
+        }
+        return json::Builder{}.StartDict()
+                .Key("distance"s).Value(segment_info->distance)
+                .Key("request_id"s).Value(value.AsDict().at("id"s).AsInt())
+                .Key("time"s).Value(segment_info->time)
+                .EndDict().Build();
+    }
+
+    /*
+    Запрос NearbyStops - остановки рядом с точкой:
+    {
+      "type": "NearbyStops",
+      "latitude": 55.611087,
+      "longitude": 37.20829,
+      "radius": 500,
+      "count": 3,
+      "id": 6
+    }
+    Ответ:
+    {
+      "request_id": 6,
+      "stops": [
+        {"distance": 120.5, "name": "Tolstopaltsevo"},
+        {"distance": 431.2, "name": "Marushkino"}
+      ]
+    }
+      - radius — наибольшее расстояние по прямой от точки в метрах;
+      - count — сколько ближайших остановок вернуть.
+    Нужен хотя бы один из ключей radius и count; если заданы оба, возвращается не больше
+    count ближайших остановок в радиусе radius. Остановки упорядочены по возрастанию
+    расстояния, при равенстве — в порядке добавления. Если не задан ни radius, ни count,
+    ответ содержит "error_message": "not found".
+    */
+    json::Node JsonReader::RequestNearbyStops(const json::Node& value) {
+        const json::Dict& dict = value.AsDict();
+        const auto radius_node = dict.find("radius"s);
+        const auto count_node = dict.find("count"s);
+        if (radius_node == dict.end() && count_node == dict.end()) {
+            return CreateEmptyAnswer(value);
+        }
+        std::optional<double> radius;
+        if (radius_node != dict.end()) {
+            radius = radius_node->second.AsDouble();
+        }
+        std::optional<size_t> count;
+        if (count_node != dict.end()) {
+            count = static_cast<size_t>(std::max(count_node->second.AsInt(), 0));
+        }
+        const std::vector<NearbyStop> stops = handler_.GetNearbyStops(
+                {dict.at("latitude"s).AsDouble(), dict.at("longitude"s).AsDouble()}, radius, count);
+        json::Array arr;
+        arr.reserve(stops.size());
+        for (const NearbyStop& nearby : stops) {
+            arr.push_back(json::Dict{
+                {"distance"s, nearby.distance},
+                {"name"s, std::string(nearby.stop->name)}});
+        }
+        return json::Builder{}.StartDict()
+                .Key("request_id"s).Value(value.AsDict().at("id"s).AsInt())
+                .Key("stops"s).Value(arr)
+                .EndDict().Build();
+    }
+
+    /*
+    Запрос SuggestStops - подсказка названий остановок по началу:
+    {
+      "type": "SuggestStops",
+      "prefix": "Bir",
+      "count": 2,
+      "id": 7
+    }
+    Ответ:
+    {
+      "request_id": 7,
+      "stops": ["Biryulyovo Passazhirskaya", "Biryulyovo Tovarnaya"]
+    }
+      - prefix — начало названия, с учётом регистра; пустая строка подходит ко всем остановкам;
+      - count — сколько названий вернуть, по умолчанию 10.
+    Названия упорядочены лексикографически (по байтам UTF-8).
+    */
+    json::Node JsonReader::RequestSuggestStops(const json::Node& value) {
+        const json::Dict& dict = value.AsDict();
+        const auto count_node = dict.find("count"s);
+        const size_t count = count_node == dict.end() ? 10 : static_cast<size_t>(std::max(count_node->second.AsInt(), 0));
+        json::Array arr;
+        for (const Stop* stop : handler_.SuggestStops(dict.at("prefix"s).AsString(), count)) {
+            arr.push_back(std::string(stop->name));
+        }
+        return json::Builder{}.StartDict()
+                .Key("request_id"s).Value(value.AsDict().at("id"s).AsInt())
+                .Key("stops"s).Value(arr)
+                .EndDict().Build();
+    }
+
+    /*
+    Запрос Update - изменение справочника без пересборки базы:
+    {
+      "type": "Update",
+      "stops": [
+        {"name": "Rossoshanskaya ulitsa", "latitude": 55.595579, "longitude": 37.605757,
+         "road_distances": {"Biryulyovo Zapadnoye": 1400}}
+      ],
+      "buses": [
+        {"name": "828", "stops": ["Biryulyovo Zapadnoye", "Rossoshanskaya ulitsa"], "is_roundtrip": false}
+      ],
+      "closed_stops": [],
+      "closed_buses": ["750"],
+      "id": 8
+    }
+    Ответ:
+    {
+      "request_id": 8,
+      "version": 1
+    }
+      - stops и buses — новые остановки и маршруты в формате base_requests (без ключа type);
+        остановка или маршрут с уже существующим названием заменяется. Расстояния от заменяемой
+        остановки задаются заново, расстояния до неё от других остановок сохраняются;
+      - closed_stops и closed_buses — названия закрываемых остановок и маршрутов. Через
+        закрываемую остановку не должны идти оставшиеся маршруты.
+    Все ключи, кроме type и id, необязательны. Изменения применяются вместе: следующие запросы
+    отвечаются по новой версии справочника, а version — её номер
+    (база - версия 0). Если в изменениях есть ошибка, справочник не меняется, а ответ содержит
+    "error_message" с её описанием.
+    */
+    json::Node JsonReader::RequestUpdate(const json::Node& value) {
+        const json::Dict& dict = value.AsDict();
+        versioned_catalogue::CatalogueUpdate update;
+        if (const auto stops = dict.find("stops"s); stops != dict.end()) {
+            for (const json::Node& stop : stops->second.AsArray()) {
+                versioned_catalogue::StopChange change;
+                change.name = stop.AsDict().at("name"s).AsString();
+                change.coordinates = {stop.AsDict().at("latitude"s).AsDouble(), stop.AsDict().at("longitude"s).AsDouble()};
+                if (const auto distances = stop.AsDict().find("road_distances"s); distances != stop.AsDict().end()) {
+                    for (const auto& [to_stop_name, distance] : distances->second.AsDict()) {
+                        change.road_distances.emplace_back(to_stop_name, static_cast<uint64_t>(distance.AsInt()));
+                    }
+                }
+                update.stops.push_back(std::move(change));
+            }
+        }
+        if (const auto buses = dict.find("buses"s); buses != dict.end()) {
+            for (const json::Node& bus : buses->second.AsArray()) {
+                versioned_catalogue::RouteChange change;
+                change.name = bus.AsDict().at("name"s).AsString();
+                change.type = bus.AsDict().at("is_roundtrip"s).AsBool() ? RouteType::CIRCLE : RouteType::LINEAR;
+                for (const json::Node& stop : bus.AsDict().at("stops"s).AsArray()) {
+                    change.stops.push_back(stop.AsString());
+                }
+                update.routes.push_back(std::move(change));
+            }
+        }
+        const auto read_names = [&dict](const std::string& key, std::vector<std::string>& names) {
+            if (const auto node = dict.find(key); node != dict.end()) {
+                for (const json::Node& name : node->second.AsArray()) {
+                    names.push_back(name.AsString());
+                }
+            }
+        };
+        read_names("closed_stops"s, update.closed_stops);
+        read_names("closed_buses"s, update.closed_routes);
+
+        try {
+            const uint64_t version = handler_.ApplyUpdate(update);
+            return json::Builder{}.StartDict()
+                    .Key("request_id"s).Value(dict.at("id"s).AsInt())
+                    .Key("version"s).Value(version)
+                    .EndDict().Build();
+        } catch (const std::invalid_argument& err) {
+            return json::Builder{}.StartDict()
+                    .Key("request_id"s).Value(dict.at("id"s).AsInt())
+                    .Key("error_message"s).Value(std::string(err.what()))
+                    .EndDict().Build();
+        }
+    }
+
     //------------------render-------------------------
 
     /* Структура словаря render_settings:
@@ -628,16 +856,117 @@ namespace json_reader
 
     // transport router ------------------------------------------------------------------------
 
+    /*
+    Дополнительные (необязательные) ключи routing_settings:
+        router_engine — способ поиска маршрутов:
+            "all_pairs" — маршруты между всеми парами остановок рассчитываются при make_base (по умолчанию);
+            "dijkstra" — маршрут ищется по запросу, память и время подготовки линейны относительно графа;
+            "astar", "bidirectional_astar" — поиск по запросу A* (односторонний или двунаправленный)
+                с оценкой оставшегося времени по расстоянию между остановками по прямой;
+            "contraction_hierarchy" — иерархия сжатия строится при make_base и сохраняется в базе,
+                маршрут ищется двунаправленным поиском по ней.
+        route_cache_size — сколько деревьев кратчайших путей от последних остановок отправления
+            хранить в кэше для "dijkstra". Целое неотрицательное число, по умолчанию 64.
+        all_pairs_build — как рассчитывать таблицу маршрутов для "all_pairs":
+            "floyd_warshall" — алгоритм Флойда-Уоршелла (по умолчанию);
+            "dijkstra" — поиск Дейкстры из каждой остановки, быстрее на разреженных графах.
+        router_threads — число потоков расчёта таблицы маршрутов; 0 (по умолчанию) — по числу ядер.
+        routes_table — формат таблицы маршрутов для "all_pairs":
+            "wide" — веса double и 64-битные id рёбер, 16 байт на пару остановок (по умолчанию);
+            "compact" — веса в миллисекундах (32 бита) и 32-битные id рёбер, 8 байт на пару остановок.
+        graph_model — модель графа маршрутов:
+            "stop_pairs" — ребро на каждую пару остановок маршрута (по умолчанию);
+            "stop_bus_states" — вершины "ожидание на остановке" и "в автобусе на остановке",
+                рёбра посадки, поездки по перегону и высадки; рёбер линейно относительно длины маршрута.
+    */
     void JsonReader::SetRoutingSettings(const json::Dict& dict) {
-        handler_.SetRoutingSettings({dict.at("bus_wait_time"s).AsInt(),
-                                     dict.at("bus_velocity"s).AsDouble()});
+        RoutingSettings settings;
+        settings.bus_wait_time = dict.at("bus_wait_time"s).AsInt();
+        settings.bus_velocity = dict.at("bus_velocity"s).AsDouble();
+
+        if (const auto engine = dict.find("router_engine"s); engine != dict.end()) {
+            if (engine->second.AsString() == "all_pairs"s) {
+                settings.router_engine = RouterEngine::ALL_PAIRS;
+            } else if (engine->second.AsString() == "dijkstra"s) {
+                settings.router_engine = RouterEngine::DIJKSTRA;
+            } else if (engine->second.AsString() == "astar"s) {
+                settings.router_engine = RouterEngine::ASTAR;
+            } else if (engine->second.AsString() == "bidirectional_astar"s) {
+                settings.router_engine = RouterEngine::BIDIRECTIONAL_ASTAR;
+            } else if (engine->second.AsString() == "contraction_hierarchy"s) {
+                settings.router_engine = RouterEngine::CONTRACTION_HIERARCHY;
+            } else {
+                throw std::logic_error("Unknown router_engine: "s + engine->second.AsString());
+            }
+        }
+        if (const auto cache_size = dict.find("route_cache_size"s); cache_size != dict.end()) {
+            settings.route_cache_size = static_cast<size_t>(cache_size->second.AsInt());
+        }
+        if (const auto build = dict.find("all_pairs_build"s); build != dict.end()) {
+            if (build->second.AsString() == "floyd_warshall"s) {
+                settings.all_pairs_build = AllPairsBuild::FLOYD_WARSHALL;
+            } else if (build->second.AsString() == "dijkstra"s) {
+                settings.all_pairs_build = AllPairsBuild::DIJKSTRA;
+            } else {
+                throw std::logic_error("Unknown all_pairs_build: "s + build->second.AsString());
+            }
+        }
+        if (const auto threads = dict.find("router_threads"s); threads != dict.end()) {
+            settings.router_threads = static_cast<size_t>(threads->second.AsInt());
+        }
+        if (const auto table = dict.find("routes_table"s); table != dict.end()) {
+            if (table->second.AsString() == "wide"s) {
+                settings.routes_table = RoutesTableFormat::WIDE;
+            } else if (table->second.AsString() == "compact"s) {
+                settings.routes_table = RoutesTableFormat::COMPACT;
+            } else {
+                throw std::logic_error("Unknown routes_table: "s + table->second.AsString());
+            }
+        }
+        if (const auto model = dict.find("graph_model"s); model != dict.end()) {
+            if (model->second.AsString() == "stop_pairs"s) {
+                settings.graph_model = GraphModel::STOP_PAIRS;
+            } else if (model->second.AsString() == "stop_bus_states"s) {
+                settings.graph_model = GraphModel::STOP_BUS_STATES;
+            } else {
+                throw std::logic_error("Unknown graph_model: "s + model->second.AsString());
+            }
+        }
+
+        handler_.SetRoutingSettings(settings);
     }
 
     // serialization ---------------------------------------------------------------------------
 
+    /*
+        file — файл базы.
+        format — формат базы при make_base: "protobuf" (по умолчанию), "mapped" — база для
+            отображения в память или "compact" — наименьший файл. При process_requests формат
+            определяется по файлу.
+        verify_checksums — проверять ли контрольные суммы разделов базы "mapped", по умолчанию true.
+        shared_image — файл образа базы в общей памяти для process_requests (например, в /dev/shm);
+            первый обработчик собирает образ, остальные подключаются к нему.
+    */
     void JsonReader::SetSerializationSettings(const json::Dict& dict) {
         serialization::SerializationSettings settings;
         settings.file_name = dict.at("file"s).AsString();
+        if (const auto format = dict.find("format"s); format != dict.end()) {
+            if (format->second.AsString() == "protobuf"s) {
+                settings.format = serialization::BaseFormat::PROTOBUF;
+            } else if (format->second.AsString() == "mapped"s) {
+                settings.format = serialization::BaseFormat::MAPPED;
+            } else if (format->second.AsString() == "compact"s) {
+                settings.format = serialization::BaseFormat::COMPACT;
+            } else {
+                throw std::logic_error("Unknown format: "s + format->second.AsString());
+            }
+        }
+        if (const auto verify = dict.find("verify_checksums"s); verify != dict.end()) {
+            settings.verify_checksums = verify->second.AsBool();
+        }
+        if (const auto image = dict.find("shared_image"s); image != dict.end()) {
+            settings.shared_image = image->second.AsString();
+        }
         handler_.SetSerializationSettings(settings);
     }
 
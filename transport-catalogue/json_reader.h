@@ -46,6 +46,10 @@ private:
     json::Node RequestBus(const json::Node& value);
     json::Node RequestMap(const json::Node& value);
     json::Node RequestRoute(const json::Node& value);
+    json::Node RequestSegment(const json::Node& value);
+    json::Node RequestNearbyStops(const json::Node& value);
+    json::Node RequestSuggestStops(const json::Node& value);
+    json::Node RequestUpdate(const json::Node& value);
 
     // render -------------------------------------------------------------------
 
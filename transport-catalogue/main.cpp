@@ -1,5 +1,7 @@
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
 #include <string_view>
 
 #include "json_reader.h"
@@ -10,16 +12,57 @@ using namespace std::literals;
 using namespace transport_catalogue;
 
 void PrintUsage(std::ostream& stream = std::cerr) {
-	stream << "Usage: transport_catalogue [make_base|process_requests]\n"sv;
+	stream << "Usage: transport_catalogue [make_base|process_requests] [--stats]\n"sv;
+}
+
+// выводит время построения таблицы маршрутов по потокам
+void PrintRouterBuildStatistics(const request_handler::RequestHandler& handler, std::ostream& stream = std::cerr) {
+	const auto* statistics = handler.GetRouterBuildStatistics();
+	if (statistics == nullptr) {
+		return;
+	}
+	using Milliseconds = std::chrono::duration<double, std::milli>;
+	stream << "Router build ("sv
+		<< (statistics->algorithm == graph::AllPairsAlgorithm::DIJKSTRA ? "dijkstra"sv : "floyd_warshall"sv)
+		<< "): "sv << Milliseconds(statistics->duration).count() << " ms\n"sv;
+	for (size_t n = 0; n < statistics->threads.size(); ++n) {
+		const auto& thread = statistics->threads[n];
+		stream << "  thread "sv << n << ": "sv << thread.tasks << " tasks, "sv << thread.steals << " steals, "sv
+			<< Milliseconds(thread.busy).count() << " ms busy\n"sv;
+	}
+}
+
+// выводит время построения иерархии сжатия и число сокращений
+void PrintHierarchyBuildStatistics(const request_handler::RequestHandler& handler, std::ostream& stream = std::cerr) {
+	const auto* statistics = handler.GetHierarchyBuildStatistics();
+	if (statistics == nullptr) {
+		return;
+	}
+	using Milliseconds = std::chrono::duration<double, std::milli>;
+	stream << "Contraction hierarchy build: "sv << Milliseconds(statistics->duration).count() << " ms, "sv
+		<< statistics->shortcut_count << " shortcuts\n"sv;
+}
+
+// выводит число вершин, просмотренных при поиске маршрутов по запросу
+void PrintRouteSearchStatistics(const request_handler::RequestHandler& handler, std::ostream& stream = std::cerr) {
+	const auto statistics = handler.GetRouteSearchStatistics();
+	if (!statistics || statistics->queries == 0) {
+		return;
+	}
+	stream << "Route search: "sv << statistics->queries << " searches, "sv << statistics->settled_vertices
+		<< " settled vertices ("sv << static_cast<double>(statistics->settled_vertices) / statistics->queries
+		<< " per search)\n"sv;
 }
 
 int main(int argc, char* argv[]) {
-	if (argc != 2) {
+	// --stats: статистика построения маршрутизатора и поиска маршрутов выводится в stderr
+	if (argc != 2 && !(argc == 3 && argv[2] == "--stats"sv)) {
 		PrintUsage();
 		return 1;
 	}
 
 	const std::string_view mode(argv[1]);
+	const bool print_statistics = argc == 3;
 
 	TransportCatalogue tc;
 	renderer::MapRenderer map_render;
@@ -33,10 +76,25 @@ int main(int argc, char* argv[]) {
 
 	if (mode == "make_base"sv) {
 
+		// фиксируем названия и расстояния и рассчитываем информацию о маршрутах и остановках, строим сетку остановок
+		handler.FreezeNames();
+		handler.FreezeDistances();
+		handler.BuildRouteInfos();
+		handler.BuildStopRoutes();
+		handler.BuildStopIndex();
 		// инициализируем router (строим graph)
 		handler.RouterInitializeGraph();
-		// сохраняем в файл
-		serialization.SaveTo();
+		if (print_statistics) {
+			PrintRouterBuildStatistics(handler);
+			PrintHierarchyBuildStatistics(handler);
+		}
+		// сохраняем в файл; база, которую не удалось записать, - ошибка
+		try {
+			serialization.SaveTo();
+		} catch (const std::runtime_error& error) {
+			std::cerr << error.what() << '\n';
+			return 1;
+		}
 
 	}
 	else if (mode == "process_requests"sv) {
@@ -45,6 +103,9 @@ int main(int argc, char* argv[]) {
 		serialization.LoadFrom();
 		// обрабатываем stat_requests
         json_reader.HandleStatRequests();
+		if (print_statistics) {
+			PrintRouteSearchStatistics(handler);
+		}
 		
 	}
 	else {
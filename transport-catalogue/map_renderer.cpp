@@ -1,5 +1,7 @@
 #include "map_renderer.h"
 
+#include <map>
+
 namespace renderer
 {
     using namespace std::literals;
@@ -94,7 +96,7 @@ namespace renderer
             return {};
         }
         svg::Point point = sphere_proj(route->stops.front()->coordinate);
-        auto [text_1, text_2] = FillingText(route->name, point);
+        auto [text_1, text_2] = FillingText(std::string(route->name), point);
         if ((route->route_type == RouteType::CIRCLE) || (route->stops.size() == 1) || (route->stops.front() == route->stops.back())) {
             const_cast<MapRenderer*>(this)->ChangeCountColor();
             return { { text_1, text_2 } };
@@ -102,7 +104,7 @@ namespace renderer
         std::vector<std::pair<svg::Text, svg::Text>> result;
         result.push_back({ text_1, text_2 });
         point = sphere_proj(route->stops.back()->coordinate);
-        auto [text_1_, text_2_] = FillingText(route->name, point);
+        auto [text_1_, text_2_] = FillingText(std::string(route->name), point);
         result.push_back({ text_1_, text_2_ });
         const_cast<MapRenderer*>(this)->ChangeCountColor();
         return result;
@@ -121,24 +123,27 @@ namespace renderer
         svg::Point point = sphere_proj(stop->coordinate);
         text_1.SetPosition(point).SetOffset(render_settings_.stop_label_offset).
             SetFontSize(render_settings_.stop_label_font_size).SetFontFamily("Verdana"s).
-            SetData(stop->name).SetFillColor(render_settings_.underlayer_color).SetStrokeColor(render_settings_.underlayer_color).
+            SetData(std::string(stop->name)).SetFillColor(render_settings_.underlayer_color).SetStrokeColor(render_settings_.underlayer_color).
             SetStrokeWidth(render_settings_.underlayer_width).SetStrokeLineCap(svg::StrokeLineCap::ROUND).
             SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
         text_2.SetPosition(point).SetOffset(render_settings_.stop_label_offset).
             SetFontSize(render_settings_.stop_label_font_size).SetFontFamily("Verdana"s).
-            SetData(stop->name).SetFillColor("black");
+            SetData(std::string(stop->name)).SetFillColor("black");
         return { text_1, text_2 };
     }
    
     svg::Document MapRenderer::CreateMap(const transport_catalogue::TransportCatalogue& catalogue) const {
-        std::set<std::string_view> stops_names;
-        std::set<std::string_view> buses_names;
+        // маршруты и остановки на них рисуются в порядке названий
+        std::map<std::string_view, const Route*> all_buses;
+        std::map<std::string_view, const Stop*> all_stops;
         std::vector<geo::Coordinates> coordinates_stops;
-        std::unordered_map<std::string_view, const Route*> all_buses = catalogue.GetAllRoutes();
+        for (uint32_t id = 0; id < catalogue.GetNumberRoutes(); ++id) {
+            const Route* struct_bus = catalogue.GetRouteById(id);
+            all_buses[struct_bus->name] = struct_bus;
+        }
         for (const auto& [bus_name, struct_bus] : all_buses) {
-            buses_names.insert(bus_name);
             for (auto stop : struct_bus->stops) {
-                auto [_, status] = stops_names.insert(stop->name);
+                auto [_, status] = all_stops.emplace(stop->name, stop);
                 if (status) {
                     coordinates_stops.push_back(stop->coordinate);
                 }
@@ -147,16 +152,16 @@ namespace renderer
         renderer::SphereProjector sphere_proj(coordinates_stops.begin(), coordinates_stops.end(),
                    render_settings_.width, render_settings_.height, render_settings_.padding);
         svg::Document doc;
-        for (std::string_view bus : buses_names) {
-            std::optional<svg::Polyline> poly = this->CreateRouteLine(all_buses.at(bus), sphere_proj);
+        for (const auto& [bus_name, struct_bus] : all_buses) {
+            std::optional<svg::Polyline> poly = this->CreateRouteLine(struct_bus, sphere_proj);
             if (poly == std::nullopt) {
                 continue;
             }
             doc.Add(*poly);
         }
         this->ResetColorCount();
-        for (std::string_view bus : buses_names) {
-            auto text = this->CreateRouteName(all_buses.at(bus), sphere_proj);
+        for (const auto& [bus_name, struct_bus] : all_buses) {
+            auto text = this->CreateRouteName(struct_bus, sphere_proj);
             if (text.empty()) {
                 continue;
             }
@@ -167,13 +172,12 @@ namespace renderer
                 doc.Add(text[1].second);
             }
         }
-        const std::unordered_map <std::string_view, const Stop*>& all_stops = catalogue.GetAllStops();
-        for (std::string_view stop : stops_names) {
-            svg::Circle circle = this->CreateStopsSymbol(all_stops.at(stop), sphere_proj);
+        for (const auto& [stop_name, stop] : all_stops) {
+            svg::Circle circle = this->CreateStopsSymbol(stop, sphere_proj);
             doc.Add(circle);
         }
-        for (std::string_view stop : stops_names) {
-            auto text = this->CreateStopsName(all_stops.at(stop), sphere_proj);
+        for (const auto& [stop_name, stop] : all_stops) {
+            auto text = this->CreateStopsName(stop, sphere_proj);
             doc.Add(text.first);
             doc.Add(text.second);
         }
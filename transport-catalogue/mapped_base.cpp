@@ -0,0 +1,303 @@
+#include "mapped_base.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <new>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace serialization {
+
+namespace {
+
+size_t AlignUp(size_t size) {
+    return (size + MAPPED_BASE_ALIGNMENT - 1) / MAPPED_BASE_ALIGNMENT * MAPPED_BASE_ALIGNMENT;
+}
+
+// контрольная сумма полей заголовка до header_checksum
+uint64_t ComputeHeaderChecksum(const MappedBaseHeader& header) {
+    return ComputeChecksum(reinterpret_cast<const char*>(&header), offsetof(MappedBaseHeader, header_checksum));
+}
+
+}  // namespace
+
+// MappedFile ----------------------------------------------------------------
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+#ifdef __linux__
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open mapped base " + path.string());
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot open mapped base " + path.string());
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ > 0) {
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Cannot map base " + path.string());
+        }
+        data_ = static_cast<const char*>(data);
+        mapped_ = true;
+#ifdef MADV_HUGEPAGE
+        // для файла в tmpfs (образ в общей памяти) ядро может отдать большие страницы;
+        // для обычного файла совет игнорируется
+        madvise(data, size_, MADV_HUGEPAGE);
+#endif
+    }
+    // отображение остаётся действительным и после закрытия файла
+    close(fd);
+#else
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("Cannot open mapped base " + path.string());
+    }
+    const std::string content((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    size_ = content.size();
+    char* data = static_cast<char*>(::operator new(size_, std::align_val_t{MAPPED_BASE_ALIGNMENT}));
+    std::copy(content.begin(), content.end(), data);
+    data_ = data;
+#endif
+}
+
+MappedFile::~MappedFile() {
+    if (data_ == nullptr) {
+        return;
+    }
+#ifdef __linux__
+    if (mapped_) {
+        munmap(const_cast<char*>(data_), size_);
+        return;
+    }
+#endif
+    ::operator delete(const_cast<char*>(data_), std::align_val_t{MAPPED_BASE_ALIGNMENT});
+}
+
+const char* MappedFile::GetData() const {
+    return data_;
+}
+
+size_t MappedFile::GetSize() const {
+    return size_;
+}
+
+// FileLock ------------------------------------------------------------------
+
+FileLock::FileLock([[maybe_unused]] const std::filesystem::path& path) {
+#ifdef __linux__
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        return;
+    }
+    int result = flock(fd_, LOCK_EX);
+    while (result != 0 && errno == EINTR) {
+        result = flock(fd_, LOCK_EX);
+    }
+    if (result != 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+#endif
+}
+
+FileLock::~FileLock() {
+#ifdef __linux__
+    // закрытие файла снимает блокировку
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+#endif
+}
+
+bool FileLock::IsLocked() const {
+    return fd_ >= 0;
+}
+
+// контрольная сумма ---------------------------------------------------------
+
+uint64_t ComputeChecksum(const char* data, size_t size) {
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ size;
+    size_t n = 0;
+    for (; n + sizeof(uint64_t) <= size; n += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + n, sizeof(word));
+        hash = (hash ^ word) * 0xbf58476d1ce4e5b9ULL;
+        hash ^= hash >> 31;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, data + n, size - n);
+    hash = (hash ^ tail) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 29);
+}
+
+bool IsMappedBase(const std::filesystem::path& path) {
+    std::ifstream input(path, std::ios::binary);
+    char magic[sizeof(MAPPED_BASE_MAGIC)];
+    return input.read(magic, sizeof(magic)) && std::equal(std::begin(magic), std::end(magic), MAPPED_BASE_MAGIC);
+}
+
+// MappedBaseWriter ----------------------------------------------------------
+
+std::string_view MappedBaseWriter::Section::GetData() const {
+    return data != nullptr ? std::string_view(data, header.size) : std::string_view(owned);
+}
+
+void MappedBaseWriter::AddBytes(uint32_t id, std::string bytes) {
+    AddSection(id, 1, nullptr, 0, std::move(bytes));
+}
+
+void MappedBaseWriter::AddSection(uint32_t id, uint32_t element_size, const char* data, size_t size,
+                                  std::string owned) {
+    Section section;
+    section.header.id = id;
+    section.header.element_size = element_size;
+    section.header.offset = 0;
+    section.header.size = data != nullptr ? size : owned.size();
+    section.data = data;
+    section.owned = std::move(owned);
+    const std::string_view bytes = section.GetData();
+    section.header.checksum = ComputeChecksum(bytes.data(), bytes.size());
+    sections_.push_back(std::move(section));
+}
+
+bool MappedBaseWriter::WriteTo(const std::filesystem::path& path) const {
+    std::vector<MappedSection> table;
+    table.reserve(sections_.size());
+    size_t offset = AlignUp(sizeof(MappedBaseHeader) + sections_.size() * sizeof(MappedSection));
+    for (const Section& section : sections_) {
+        table.push_back(section.header);
+        table.back().offset = offset;
+        offset = AlignUp(offset + section.header.size);
+    }
+
+    MappedBaseHeader header{};
+    std::copy(std::begin(MAPPED_BASE_MAGIC), std::end(MAPPED_BASE_MAGIC), header.magic);
+    header.version = MAPPED_BASE_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.file_size = offset;
+    header.section_count = static_cast<uint32_t>(table.size());
+    header.table_checksum = ComputeChecksum(reinterpret_cast<const char*>(table.data()),
+                                            table.size() * sizeof(MappedSection));
+    header.header_checksum = ComputeHeaderChecksum(header);
+
+    std::ofstream output(path, std::ios::binary);
+    if (!output) {
+        return false;
+    }
+    const char padding[MAPPED_BASE_ALIGNMENT] = {};
+    size_t written = 0;
+    const auto write = [&output, &written](const char* data, size_t size) {
+        output.write(data, static_cast<std::streamsize>(size));
+        written += size;
+    };
+    write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(MappedSection));
+    for (size_t n = 0; n < sections_.size(); ++n) {
+        write(padding, table[n].offset - written);
+        const std::string_view bytes = sections_[n].GetData();
+        write(bytes.data(), bytes.size());
+    }
+    write(padding, offset - written);
+    return static_cast<bool>(output);
+}
+
+// MappedBase ----------------------------------------------------------------
+
+MappedBase::MappedBase(const std::filesystem::path& path, bool verify_sections)
+    : file_(std::make_shared<MappedFile>(path)) {
+    const char* data = file_->GetData();
+    const size_t size = file_->GetSize();
+    MappedBaseHeader header;
+    if (size < sizeof(header)) {
+        throw std::runtime_error("Mapped base is truncated");
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (!std::equal(std::begin(MAPPED_BASE_MAGIC), std::end(MAPPED_BASE_MAGIC), header.magic)) {
+        throw std::runtime_error("Not a mapped base");
+    }
+    if (header.byte_order != BYTE_ORDER_MARK) {
+        throw std::runtime_error("Mapped base has a different byte order");
+    }
+    if (header.version != MAPPED_BASE_VERSION) {
+        throw std::runtime_error("Unsupported mapped base version");
+    }
+    if (header.header_checksum != ComputeHeaderChecksum(header) || header.file_size != size
+            || header.section_count > (size - sizeof(header)) / sizeof(MappedSection)) {
+        throw std::runtime_error("Mapped base header is corrupted");
+    }
+    const char* table = data + sizeof(header);
+    const size_t table_size = header.section_count * sizeof(MappedSection);
+    if (header.table_checksum != ComputeChecksum(table, table_size)) {
+        throw std::runtime_error("Mapped base section table is corrupted");
+    }
+    sections_.resize(header.section_count);
+    std::memcpy(sections_.data(), table, table_size);
+    for (const MappedSection& section : sections_) {
+        if (section.offset % MAPPED_BASE_ALIGNMENT != 0 || section.offset > size || section.size > size - section.offset
+                || section.element_size == 0 || section.size % section.element_size != 0) {
+            throw std::runtime_error("Mapped base section table is corrupted");
+        }
+    }
+    verified_.assign(sections_.size(), !verify_sections);
+}
+
+bool MappedBase::HasSection(uint32_t id) const {
+    return std::any_of(sections_.begin(), sections_.end(), [id](const MappedSection& section) {
+        return section.id == id;
+    });
+}
+
+std::string_view MappedBase::GetBytes(uint32_t id) const {
+    const MappedSection& section = GetSection(id, 1);
+    return {file_->GetData() + section.offset, section.size};
+}
+
+std::shared_ptr<const MappedFile> MappedBase::GetOwner() const {
+    return file_;
+}
+
+void MappedBase::VerifySections() const {
+    for (size_t n = 0; n < sections_.size(); ++n) {
+        VerifySection(n);
+    }
+}
+
+void MappedBase::VerifySection(size_t index) const {
+    if (verified_[index]) {
+        return;
+    }
+    const MappedSection& section = sections_[index];
+    if (section.checksum != ComputeChecksum(file_->GetData() + section.offset, section.size)) {
+        throw std::runtime_error("Mapped base section " + std::to_string(section.id) + " is corrupted");
+    }
+    verified_[index] = true;
+}
+
+const MappedSection& MappedBase::GetSection(uint32_t id, size_t element_size) const {
+    const auto section = std::find_if(sections_.begin(), sections_.end(), [id](const MappedSection& section) {
+        return section.id == id;
+    });
+    if (section == sections_.end()) {
+        throw std::runtime_error("Mapped base has no section " + std::to_string(id));
+    }
+    if (section->element_size != element_size) {
+        throw std::runtime_error("Mapped base section " + std::to_string(id) + " has a different layout");
+    }
+    VerifySection(static_cast<size_t>(section - sections_.begin()));
+    return *section;
+}
+
+}  // namespace serialization
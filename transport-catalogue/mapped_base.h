@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "frozen_array.h"
+
+namespace serialization {
+
+// MappedFile - файл, отображённый в память только для чтения. В Linux страницы подгружаются
+// при первом обращении и разделяются между процессами через кэш страниц; на других
+// платформах файл читается в память целиком.
+class MappedFile {
+public:
+    explicit MappedFile(const std::filesystem::path& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const char* GetData() const;
+    size_t GetSize() const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+};
+
+// FileLock - исключительная блокировка файла на время жизни объекта (flock в Linux); файл
+// создаётся, если его нет. Конструктор ждёт, пока блокировку снимет другой процесс. Если файл
+// не открылся или на платформе нет flock, объект ничего не блокирует (IsLocked - false).
+class FileLock {
+public:
+    explicit FileLock(const std::filesystem::path& path);
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+    ~FileLock();
+
+    bool IsLocked() const;
+
+private:
+    int fd_ = -1;
+};
+
+// Формат отображаемой базы:
+//   заголовок (MappedBaseHeader), таблица разделов (MappedSection по числу разделов),
+//   данные разделов, каждый с границы MAPPED_BASE_ALIGNMENT байт.
+// Разделы - массивы значений в представлении машины, которая записала базу; положение данных
+// задаётся смещениями от начала файла. Порядок байтов проверяется по метке в заголовке, а
+// заголовок, таблица разделов и каждый раздел - по контрольным суммам.
+struct MappedBaseHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;   // BYTE_ORDER_MARK в порядке байтов записавшей машины
+    uint64_t file_size;
+    uint32_t section_count;
+    uint32_t reserved;
+    uint64_t table_checksum; // контрольная сумма таблицы разделов
+    uint64_t header_checksum; // контрольная сумма предыдущих полей заголовка
+};
+
+struct MappedSection {
+    uint32_t id;
+    uint32_t element_size; // размер элемента массива в байтах
+    uint64_t offset;
+    uint64_t size;
+    uint64_t checksum;
+};
+
+constexpr char MAPPED_BASE_MAGIC[8] = {'T', 'C', 'B', 'A', 'S', 'E', '\0', '\0'};
+constexpr uint32_t MAPPED_BASE_VERSION = 2;
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+constexpr size_t MAPPED_BASE_ALIGNMENT = 64;
+
+// контрольная сумма блока: перемешивание 64-битных слов
+uint64_t ComputeChecksum(const char* data, size_t size);
+
+// true, если файл начинается с заголовка отображаемой базы
+bool IsMappedBase(const std::filesystem::path& path);
+
+// MappedBaseWriter - собирает разделы и записывает базу одним проходом. Массивы не
+// копируются: они должны жить до WriteTo. Значения и строки копируются.
+class MappedBaseWriter {
+public:
+    template <typename T>
+    void AddArray(uint32_t id, const T* data, size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        AddSection(id, sizeof(T), reinterpret_cast<const char*>(data), count * sizeof(T), {});
+    }
+
+    template <typename T>
+    void AddArray(uint32_t id, const std::vector<T>& values) {
+        AddArray(id, values.data(), values.size());
+    }
+
+    template <typename T>
+    void AddArray(uint32_t id, const ranges::FrozenArray<T>& values) {
+        AddArray(id, values.data(), values.size());
+    }
+
+    template <typename T>
+    void AddValue(uint32_t id, const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        AddSection(id, sizeof(T), nullptr, 0, std::string(reinterpret_cast<const char*>(&value), sizeof(T)));
+    }
+
+    void AddBytes(uint32_t id, std::string bytes);
+
+    // false, если файл не удалось записать
+    bool WriteTo(const std::filesystem::path& path) const;
+
+private:
+    struct Section {
+        MappedSection header;
+        const char* data;  // данные вызывающего или nullptr, если они в owned
+        std::string owned;
+
+        std::string_view GetData() const;
+    };
+    std::vector<Section> sections_;
+
+    void AddSection(uint32_t id, uint32_t element_size, const char* data, size_t size, std::string owned);
+};
+
+// MappedBase - отображённая в память база. Разделы читаются на месте; отображение живёт,
+// пока живы MappedBase и все полученные из GetOwner() ссылки. Контрольная сумма раздела
+// проверяется при первом обращении к нему, поэтому страницы ненужных разделов не читаются.
+// Не потокобезопасен.
+class MappedBase {
+public:
+    // открывает базу и проверяет заголовок и таблицу разделов; verify_sections - проверять ли
+    // контрольные суммы данных разделов. Бросает std::runtime_error для повреждённой или
+    // несовместимой базы
+    MappedBase(const std::filesystem::path& path, bool verify_sections);
+
+    bool HasSection(uint32_t id) const;
+
+    // данные раздела как массив T; бросает std::runtime_error, если раздела нет или
+    // размер элемента не совпадает
+    template <typename T>
+    std::pair<const T*, size_t> GetArray(uint32_t id) const {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const MappedSection& section = GetSection(id, sizeof(T));
+        return {reinterpret_cast<const T*>(file_->GetData() + section.offset), section.size / sizeof(T)};
+    }
+
+    template <typename T>
+    std::vector<T> GetVector(uint32_t id) const {
+        const auto [data, count] = GetArray<T>(id);
+        return {data, data + count};
+    }
+
+    // данные раздела на месте, без копирования; массив держит отображение
+    template <typename T>
+    ranges::FrozenArray<T> GetFrozenArray(uint32_t id) const {
+        const auto [data, count] = GetArray<T>(id);
+        return {file_, data, count};
+    }
+
+    template <typename T>
+    T GetValue(uint32_t id) const {
+        const auto [data, count] = GetArray<T>(id);
+        if (count != 1) {
+            throw std::runtime_error("Mapped base section is not a single value");
+        }
+        return *data;
+    }
+
+    std::string_view GetBytes(uint32_t id) const;
+
+    // владелец отображения для данных, которые используются на месте
+    std::shared_ptr<const MappedFile> GetOwner() const;
+
+    // проверяет контрольные суммы всех ещё не проверенных разделов
+    void VerifySections() const;
+
+private:
+    std::shared_ptr<const MappedFile> file_;
+    std::vector<MappedSection> sections_;
+    // проверен ли раздел sections_[n]; без проверки разделов все отмечены сразу
+    mutable std::vector<bool> verified_;
+
+    void VerifySection(size_t index) const;
+
+    const MappedSection& GetSection(uint32_t id, size_t element_size) const;
+};
+
+}  // namespace serialization
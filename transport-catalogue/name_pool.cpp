@@ -0,0 +1,233 @@
+#include "name_pool.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+namespace transport_catalogue {
+
+void NamePool::Load(std::string_view block, const std::vector<uint32_t>& lengths,
+                    std::optional<PerfectHash::Data> index, std::vector<uint32_t> sorted_ids) {
+    if (!names_.empty()) {
+        throw std::logic_error("Name pool is not empty");
+    }
+    blocks_.push_back(std::make_unique<char[]>(block.size()));
+    char* data = blocks_.back().get();
+    std::copy(block.begin(), block.end(), data);
+    names_.reserve(lengths.size());
+    size_t offset = 0;
+    for (const uint32_t length : lengths) {
+        if (length > block.size() - offset) {
+            throw std::invalid_argument("Name lengths do not match name block");
+        }
+        names_.emplace_back(data + offset, length);
+        offset += length;
+    }
+    if (index) {
+        Freeze(std::move(*index), std::move(sorted_ids));
+    } else {
+        index_ = PerfectHash(names_);
+        if (!PlaceNames()) {
+            throw std::logic_error("Perfect hash does not separate names");
+        }
+        SortNames(std::move(sorted_ids));
+    }
+}
+
+void NamePool::Attach(std::shared_ptr<const void> owner, std::string_view block, const uint32_t* lengths,
+                      size_t count, PerfectHash::Data index, ranges::FrozenArray<uint32_t> name_ids_by_position,
+                      ranges::FrozenArray<uint32_t> sorted_ids) {
+    if (!names_.empty()) {
+        throw std::logic_error("Name pool is not empty");
+    }
+    if (count >= NO_NAME || name_ids_by_position.size() != count || sorted_ids.size() != count) {
+        throw std::invalid_argument("Name index does not match names");
+    }
+    names_.reserve(count);
+    size_t offset = 0;
+    for (size_t id = 0; id < count; ++id) {
+        if (lengths[id] > block.size() - offset) {
+            throw std::invalid_argument("Name lengths do not match name block");
+        }
+        names_.emplace_back(block.data() + offset, lengths[id]);
+        offset += lengths[id];
+    }
+    const auto in_range = [count](uint32_t id) {
+        return id < count;
+    };
+    if (!std::all_of(name_ids_by_position.begin(), name_ids_by_position.end(), in_range)
+            || !std::all_of(sorted_ids.begin(), sorted_ids.end(), in_range)) {
+        throw std::invalid_argument("Name index does not match names");
+    }
+    index_ = PerfectHash(std::move(index), count);
+    name_ids_by_position_ = std::move(name_ids_by_position);
+    sorted_ids_ = std::move(sorted_ids);
+    owner_ = std::move(owner);
+    frozen_ = true;
+}
+
+uint32_t NamePool::Add(std::string_view name) {
+    const uint32_t found_id = Find(name);
+    if (found_id != NO_NAME) {
+        return found_id;
+    }
+    if (frozen_) {
+        throw std::logic_error("Name pool is frozen");
+    }
+    if (names_.size() >= NO_NAME - 1) {
+        throw std::out_of_range("Too many names");
+    }
+    if ((names_.size() + 1) * 2 > slots_.size()) {
+        Rehash(std::max<size_t>(16, slots_.size() * 2));
+    }
+    char* data = Allocate(name.size());
+    std::copy(name.begin(), name.end(), data);
+    const uint32_t id = static_cast<uint32_t>(names_.size());
+    names_.emplace_back(data, name.size());
+    slots_[FindSlot(name)] = id;
+    return id;
+}
+
+uint32_t NamePool::Find(std::string_view name) const {
+    if (frozen_) {
+        if (names_.empty()) {
+            return NO_NAME;
+        }
+        const uint32_t id = name_ids_by_position_[index_(name)];
+        return names_[id] == name ? id : NO_NAME;
+    }
+    return slots_.empty() ? NO_NAME : slots_[FindSlot(name)];
+}
+
+void NamePool::Freeze() {
+    if (frozen_) {
+        return;
+    }
+    index_ = PerfectHash(names_);
+    if (!PlaceNames()) {
+        throw std::logic_error("Perfect hash does not separate names");
+    }
+    SortNames({});
+}
+
+void NamePool::Freeze(PerfectHash::Data index, std::vector<uint32_t> sorted_ids) {
+    index_ = PerfectHash(std::move(index), names_.size());
+    if (!PlaceNames()) {
+        throw std::invalid_argument("Perfect hash does not match names");
+    }
+    SortNames(std::move(sorted_ids));
+}
+
+bool NamePool::IsFrozen() const {
+    return frozen_;
+}
+
+const PerfectHash& NamePool::GetIndex() const {
+    return index_;
+}
+
+const ranges::FrozenArray<uint32_t>& NamePool::GetSortedIds() const {
+    return sorted_ids_;
+}
+
+const ranges::FrozenArray<uint32_t>& NamePool::GetNameIdsByPosition() const {
+    return name_ids_by_position_;
+}
+
+NamePool::IdsRange NamePool::FindByPrefix(std::string_view prefix) const {
+    if (!frozen_) {
+        throw std::logic_error("Name pool should be frozen");
+    }
+    // названия с началом prefix не меньше prefix и идут подряд сразу за меньшими
+    const auto begin = std::partition_point(sorted_ids_.begin(), sorted_ids_.end(), [this, prefix](uint32_t id) {
+        return names_[id] < prefix;
+    });
+    const auto end = std::partition_point(begin, sorted_ids_.end(), [this, prefix](uint32_t id) {
+        return names_[id].substr(0, prefix.size()) == prefix;
+    });
+    return {begin, end};
+}
+
+void NamePool::SortNames(std::vector<uint32_t> sorted_ids) {
+    const auto by_name = [this](uint32_t lhs, uint32_t rhs) {
+        return names_[lhs] < names_[rhs];
+    };
+    if (sorted_ids.empty() && !names_.empty()) {
+        sorted_ids.resize(names_.size());
+        for (uint32_t id = 0; id < names_.size(); ++id) {
+            sorted_ids[id] = id;
+        }
+        std::sort(sorted_ids.begin(), sorted_ids.end(), by_name);
+    } else {
+        // названия различны, поэтому правильный порядок строго возрастает и содержит каждый id
+        if (sorted_ids.size() != names_.size()) {
+            throw std::invalid_argument("Name order does not match names");
+        }
+        for (size_t n = 0; n < sorted_ids.size(); ++n) {
+            if (sorted_ids[n] >= names_.size() || (n > 0 && !by_name(sorted_ids[n - 1], sorted_ids[n]))) {
+                throw std::invalid_argument("Name order does not match names");
+            }
+        }
+    }
+    sorted_ids_ = std::move(sorted_ids);
+}
+
+bool NamePool::PlaceNames() {
+    std::vector<uint32_t> name_ids_by_position(names_.size(), NO_NAME);
+    for (uint32_t id = 0; id < names_.size(); ++id) {
+        uint32_t& position_id = name_ids_by_position[index_(names_[id])];
+        if (position_id != NO_NAME) {
+            return false;
+        }
+        position_id = id;
+    }
+    name_ids_by_position_ = std::move(name_ids_by_position);
+    // хеш-таблица пополнения больше не нужна
+    slots_ = {};
+    frozen_ = true;
+    return true;
+}
+
+std::string_view NamePool::Get(uint32_t id) const {
+    return names_.at(id);
+}
+
+size_t NamePool::Size() const {
+    return names_.size();
+}
+
+char* NamePool::Allocate(size_t size) {
+    if (size > block_free_) {
+        if (size > BLOCK_SIZE) {
+            // длинное название - в отдельный блок, остаток текущего блока не пропадает
+            blocks_.push_back(std::make_unique<char[]>(size));
+            return blocks_.back().get();
+        }
+        blocks_.push_back(std::make_unique<char[]>(BLOCK_SIZE));
+        block_next_ = blocks_.back().get();
+        block_free_ = BLOCK_SIZE;
+    }
+    char* data = block_next_;
+    block_next_ += size;
+    block_free_ -= size;
+    return data;
+}
+
+size_t NamePool::FindSlot(std::string_view name) const {
+    const size_t mask = slots_.size() - 1;
+    size_t slot = std::hash<std::string_view>{}(name) & mask;
+    while (slots_[slot] != NO_NAME && names_[slots_[slot]] != name) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void NamePool::Rehash(size_t slot_count) {
+    slots_.assign(slot_count, NO_NAME);
+    for (uint32_t id = 0; id < names_.size(); ++id) {
+        slots_[FindSlot(names_[id])] = id;
+    }
+}
+
+}  // namespace transport_catalogue
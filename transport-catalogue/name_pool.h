@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "frozen_array.h"
+#include "perfect_hash.h"
+#include "ranges.h"
+
+namespace transport_catalogue {
+
+// NamePool - пул названий остановок и маршрутов. Символы названий лежат подряд в больших
+// блоках, которые никогда не перемещаются, поэтому string_view названия действителен всё время
+// жизни пула. Одинаковые названия хранятся один раз; название определяется номером (id)
+// в порядке добавления. Пока пул пополняется, поиск по строке идёт по открытой хеш-таблице
+// из id. После заморозки (Freeze) набор названий фиксирован, и поиск идёт по минимальной
+// совершенной хеш-функции: одно обращение к таблице и одно сравнение строк. Кроме того,
+// замороженный пул хранит id названий в лексикографическом порядке: названия с заданным
+// началом занимают в нём непрерывный отрезок, который находится двумя двоичными поисками.
+class NamePool {
+public:
+    static constexpr uint32_t NO_NAME = std::numeric_limits<uint32_t>::max();
+
+    using IdsRange = ranges::Range<const uint32_t*>;
+
+    NamePool() = default;
+    // названия ссылаются на блоки пула, поэтому копировать его нельзя
+    NamePool(const NamePool&) = delete;
+    NamePool& operator=(const NamePool&) = delete;
+
+    // загружает названия, записанные подряд в block, с длинами lengths (id - по порядку), и
+    // замораживает пул с сохранённой хеш-функцией index и порядком названий sorted_ids, а без
+    // них - с построенными заново. Весь блок копируется за одно выделение памяти. Пул должен быть пуст
+    void Load(std::string_view block, const std::vector<uint32_t>& lengths,
+              std::optional<PerfectHash::Data> index, std::vector<uint32_t> sorted_ids);
+    // то же для замороженного пула в чужой памяти (например, в базе, отображённой в память):
+    // символы названий, хеш-функция, id названий по позициям хеш-функции и порядок названий
+    // используются на месте и живут, пока жив owner. Названия не хешируются и не сравниваются,
+    // id проверяются только на диапазон. Пул должен быть пуст
+    void Attach(std::shared_ptr<const void> owner, std::string_view block, const uint32_t* lengths, size_t count,
+                PerfectHash::Data index, ranges::FrozenArray<uint32_t> name_ids_by_position,
+                ranges::FrozenArray<uint32_t> sorted_ids);
+    // добавляет название и возвращает его id; для уже добавленного названия - прежний id.
+    // В замороженный пул добавить новое название нельзя
+    uint32_t Add(std::string_view name);
+
+    // строит совершенную хеш-функцию и порядок названий и замораживает пул; замороженный
+    // пул не меняется, поэтому его могут разделять несколько справочников
+    void Freeze();
+    // замораживает пул с хеш-функцией, построенной ранее для тех же названий; порядок
+    // названий sorted_ids проверяется, пустой - строится заново
+    void Freeze(PerfectHash::Data index, std::vector<uint32_t> sorted_ids);
+    bool IsFrozen() const;
+    // хеш-функция замороженного пула
+    const PerfectHash& GetIndex() const;
+    // id всех названий замороженного пула по возрастанию названий
+    const ranges::FrozenArray<uint32_t>& GetSortedIds() const;
+    // id названия по позиции в хеш-функции замороженного пула
+    const ranges::FrozenArray<uint32_t>& GetNameIdsByPosition() const;
+    // id названий, начинающихся с prefix, по возрастанию названий (в замороженном пуле)
+    IdsRange FindByPrefix(std::string_view prefix) const;
+
+    // id названия или NO_NAME
+    uint32_t Find(std::string_view name) const;
+    std::string_view Get(uint32_t id) const;
+    size_t Size() const;
+
+private:
+    // размер блока по умолчанию; более длинное название получает свой блок
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    // владелец чужой памяти пула после Attach
+    std::shared_ptr<const void> owner_;
+    char* block_next_ = nullptr; // начало свободного места в текущем блоке
+    size_t block_free_ = 0;      // свободно символов в текущем блоке
+    std::vector<std::string_view> names_;
+    // хеш-таблица с линейным пробированием: id названий, NO_NAME - пустая ячейка;
+    // размер - степень двойки, заполнена не больше чем наполовину
+    std::vector<uint32_t> slots_;
+    // замороженный пул: id названия по его позиции в совершенной хеш-функции
+    bool frozen_ = false;
+    PerfectHash index_;
+    ranges::FrozenArray<uint32_t> name_ids_by_position_;
+    // id названий по возрастанию названий
+    ranges::FrozenArray<uint32_t> sorted_ids_;
+
+    char* Allocate(size_t size);
+    // задаёт порядок названий: проверяет sorted_ids или, если он пуст, сортирует id
+    void SortNames(std::vector<uint32_t> sorted_ids);
+    // заполняет name_ids_by_position_; false, если index_ не различает названия
+    bool PlaceNames();
+    size_t FindSlot(std::string_view name) const;
+    void Rehash(size_t slot_count);
+};
+
+}  // namespace transport_catalogue
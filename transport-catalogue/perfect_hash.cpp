@@ -0,0 +1,141 @@
+#include "perfect_hash.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+namespace transport_catalogue {
+
+namespace {
+
+// финальное перемешивание splitmix64
+uint64_t Mix(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+
+}  // namespace
+
+PerfectHash::PerfectHash(const std::vector<std::string_view>& keys)
+    : key_count_(keys.size()) {
+    std::vector<uint64_t> hashes(keys.size());
+    for (uint64_t seed = 0; seed < MAX_SEEDS; ++seed) {
+        for (size_t n = 0; n < keys.size(); ++n) {
+            hashes[n] = Hash(keys[n], seed);
+        }
+        data_.seed = seed;
+        if (Build(hashes)) {
+            return;
+        }
+    }
+    // при различных ключах сюда можно попасть только при совпадении 64-битных хешей для всех seed
+    throw std::invalid_argument("Cannot build perfect hash: duplicate keys");
+}
+
+PerfectHash::PerfectHash(Data data, size_t key_count)
+    : data_(std::move(data))
+    , key_count_(key_count) {
+    if (data_.pilots.size() != GetBucketCount(key_count)) {
+        throw std::invalid_argument("Perfect hash does not match key count");
+    }
+}
+
+size_t PerfectHash::operator()(std::string_view key) const {
+    const uint64_t hash = Hash(key, data_.seed);
+    return GetPosition(hash, data_.pilots[hash % data_.pilots.size()]);
+}
+
+size_t PerfectHash::GetKeyCount() const {
+    return key_count_;
+}
+
+const PerfectHash::Data& PerfectHash::GetData() const {
+    return data_;
+}
+
+uint64_t PerfectHash::Hash(std::string_view key, uint64_t seed) {
+    // FNV-1a с перемешиванием результата
+    uint64_t hash = 0xcbf29ce484222325ULL ^ Mix(seed + 1);
+    for (const char c : key) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return Mix(hash);
+}
+
+size_t PerfectHash::GetBucketCount(size_t key_count) {
+    return key_count == 0 ? 0 : (key_count + BUCKET_SIZE - 1) / BUCKET_SIZE;
+}
+
+size_t PerfectHash::GetPosition(uint64_t hash, uint32_t pilot) const {
+    // корзина определяется младшими битами через остаток, позиция - перемешиванием со старшими
+    return Mix((hash >> 32) ^ Mix(pilot)) % key_count_;
+}
+
+bool PerfectHash::Build(const std::vector<uint64_t>& hashes) {
+    const size_t bucket_count = GetBucketCount(hashes.size());
+    std::vector<uint32_t> pilots(bucket_count, 0);
+
+    // ключи по корзинам подсчётом
+    std::vector<size_t> offsets(bucket_count + 1, 0);
+    for (const uint64_t hash : hashes) {
+        ++offsets[hash % bucket_count + 1];
+    }
+    for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+        offsets[bucket + 1] += offsets[bucket];
+    }
+    std::vector<uint64_t> bucket_hashes(hashes.size());
+    {
+        std::vector<size_t> positions(offsets.begin(), offsets.end() - 1);
+        for (const uint64_t hash : hashes) {
+            bucket_hashes[positions[hash % bucket_count]++] = hash;
+        }
+    }
+    std::vector<size_t> order(bucket_count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&offsets](size_t lhs, size_t rhs) {
+        return offsets[lhs + 1] - offsets[lhs] > offsets[rhs + 1] - offsets[rhs];
+    });
+
+    std::vector<bool> taken(hashes.size(), false);
+    std::vector<size_t> bucket_positions;
+    for (const size_t bucket : order) {
+        const size_t begin = offsets[bucket];
+        const size_t end = offsets[bucket + 1];
+        if (begin == end) {
+            break;
+        }
+        bool placed = false;
+        for (uint32_t pilot = 0; pilot < MAX_PILOT && !placed; ++pilot) {
+            bucket_positions.clear();
+            placed = true;
+            for (size_t n = begin; n < end; ++n) {
+                const size_t position = GetPosition(bucket_hashes[n], pilot);
+                if (taken[position] || std::find(bucket_positions.begin(), bucket_positions.end(), position)
+                        != bucket_positions.end()) {
+                    placed = false;
+                    break;
+                }
+                bucket_positions.push_back(position);
+            }
+            if (placed) {
+                pilots[bucket] = pilot;
+                for (const size_t position : bucket_positions) {
+                    taken[position] = true;
+                }
+            }
+        }
+        if (!placed) {
+            return false;
+        }
+    }
+    data_.pilots = std::move(pilots);
+    return true;
+}
+
+}  // namespace transport_catalogue
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "frozen_array.h"
+
+namespace transport_catalogue {
+
+// PerfectHash - минимальная совершенная хеш-функция над фиксированным набором строк (схема CHD):
+// ключи раскладываются по корзинам примерно по четыре, и для каждой корзины подбирается число
+// pilot, при котором позиции всех её ключей попадают в ещё свободные ячейки [0, key_count).
+// Корзины обрабатываются от больших к малым. Вычисление - один хеш строки и одно обращение
+// к массиву pilots. Для строки не из набора возвращается произвольная позиция, поэтому
+// найденный ключ нужно сверить. Хеш не зависит от платформы, функцию можно сохранять в базе.
+class PerfectHash {
+public:
+    struct Data {
+        uint64_t seed = 0;
+        ranges::FrozenArray<uint32_t> pilots; // по корзинам; может лежать в чужой памяти
+    };
+
+    PerfectHash() = default;
+    // строит функцию над различными ключами
+    explicit PerfectHash(const std::vector<std::string_view>& keys);
+    // восстанавливает функцию, построенную для key_count ключей
+    PerfectHash(Data data, size_t key_count);
+
+    // позиция ключа из [0, GetKeyCount()); GetKeyCount() должно быть больше нуля
+    size_t operator()(std::string_view key) const;
+
+    size_t GetKeyCount() const;
+    const Data& GetData() const;
+
+private:
+    // средний размер корзины
+    static constexpr size_t BUCKET_SIZE = 4;
+    // сколько значений pilot перебирать для корзины, прежде чем сменить seed
+    static constexpr uint32_t MAX_PILOT = 1u << 24;
+    static constexpr uint64_t MAX_SEEDS = 16;
+
+    Data data_;
+    size_t key_count_ = 0;
+
+    static uint64_t Hash(std::string_view key, uint64_t seed);
+    static size_t GetBucketCount(size_t key_count);
+    size_t GetPosition(uint64_t hash, uint32_t pilot) const;
+    // подбирает pilots для хешей ключей; false, если для какой-то корзины pilot не нашёлся
+    bool Build(const std::vector<uint64_t>& hashes);
+};
+
+}  // namespace transport_catalogue
@@ -0,0 +1,81 @@
+#include "proto_stream.h"
+
+namespace serialization {
+
+namespace {
+
+// varint прямо из потока; false в конце файла или для неверного varint
+bool ReadStreamVarint(std::istream& input, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        const int byte = input.get();
+        if (byte == std::istream::traits_type::eof()) {
+            return false;
+        }
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+void WriteMessageBody(SizeCounter& counter, const google::protobuf::MessageLite& message) {
+    counter.AddBytes(static_cast<size_t>(message.GetCachedSize()));
+}
+
+void WriteMessageBody(CodedOutputStream& output, const google::protobuf::MessageLite& message) {
+    message.SerializeWithCachedSizes(&output);
+}
+
+bool ReadBytes(CodedInputStream& input, uint32_t tag, std::string& value) {
+    uint32_t length = 0;
+    return WireFormat::GetTagWireType(tag) == WireFormat::WIRETYPE_LENGTH_DELIMITED && input.ReadVarint32(&length)
+        && input.ReadString(&value, static_cast<int>(length));
+}
+
+bool ReadMessage(CodedInputStream& input, uint32_t tag, google::protobuf::MessageLite& message) {
+    uint32_t length = 0;
+    if (WireFormat::GetTagWireType(tag) != WireFormat::WIRETYPE_LENGTH_DELIMITED || !input.ReadVarint32(&length)) {
+        return false;
+    }
+    const CodedInputStream::Limit limit = input.PushLimit(static_cast<int>(length));
+    const bool parsed = message.ParseFromCodedStream(&input) && input.BytesUntilLimit() == 0;
+    input.PopLimit(limit);
+    return parsed;
+}
+
+bool ReadContents(std::istream& input, std::unordered_map<uint32_t, FieldSpan>& contents) {
+    input.clear();
+    input.seekg(0, std::ios::end);
+    const std::streamoff file_size = input.tellg();
+    input.seekg(0);
+    std::streamoff offset = 0;
+    while (input && offset < file_size) {
+        uint64_t tag = 0;
+        uint64_t size = 0;
+        if (!ReadStreamVarint(input, tag)
+                || WireFormat::GetTagWireType(static_cast<uint32_t>(tag)) != WireFormat::WIRETYPE_LENGTH_DELIMITED
+                || !ReadStreamVarint(input, size)) {
+            return false;
+        }
+        const FieldSpan span{input.tellg(), size};
+        if (size > static_cast<uint64_t>(file_size - span.offset)
+                || !contents.emplace(WireFormat::GetTagFieldNumber(static_cast<uint32_t>(tag)), span).second) {
+            return false;
+        }
+        offset = span.offset + static_cast<std::streamoff>(size);
+        input.seekg(offset);
+    }
+    return static_cast<bool>(input);
+}
+
+bool ParseSpan(std::istream& input, const FieldSpan& span, google::protobuf::MessageLite& message) {
+    return ReadSpan(input, span, [&message](CodedInputStream& coded) {
+        return message.ParseFromCodedStream(&coded);
+    });
+}
+
+}  // namespace serialization
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <unordered_map>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/message_lite.h>
+#include <google/protobuf/wire_format_lite.h>
+
+namespace serialization {
+
+// Потоковая запись и чтение сообщений protobuf без построения сообщения в памяти целиком.
+// Запись идёт в приёмник Sink - CodedOutputStream или SizeCounter с теми же методами:
+// длина вложенного сообщения считается проходом с SizeCounter, затем сообщение пишется
+// вторым проходом. Результат - обычное сообщение, которое разбирает и сгенерированный код.
+
+using WireFormat = google::protobuf::internal::WireFormatLite;
+using CodedInputStream = google::protobuf::io::CodedInputStream;
+using CodedOutputStream = google::protobuf::io::CodedOutputStream;
+
+// примерное число значений в одной части упакованного повторяемого поля
+constexpr size_t PACKED_CHUNK_SIZE = 8192;
+
+// SizeCounter - приёмник, который только считает байты
+class SizeCounter {
+public:
+    void WriteTag(uint32_t tag) {
+        size_ += CodedOutputStream::VarintSize32(tag);
+    }
+    void WriteVarint32(uint32_t value) {
+        size_ += CodedOutputStream::VarintSize32(value);
+    }
+    void WriteVarint64(uint64_t value) {
+        size_ += CodedOutputStream::VarintSize64(value);
+    }
+    void WriteLittleEndian64(uint64_t) {
+        size_ += sizeof(uint64_t);
+    }
+    void WriteRaw(const void*, int size) {
+        size_ += static_cast<size_t>(size);
+    }
+    void AddBytes(size_t size) {
+        size_ += size;
+    }
+
+    size_t GetSize() const {
+        return size_;
+    }
+
+private:
+    size_t size_ = 0;
+};
+
+// тело сообщения; ByteSizeLong() сообщения должен быть вызван заранее
+void WriteMessageBody(SizeCounter& counter, const google::protobuf::MessageLite& message);
+void WriteMessageBody(CodedOutputStream& output, const google::protobuf::MessageLite& message);
+
+template <typename Sink>
+void WriteVarintField(Sink& sink, int field, uint64_t value) {
+    sink.WriteTag(WireFormat::MakeTag(field, WireFormat::WIRETYPE_VARINT));
+    sink.WriteVarint64(value);
+}
+
+template <typename Sink>
+void WriteDoubleField(Sink& sink, int field, double value) {
+    sink.WriteTag(WireFormat::MakeTag(field, WireFormat::WIRETYPE_FIXED64));
+    sink.WriteLittleEndian64(WireFormat::EncodeDouble(value));
+}
+
+// вложенное сообщение, тело которого пишет write_body(auto& sink)
+template <typename Sink, typename WriteBody>
+void WriteNestedField(Sink& sink, int field, WriteBody write_body) {
+    SizeCounter counter;
+    write_body(counter);
+    sink.WriteTag(WireFormat::MakeTag(field, WireFormat::WIRETYPE_LENGTH_DELIMITED));
+    sink.WriteVarint64(counter.GetSize());
+    write_body(sink);
+}
+
+// готовое сообщение; ByteSizeLong() сообщения должен быть вызван заранее
+template <typename Sink>
+void WriteMessageField(Sink& sink, int field, const google::protobuf::MessageLite& message) {
+    sink.WriteTag(WireFormat::MakeTag(field, WireFormat::WIRETYPE_LENGTH_DELIMITED));
+    sink.WriteVarint64(static_cast<uint64_t>(message.GetCachedSize()));
+    WriteMessageBody(sink, message);
+}
+
+struct VarintEncoding {
+    template <typename Sink>
+    static void Write(Sink& sink, uint64_t value) {
+        sink.WriteVarint64(value);
+    }
+};
+
+// знаковое число в кодировке sint64 (ZigZag): малые по модулю значения занимают мало байт
+struct SintEncoding {
+    template <typename Sink>
+    static void Write(Sink& sink, int64_t value) {
+        sink.WriteVarint64(WireFormat::ZigZagEncode64(value));
+    }
+};
+
+struct DoubleEncoding {
+    template <typename Sink>
+    static void Write(Sink& sink, double value) {
+        sink.WriteLittleEndian64(WireFormat::EncodeDouble(value));
+    }
+};
+
+// упакованное повторяемое поле из значений value(row, column) таблицы rows x columns по строкам.
+// Поле пишется несколькими частями из целого числа строк, около PACKED_CHUNK_SIZE значений
+// в части: при разборе части склеиваются в одно поле
+template <typename Encoding, typename Sink, typename Value>
+void WritePackedField(Sink& sink, int field, size_t rows, size_t columns, Value value) {
+    const size_t chunk_rows = std::max<size_t>(1, PACKED_CHUNK_SIZE / std::max<size_t>(1, columns));
+    for (size_t begin = 0; begin < rows; begin += chunk_rows) {
+        const size_t end = std::min(rows, begin + chunk_rows);
+        WriteNestedField(sink, field, [begin, end, columns, &value](auto& chunk) {
+            for (size_t row = begin; row < end; ++row) {
+                for (size_t column = 0; column < columns; ++column) {
+                    Encoding::Write(chunk, value(row, column));
+                }
+            }
+        });
+    }
+}
+
+// упакованное повторяемое поле из значений массива
+template <typename Sink, typename Container>
+void WritePackedVarints(Sink& sink, int field, const Container& values) {
+    WritePackedField<VarintEncoding>(sink, field, values.size(), 1, [&values](size_t n, size_t) {
+        return static_cast<uint64_t>(values[n]);
+    });
+}
+
+// Чтение. Функции возвращают false при ошибке формата.
+
+// значения повторяемого поля varint с тегом tag, упакованного или нет
+template <typename OnValue>
+bool ReadVarints(CodedInputStream& input, uint32_t tag, OnValue on_value) {
+    uint64_t value = 0;
+    if (WireFormat::GetTagWireType(tag) == WireFormat::WIRETYPE_VARINT) {
+        if (!input.ReadVarint64(&value)) {
+            return false;
+        }
+        on_value(value);
+        return true;
+    }
+    uint32_t length = 0;
+    if (WireFormat::GetTagWireType(tag) != WireFormat::WIRETYPE_LENGTH_DELIMITED || !input.ReadVarint32(&length)) {
+        return false;
+    }
+    const CodedInputStream::Limit limit = input.PushLimit(static_cast<int>(length));
+    while (input.BytesUntilLimit() > 0) {
+        if (!input.ReadVarint64(&value)) {
+            return false;
+        }
+        on_value(value);
+    }
+    input.PopLimit(limit);
+    return true;
+}
+
+// значения повторяемого поля sint64 с тегом tag, упакованного или нет
+template <typename OnValue>
+bool ReadSints(CodedInputStream& input, uint32_t tag, OnValue on_value) {
+    return ReadVarints(input, tag, [&on_value](uint64_t value) {
+        on_value(WireFormat::ZigZagDecode64(value));
+    });
+}
+
+// значения повторяемого поля double с тегом tag, упакованного или нет
+template <typename OnValue>
+bool ReadDoubles(CodedInputStream& input, uint32_t tag, OnValue on_value) {
+    uint64_t value = 0;
+    if (WireFormat::GetTagWireType(tag) == WireFormat::WIRETYPE_FIXED64) {
+        if (!input.ReadLittleEndian64(&value)) {
+            return false;
+        }
+        on_value(WireFormat::DecodeDouble(value));
+        return true;
+    }
+    uint32_t length = 0;
+    if (WireFormat::GetTagWireType(tag) != WireFormat::WIRETYPE_LENGTH_DELIMITED || !input.ReadVarint32(&length)
+            || length % sizeof(uint64_t) != 0) {
+        return false;
+    }
+    for (uint32_t n = 0; n < length / sizeof(uint64_t); ++n) {
+        if (!input.ReadLittleEndian64(&value)) {
+            return false;
+        }
+        on_value(WireFormat::DecodeDouble(value));
+    }
+    return true;
+}
+
+// поле bytes с тегом tag
+bool ReadBytes(CodedInputStream& input, uint32_t tag, std::string& value);
+
+// вложенное сообщение с тегом tag
+bool ReadMessage(CodedInputStream& input, uint32_t tag, google::protobuf::MessageLite& message);
+
+// положение поля-сообщения верхнего уровня в файле
+struct FieldSpan {
+    std::streamoff offset = 0;
+    uint64_t size = 0;
+};
+
+// оглавление сообщения, все поля которого - сообщения: положение полей по номерам.
+// Поля пропускаются переходом по файлу, их тела не читаются. Повтор поля считается ошибкой
+bool ReadContents(std::istream& input, std::unordered_map<uint32_t, FieldSpan>& contents);
+
+// разбирает тело поля span потоком: read(CodedInputStream&) читает поля до конца ограничения
+template <typename Read>
+bool ReadSpan(std::istream& input, const FieldSpan& span, Read read) {
+    if (span.size > static_cast<uint64_t>(INT32_MAX)) {
+        return false;
+    }
+    input.clear();
+    input.seekg(span.offset);
+    google::protobuf::io::IstreamInputStream stream(&input);
+    CodedInputStream coded(&stream);
+    coded.PushLimit(static_cast<int>(span.size));
+    return read(coded) && coded.BytesUntilLimit() == 0;
+}
+
+// разбирает поле span в сообщение
+bool ParseSpan(std::istream& input, const FieldSpan& span, google::protobuf::MessageLite& message);
+
+}  // namespace serialization
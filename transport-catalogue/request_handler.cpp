@@ -24,17 +24,55 @@ namespace request_handler {
 
 	// Возвращает информацию о маршруте (запрос Bus)
 	std::optional<const RouteInfo*> RequestHandler::GetRouteInfo(const std::string_view& bus_name) const {
-		return db_.GetRouteInfo(bus_name);
+		return Catalogue().GetRouteInfo(bus_name);
+	}
+
+	// Возвращает расстояние и время проезда между остановками на автобусе (запрос Segment)
+	std::optional<SegmentInfo> RequestHandler::GetSegmentInfo(std::string_view bus_name, std::string_view from,
+		std::string_view to) const {
+		const transport_catalogue::TransportCatalogue& db = Catalogue();
+		const Route* route = db.GetRouteByName(bus_name);
+		const Stop* stop_from = db.GetStopByName(from);
+		const Stop* stop_to = db.GetStopByName(to);
+		if (route == nullptr || stop_from == nullptr || stop_to == nullptr) {
+			return std::nullopt;
+		}
+		const std::optional<uint64_t> distance = db.GetSegmentDistance(route, stop_from, stop_to);
+		if (!distance) {
+			return std::nullopt;
+		}
+		SegmentInfo result;
+		result.distance = *distance;
+		// скорость в км/ч переводим в метры в минуту
+		result.time = static_cast<double>(*distance) / (Router().GetRoutingSettings().bus_velocity * 1000.0 / 60.0);
+		return result;
+	}
+
+	// Возвращает остановки рядом с точкой (запрос NearbyStops)
+	std::vector<NearbyStop> RequestHandler::GetNearbyStops(geo::Coordinates point, std::optional<double> radius,
+		std::optional<size_t> count) const {
+		return Catalogue().FindNearbyStops(point, radius, count);
+	}
+
+	// Возвращает остановки по началу названия (запрос SuggestStops)
+	std::vector<const Stop*> RequestHandler::SuggestStops(std::string_view prefix, size_t count) const {
+		return Catalogue().SuggestStops(prefix, count);
 	}
 
 	// Возвращает маршруты, проходящие через
-	const std::set<std::string_view>* RequestHandler::GetRoutesOnStop(const std::string_view stop_name) const {
-		return db_.GetRoutesOnStop(db_.GetStopByName(stop_name));
+	transport_catalogue::TransportCatalogue::RouteIdsRange RequestHandler::GetRoutesOnStop(
+		const std::string_view stop_name) const {
+		return Catalogue().GetRoutesOnStop(Catalogue().GetStopByName(stop_name));
+	}
+
+	// поиск имени маршрута по ID
+	std::string_view RequestHandler::GetRouteNameById(uint32_t id) const {
+		return Catalogue().GetRouteNameById(id);
 	}
 
     //
 	bool RequestHandler::StopIs(const std::string_view stop_name) const {
-	    return (db_.GetStopByName(stop_name) != nullptr);
+	    return (Catalogue().GetStopByName(stop_name) != nullptr);
 	}
 
     void RequestHandler::AddStop(const std::string& stop_name, const geo::Coordinates coordinate) {
@@ -51,24 +89,72 @@ namespace request_handler {
         db_.AddRoute(name, type, stops, db_.GetNumberRoutes());
     }
 
-    // поиск остановки по имени
-    const std::unordered_map<std::string_view, const Stop*>& RequestHandler::GetAllStops() const {
-        return db_.GetAllStops();
+    // получение всех расстояний между парами остановок
+    std::vector<DistanceBeetweenPairStops> RequestHandler::GetAllDistanceBeetweenPairStops() const {
+        const auto& distances = db_.GetAllDistanceBeetweenPairStops();
+        return {distances.begin(), distances.end()};
     }
 
-    // поиск маршрута по имени
-    const std::unordered_map<std::string_view, const Route*>& RequestHandler::GetAllRoutes() const {
-        return db_.GetAllRoutes();
+    // поиск имени остановки по ID
+    std::string_view RequestHandler::GetStopNameById(uint32_t id) const {
+        return Catalogue().GetStopNameById(id);
     }
 
-    // получение всех расстояний между парами остановок
-    std::vector<DistanceBeetweenPairStops> RequestHandler::GetAllDistanceBeetweenPairStops() {
-        return db_.GetAllDistanceBeetweenPairStops();
+    // фиксирует заданные расстояния между остановками
+    void RequestHandler::FreezeDistances() {
+        db_.FreezeDistances();
     }
 
-    // поиск имени остановки по ID
-    std::string_view RequestHandler::GetStopNameById(uint32_t id) const {
-        return db_.GetStopNameById(id);
+    // фиксирует названия остановок и маршрутов и строит по ним совершенную хеш-функцию
+    void RequestHandler::FreezeNames() {
+        db_.FreezeNames();
+    }
+
+    // расчёт таблицы информации о маршрутах для запросов Bus
+    void RequestHandler::BuildRouteInfos() {
+        db_.BuildRouteInfos();
+    }
+
+    // построение списков маршрутов через остановки для запросов Stop
+    void RequestHandler::BuildStopRoutes() {
+        db_.BuildStopRoutes();
+    }
+
+    // построение сетки по координатам остановок для запросов NearbyStops
+    void RequestHandler::BuildStopIndex() {
+        db_.BuildStopIndex();
+    }
+
+
+    // VersionedCatalogue ----------------------------------------------------------------------------------
+
+    // применение изменений справочника; первая правка создаёт версии поверх базы
+    uint64_t RequestHandler::ApplyUpdate(const versioned_catalogue::CatalogueUpdate& update) {
+        if (!versions_) {
+            versions_ = std::make_shared<versioned_catalogue::VersionedCatalogue>(db_, router_);
+        }
+        const uint64_t number = versions_->Apply(update);
+        RefreshVersion();
+        return number;
+    }
+
+    // переход на последнюю опубликованную версию
+    void RequestHandler::RefreshVersion() {
+        if (versions_) {
+            version_ = versions_->Acquire();
+        }
+    }
+
+    uint64_t RequestHandler::GetVersionNumber() const {
+        return version_ ? version_->number : 0;
+    }
+
+    const transport_catalogue::TransportCatalogue& RequestHandler::Catalogue() const {
+        return version_ ? *version_->catalogue : db_;
+    }
+
+    const transport_router::TransportRouter& RequestHandler::Router() const {
+        return version_ ? *version_->router : router_;
     }
 
 
@@ -81,7 +167,8 @@ namespace request_handler {
 
     // рисуем карту
 	svg::Document RequestHandler::RenderMap() const	{
-		return renderer_.CreateMap(db_);
+		serialization_.LoadRenderSettings();
+		return renderer_.CreateMap(Catalogue());
 	}
 
 
@@ -89,20 +176,36 @@ namespace request_handler {
 
     // задание установок построения маршрута
     void RequestHandler::SetRoutingSettings(const RoutingSettings settings) {
-        router_.SetRoutingSettings(settings.bus_wait_time, settings.bus_velocity);
+        router_.SetRoutingSettings(settings);
         //router_.InitializeGraph();
     }
 
     // построение маршрута между двумя остановками
     std::optional<std::vector<RouteData>> RequestHandler::CreateRoute(const std::string_view& from,
             const std::string_view& to) const {
-        return router_.CreatRoute(from, to);
+        if (!version_) {
+            // маршрутизатор базы загружается при первом запросе маршрута
+            serialization_.LoadRouter();
+        }
+        return Router().CreatRoute(from, to);
     }
 
     void RequestHandler::RouterInitializeGraph() {
         router_.InitializeGraph();
     }
 
+    const graph::Router<double>::BuildStatistics* RequestHandler::GetRouterBuildStatistics() const {
+        return router_.GetBuildStatistics();
+    }
+
+    const graph::ContractionHierarchyRouter<double>::BuildStatistics* RequestHandler::GetHierarchyBuildStatistics() const {
+        return router_.GetHierarchyBuildStatistics();
+    }
+
+    std::optional<graph::SearchStatistics> RequestHandler::GetRouteSearchStatistics() const {
+        return Router().GetSearchStatistics();
+    }
+
     // Serialization -----------------------------------------------------------------------------------------
 
     // установка настроек сериализации
@@ -5,6 +5,7 @@
 #include "transport_router.h"
 #include "map_renderer.h"
 #include "serialization.h"
+#include "versioned_catalogue.h"
 
 /*
  * Здесь можно было бы разместить код обработчика запросов к базе, содержащего логику, которую не
@@ -38,8 +39,25 @@ namespace request_handler {
         // Возвращает информацию о маршруте (запрос Bus)
         std::optional<const RouteInfo*> GetRouteInfo(const std::string_view& bus_name) const;
 
-        // Возвращает маршруты, проходящие через остановку
-        const std::set<std::string_view>* GetRoutesOnStop(const std::string_view stop_name) const;
+        // Возвращает расстояние и время проезда между остановками на автобусе (запрос Segment);
+        // nullopt, если автобуса или остановок нет или автобус не идёт от from до to
+        std::optional<SegmentInfo> GetSegmentInfo(std::string_view bus_name, std::string_view from,
+            std::string_view to) const;
+
+        // Возвращает остановки не дальше radius метров от точки, не больше count ближайших,
+        // по возрастанию расстояния (запрос NearbyStops)
+        std::vector<NearbyStop> GetNearbyStops(geo::Coordinates point, std::optional<double> radius,
+            std::optional<size_t> count) const;
+
+        // Возвращает не больше count остановок, названия которых начинаются с prefix,
+        // по возрастанию названий (запрос SuggestStops)
+        std::vector<const Stop*> SuggestStops(std::string_view prefix, size_t count) const;
+
+        // Возвращает id маршрутов, проходящих через остановку, по возрастанию названий
+        transport_catalogue::TransportCatalogue::RouteIdsRange GetRoutesOnStop(const std::string_view stop_name) const;
+
+        // поиск имени маршрута по ID
+        std::string_view GetRouteNameById(uint32_t id) const;
 
         bool StopIs(const std::string_view stop_name) const;
 
@@ -52,18 +70,43 @@ namespace request_handler {
         // добавление маршрута в базу
         void AddRoute(std::string_view name, RouteType type, std::vector<std::string_view> stops);
 
-        // поиск остановки по имени
-        const std::unordered_map<std::string_view, const Stop*>& GetAllStops() const;
-
-        // поиск маршрута по имени
-        const std::unordered_map<std::string_view, const Route*>& GetAllRoutes() const;
-
         // получение всех расстояний между парами остановок
-        std::vector<DistanceBeetweenPairStops> GetAllDistanceBeetweenPairStops();
+        std::vector<DistanceBeetweenPairStops> GetAllDistanceBeetweenPairStops() const;
 
         // поиск имени остановки по ID
         std::string_view GetStopNameById(uint32_t id) const;
 
+        // фиксирует заданные расстояния между остановками
+        void FreezeDistances();
+
+        // фиксирует названия остановок и маршрутов и строит по ним совершенную хеш-функцию
+        void FreezeNames();
+
+        // расчёт таблицы информации о маршрутах для запросов Bus
+        void BuildRouteInfos();
+
+        // построение списков маршрутов через остановки для запросов Stop
+        void BuildStopRoutes();
+
+        // построение сетки по координатам остановок для запросов NearbyStops
+        void BuildStopIndex();
+
+        // VersionedCatalogue ------------------------------------------------------------------------------
+
+        // Запросы справочника и маршрутизатора отвечают по закреплённой версии. Пока изменений
+        // не было, это сами справочник и маршрутизатор из базы
+
+        // строит и публикует версию с изменениями и закрепляет её; возвращает номер версии
+        // (запрос Update). При ошибке в изменениях бросает std::invalid_argument
+        uint64_t ApplyUpdate(const versioned_catalogue::CatalogueUpdate& update);
+
+        // закрепляет последнюю опубликованную версию; вызывается перед каждым запросом,
+        // чтобы весь запрос, включая разбор ответа, шёл по одной версии
+        void RefreshVersion();
+
+        // номер закреплённой версии; 0 - база
+        uint64_t GetVersionNumber() const;
+
         // MapRenderer -------------------------------------------------------------------------------------
 
         // установка параметров MapRenderer
@@ -84,6 +127,15 @@ namespace request_handler {
         // инициализация графа
         void RouterInitializeGraph();
 
+        // статистика построения таблицы маршрутов; nullptr, если таблица не строилась
+        const graph::Router<double>::BuildStatistics* GetRouterBuildStatistics() const;
+
+        // статистика построения иерархии сжатия; nullptr, если иерархия не строилась
+        const graph::ContractionHierarchyRouter<double>::BuildStatistics* GetHierarchyBuildStatistics() const;
+
+        // статистика поиска маршрутов по запросу; nullopt для таблицы всех пар
+        std::optional<graph::SearchStatistics> GetRouteSearchStatistics() const;
+
         // Serialization -----------------------------------------------------------------------------------
 
         // установка настроек сериализации
@@ -96,6 +148,14 @@ namespace request_handler {
         transport_router::TransportRouter& router_;
         serialization::Serialization& serialization_;
 
+        // версии справочника; создаются при первом изменении
+        std::shared_ptr<versioned_catalogue::VersionedCatalogue> versions_;
+        std::shared_ptr<const versioned_catalogue::Version> version_;
+
+        // справочник и маршрутизатор закреплённой версии
+        const transport_catalogue::TransportCatalogue& Catalogue() const;
+        const transport_router::TransportRouter& Router() const;
+
     }; // class RequestHandler
 
 } // namespace request_handler
\ No newline at end of file
@@ -1,26 +1,78 @@
 #pragma once
 
+#include "floyd_warshall.h"
 #include "graph.h"
+#include "routes_table.h"
+#include "thread_pool.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
+#include <functional>
 #include <iterator>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <queue>
 #include <stdexcept>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
+#include <variant>
 #include <vector>
 
 namespace graph {
 
+// способ расчёта таблицы маршрутов между всеми парами вершин
+enum class AllPairsAlgorithm {
+    FLOYD_WARSHALL, // блочный Флойд-Уоршелл, O(V^3)
+    DIJKSTRA,       // поиск Дейкстры из каждой вершины, O(V * E log V) - быстрее на разреженных графах
+};
+
+// формат хранения таблицы маршрутов
+enum class RoutesTableLayout {
+    WIDE,    // веса Weight и рёбра EdgeId
+    COMPACT, // веса - 32-битная фиксированная точка, рёбра - 32-битные id (вдвое меньше памяти)
+};
+
+// параметры построения таблицы маршрутов
+struct AllPairsSettings {
+    AllPairsAlgorithm algorithm = AllPairsAlgorithm::FLOYD_WARSHALL;
+    RoutesTableLayout layout = RoutesTableLayout::WIDE;
+    size_t thread_count = thread_pool::ThreadPool::DefaultThreadCount();
+    // для COMPACT: сколько единиц фиксированной точки в единице веса
+    double ticks_per_weight_unit = 1000.0;
+    // флаг отмены построения; при его установке конструктор Router бросает BuildCancelled
+    const std::atomic<bool>* cancel = nullptr;
+};
+
 template <typename Weight>
 class Router {
 private:
     using Graph = DirectedWeightedGraph<Weight>;
 
 public:
-    explicit Router(const Graph& graph);
+    struct RouteInternalData {
+        Weight weight;
+        std::optional<EdgeId> prev_edge;
+    };
+    using WideRoutesTable = RoutesTable<Weight, EdgeId>;
+    using RoutesInternalData = std::variant<WideRoutesTable, CompactRoutesTable>;
+
+    // статистика построения таблицы маршрутов
+    struct BuildStatistics {
+        AllPairsAlgorithm algorithm = AllPairsAlgorithm::FLOYD_WARSHALL;
+        std::chrono::nanoseconds duration{0};              // общее время построения
+        std::vector<thread_pool::ThreadStatistics> threads; // по потокам
+    };
+
+    explicit Router(const Graph& graph, const AllPairsSettings& settings = {});
+    // Восстанавливает маршрутизатор по ранее рассчитанным данным (без повторного расчёта)
+    Router(const Graph& graph, RoutesInternalData routes_internal_data);
 
     struct RouteInfo {
         Weight weight;
@@ -29,75 +81,262 @@ public:
 
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
 
+    const RoutesInternalData& GetRoutesInternalData() const {
+        return routes_internal_data_;
+    }
+
+    const BuildStatistics& GetBuildStatistics() const {
+        return build_statistics_;
+    }
+
 private:
-    struct RouteInternalData {
-        Weight weight;
-        std::optional<EdgeId> prev_edge;
-    };
-    using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+    // вес ребра в формате таблицы
+    template <typename Table>
+    typename Table::WeightValue ToStoredWeight(Weight weight) const {
+        if constexpr (std::is_same_v<Table, CompactRoutesTable>) {
+            return ToFixedPointWeight(weight, ticks_per_weight_unit_);
+        } else {
+            return weight;
+        }
+    }
 
-    void InitializeRoutesInternalData(const Graph& graph) {
-        const size_t vertex_count = graph.GetVertexCount();
+    template <typename Table>
+    void InitializeRoutesInternalData(Table& table) {
+        using StoredEdge = typename Table::EdgeValue;
+        const size_t vertex_count = graph_.GetVertexCount();
         for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-            routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
-            for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
-                const auto& edge = graph.GetEdge(edge_id);
-                if (edge.weight < ZERO_WEIGHT) {
-                    throw std::domain_error("Edges' weights should be non-negative");
-                }
-                auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                    route_internal_data = RouteInternalData{edge.weight, edge_id};
+            table.SetRoute(vertex, vertex, typename Table::WeightValue{}, Table::NO_EDGE);
+            for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+                const auto& edge = graph_.GetEdge(edge_id);
+                const auto weight = ToStoredWeight<Table>(edge.weight);
+                if (table.GetWeight(vertex, edge.to) > weight) {
+                    table.SetRoute(vertex, edge.to, weight, static_cast<StoredEdge>(edge_id));
                 }
             }
         }
     }
 
-    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-                    const RouteInternalData& route_to) {
-        auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-        const Weight candidate_weight = route_from.weight + route_to.weight;
-        if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-            route_relaxing = {candidate_weight,
-                              route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
+    // заполняет строку from таблицы маршрутов поиском Дейкстры из вершины from
+    template <typename Table>
+    void BuildRoutesFromVertex(Table& table, const std::vector<typename Table::WeightValue>& edge_weights,
+                               VertexId from,
+                               std::vector<std::pair<typename Table::WeightValue, VertexId>>& queue) const {
+        using StoredWeight = typename Table::WeightValue;
+        using StoredEdge = typename Table::EdgeValue;
+        using QueueItem = std::pair<StoredWeight, VertexId>;
+
+        // строка from таблицы служит массивом расстояний поиска
+        StoredWeight* weights = table.GetWeightsRow(from);
+        StoredEdge* prev_edges = table.GetPrevEdgesRow(from);
+
+        weights[from] = StoredWeight{};
+        queue.clear();
+        queue.push_back({StoredWeight{}, from});
+        while (!queue.empty()) {
+            std::pop_heap(queue.begin(), queue.end(), std::greater<QueueItem>());
+            const auto [weight, vertex] = queue.back();
+            queue.pop_back();
+            if (weights[vertex] < weight) {
+                continue;  // устаревшая запись очереди
+            }
+            for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+                const auto& edge = graph_.GetEdge(edge_id);
+                const StoredWeight candidate_weight = weight + edge_weights[edge_id];
+                if (candidate_weight < weights[edge.to]) {
+                    weights[edge.to] = candidate_weight;
+                    prev_edges[edge.to] = static_cast<StoredEdge>(edge_id);
+                    queue.push_back({candidate_weight, edge.to});
+                    std::push_heap(queue.begin(), queue.end(), std::greater<QueueItem>());
+                }
+            }
         }
     }
 
-    void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-        for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-            if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-                for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                    if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                        RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
-                    }
+    template <typename Table>
+    void BuildRoutesInternalData(Table& table, const AllPairsSettings& settings) {
+        using StoredWeight = typename Table::WeightValue;
+        const size_t vertex_count = graph_.GetVertexCount();
+
+        if (std::is_same_v<Table, CompactRoutesTable>
+            && graph_.GetEdgeCount() >= static_cast<size_t>(CompactRoutesTable::NO_EDGE)) {
+            throw std::out_of_range("Too many edges for the compact routes table");
+        }
+        for (const auto& edge : graph_.GetEdges()) {
+            if (edge.weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+        }
+
+        switch (settings.algorithm) {
+            case AllPairsAlgorithm::FLOYD_WARSHALL: {
+                // при одном блоке параллелить нечего
+                thread_pool::ThreadPool pool(vertex_count > FLOYD_WARSHALL_BLOCK_SIZE ? settings.thread_count : 1);
+                InitializeRoutesInternalData(table);
+                build_statistics_.threads = RunBlockedFloydWarshall(table, pool, settings.cancel);
+                break;
+            }
+            case AllPairsAlgorithm::DIJKSTRA: {
+                thread_pool::ThreadPool pool(std::max<size_t>(1, std::min(settings.thread_count, vertex_count)));
+                std::vector<StoredWeight> edge_weights;
+                edge_weights.reserve(graph_.GetEdgeCount());
+                for (const auto& edge : graph_.GetEdges()) {
+                    edge_weights.push_back(ToStoredWeight<Table>(edge.weight));
                 }
+                // у каждого потока своя очередь поиска, чтобы не выделять память на каждую вершину
+                std::vector<std::vector<std::pair<StoredWeight, VertexId>>> queues(pool.GetThreadCount());
+                // исключение задачи останавливает оставшиеся задачи пула
+                build_statistics_.threads = pool.ParallelFor(vertex_count, [&](size_t from, size_t thread_index) {
+                    CheckBuildCancelled(settings.cancel);
+                    BuildRoutesFromVertex(table, edge_weights, from, queues[thread_index]);
+                });
+                break;
             }
         }
     }
 
+    template <typename Table>
+    std::optional<RouteInfo> BuildRouteFromTable(const Table& table, VertexId from, VertexId to) const {
+        if (from >= table.GetVertexCount() || to >= table.GetVertexCount()) {
+            throw std::out_of_range("Vertex is out of graph");
+        }
+        if (!table.HasRoute(from, to)) {
+            return std::nullopt;
+        }
+        std::vector<EdgeId> edges;
+        for (auto edge_id = table.GetPrevEdge(from, to);
+             edge_id != Table::NO_EDGE;
+             edge_id = table.GetPrevEdge(from, graph_.GetEdge(edge_id).from))
+        {
+            edges.push_back(edge_id);
+        }
+        std::reverse(edges.begin(), edges.end());
+
+        Weight weight = ZERO_WEIGHT;
+        if constexpr (std::is_same_v<Table, WideRoutesTable>) {
+            weight = table.GetWeight(from, to);
+        } else {
+            // в компактной таблице вес округлён, поэтому считаем точный вес по рёбрам маршрута
+            for (const EdgeId edge_id : edges) {
+                weight += graph_.GetEdge(edge_id).weight;
+            }
+        }
+        return RouteInfo{weight, std::move(edges)};
+    }
+
     static constexpr Weight ZERO_WEIGHT{};
     const Graph& graph_;
+    double ticks_per_weight_unit_ = 0.0;
     RoutesInternalData routes_internal_data_;
+    BuildStatistics build_statistics_;
 };
 
 template <typename Weight>
-Router<Weight>::Router(const Graph& graph)
+Router<Weight>::Router(const Graph& graph, const AllPairsSettings& settings)
     : graph_(graph)
-    , routes_internal_data_(graph.GetVertexCount(),
-                            std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
+    , ticks_per_weight_unit_(settings.ticks_per_weight_unit)
 {
-    InitializeRoutesInternalData(graph);
+    const auto start = std::chrono::steady_clock::now();
+    build_statistics_.algorithm = settings.algorithm;
 
-    const size_t vertex_count = graph.GetVertexCount();
-    for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-        RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+    if (settings.layout == RoutesTableLayout::COMPACT) {
+        routes_internal_data_ = CompactRoutesTable(graph.GetVertexCount());
+    } else {
+        routes_internal_data_ = WideRoutesTable(graph.GetVertexCount());
+    }
+    std::visit([&](auto& table) { BuildRoutesInternalData(table, settings); }, routes_internal_data_);
+
+    build_statistics_.duration = std::chrono::steady_clock::now() - start;
+}
+
+template <typename Weight>
+Router<Weight>::Router(const Graph& graph, RoutesInternalData routes_internal_data)
+    : graph_(graph)
+    , routes_internal_data_(std::move(routes_internal_data))
+{
+    const size_t vertex_count = std::visit([](const auto& table) { return table.GetVertexCount(); },
+                                           routes_internal_data_);
+    if (vertex_count != graph.GetVertexCount()) {
+        throw std::invalid_argument("Routes internal data doesn't match the graph");
     }
 }
 
 template <typename Weight>
 std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
                                                                              VertexId to) const {
-    const auto& route_internal_data = routes_internal_data_.at(from).at(to);
+    return std::visit([&](const auto& table) { return BuildRouteFromTable(table, from, to); },
+                      routes_internal_data_);
+}
+
+// статистика поиска маршрутов по запросу
+struct SearchStatistics {
+    size_t queries = 0;          // число поисков
+    size_t settled_vertices = 0; // сколько вершин извлечено из очереди за все поиски
+};
+
+// DijkstraRouter ------------------------------------------------------------------------------
+// Строит маршруты по запросу алгоритмом Дейкстры, не рассчитывая заранее все пары вершин.
+// Память и время подготовки линейны относительно размера графа. Деревья кратчайших путей
+// от последних cache_size вершин-источников хранятся в LRU-кэше, поэтому повторные запросы
+// из той же вершины отвечаются без поиска.
+template <typename Weight>
+class DijkstraRouter {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+    using RouteInternalData = typename Router<Weight>::RouteInternalData;
+
+    DijkstraRouter(const Graph& graph, size_t cache_size);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+
+    // ответы из кэша не учитываются: считаются только построенные деревья
+    SearchStatistics GetSearchStatistics() const {
+        return {queries_.load(), settled_vertices_.load()};
+    }
+
+private:
+    // дерево кратчайших путей от одной вершины-источника
+    using ShortestPathTree = std::vector<std::optional<RouteInternalData>>;
+    using CacheList = std::list<std::pair<VertexId, std::shared_ptr<const ShortestPathTree>>>;
+
+    std::shared_ptr<const ShortestPathTree> GetShortestPathTree(VertexId from) const;
+    ShortestPathTree BuildShortestPathTree(VertexId from) const;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+    const size_t cache_size_;
+
+    // LRU-кэш: в начале списка - последние использованные деревья
+    mutable std::mutex cache_mutex_;
+    mutable CacheList cache_;
+    mutable std::unordered_map<VertexId, typename CacheList::iterator> cache_index_;
+
+    mutable std::atomic<size_t> queries_{0};
+    mutable std::atomic<size_t> settled_vertices_{0};
+};
+
+template <typename Weight>
+DijkstraRouter<Weight>::DijkstraRouter(const Graph& graph, size_t cache_size)
+    : graph_(graph)
+    , cache_size_(cache_size)
+{
+    for (const auto& edge : graph.GetEdges()) {
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::BuildRoute(VertexId from,
+                                                                                             VertexId to) const {
+    if (from >= graph_.GetVertexCount() || to >= graph_.GetVertexCount()) {
+        throw std::out_of_range("Vertex is out of graph");
+    }
+    const std::shared_ptr<const ShortestPathTree> tree = GetShortestPathTree(from);
+    const auto& route_internal_data = (*tree)[to];
     if (!route_internal_data) {
         return std::nullopt;
     }
@@ -105,7 +344,7 @@ std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(Ver
     std::vector<EdgeId> edges;
     for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
          edge_id;
-         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+         edge_id = (*tree)[graph_.GetEdge(*edge_id).from]->prev_edge)
     {
         edges.push_back(*edge_id);
     }
@@ -114,4 +353,296 @@ std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(Ver
     return RouteInfo{weight, std::move(edges)};
 }
 
+template <typename Weight>
+std::shared_ptr<const typename DijkstraRouter<Weight>::ShortestPathTree>
+DijkstraRouter<Weight>::GetShortestPathTree(VertexId from) const {
+    {
+        std::lock_guard guard(cache_mutex_);
+        if (const auto it = cache_index_.find(from); it != cache_index_.end()) {
+            cache_.splice(cache_.begin(), cache_, it->second);
+            return it->second->second;
+        }
+    }
+
+    // поиск выполняется без блокировки, чтобы не задерживать запросы из других вершин
+    auto tree = std::make_shared<const ShortestPathTree>(BuildShortestPathTree(from));
+    if (cache_size_ == 0) {
+        return tree;
+    }
+
+    std::lock_guard guard(cache_mutex_);
+    if (const auto it = cache_index_.find(from); it != cache_index_.end()) {
+        cache_.splice(cache_.begin(), cache_, it->second);
+        return it->second->second;
+    }
+    cache_.emplace_front(from, tree);
+    cache_index_[from] = cache_.begin();
+    if (cache_.size() > cache_size_) {
+        cache_index_.erase(cache_.back().first);
+        cache_.pop_back();
+    }
+    return tree;
+}
+
+template <typename Weight>
+typename DijkstraRouter<Weight>::ShortestPathTree DijkstraRouter<Weight>::BuildShortestPathTree(
+        VertexId from) const {
+    using QueueItem = std::pair<Weight, VertexId>;
+
+    ShortestPathTree tree(graph_.GetVertexCount());
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+
+    size_t settled_vertices = 0;
+    tree[from] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
+    queue.push({ZERO_WEIGHT, from});
+    while (!queue.empty()) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (tree[vertex]->weight < weight) {
+            continue;  // устаревшая запись очереди
+        }
+        ++settled_vertices;
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            const Weight candidate_weight = weight + edge.weight;
+            auto& route_to = tree[edge.to];
+            if (!route_to || candidate_weight < route_to->weight) {
+                route_to = RouteInternalData{candidate_weight, edge_id};
+                queue.push({candidate_weight, edge.to});
+            }
+        }
+    }
+    ++queries_;
+    settled_vertices_ += settled_vertices;
+    return tree;
+}
+
+// AStarRouter ---------------------------------------------------------------------------------
+// Поиск маршрута между парой вершин алгоритмом A* или двунаправленным A*. Эвристика - нижняя
+// оценка веса пути heuristic(v, to); она должна быть согласованной:
+// heuristic(u, to) <= вес(u -> v) + heuristic(v, to) для любого ребра u -> v и любой вершины to.
+// Без эвристики поиск сводится к алгоритму Дейкстры с остановкой в конечной вершине.
+template <typename Weight>
+class AStarRouter {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+    using Heuristic = std::function<Weight(VertexId from, VertexId to)>;
+
+    AStarRouter(const Graph& graph, Heuristic heuristic, bool bidirectional);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+
+    SearchStatistics GetSearchStatistics() const {
+        return {queries_.load(), settled_vertices_.load()};
+    }
+
+private:
+    using QueueItem = std::pair<Weight, VertexId>;
+    using Queue = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>;
+
+    std::optional<RouteInfo> BuildRouteForward(VertexId from, VertexId to) const;
+    // двунаправленный поиск с потенциалом p(v) = (h(v, to) - h(from, v)) / 2 для прямого поиска
+    // и -p(v) для обратного: оба потенциала согласованы, поэтому поиски можно остановить,
+    // как только сумма ключей в вершинах очередей станет не меньше лучшего найденного пути
+    std::optional<RouteInfo> BuildRouteBidirectional(VertexId from, VertexId to) const;
+
+    Weight Estimate(VertexId from, VertexId to) const {
+        return heuristic_ ? heuristic_(from, to) : ZERO_WEIGHT;
+    }
+
+    static constexpr Weight ZERO_WEIGHT{};
+    static constexpr Weight INFINITE_WEIGHT = std::numeric_limits<Weight>::max();
+    const Graph& graph_;
+    const Heuristic heuristic_;
+    const bool bidirectional_;
+    // входящие рёбра вершины v для обратного поиска:
+    // incoming_edges_[incoming_offsets_[v]] .. incoming_edges_[incoming_offsets_[v + 1] - 1]
+    std::vector<size_t> incoming_offsets_;
+    std::vector<EdgeId> incoming_edges_;
+
+    mutable std::atomic<size_t> queries_{0};
+    mutable std::atomic<size_t> settled_vertices_{0};
+};
+
+template <typename Weight>
+AStarRouter<Weight>::AStarRouter(const Graph& graph, Heuristic heuristic, bool bidirectional)
+    : graph_(graph)
+    , heuristic_(std::move(heuristic))
+    , bidirectional_(bidirectional)
+{
+    for (const auto& edge : graph.GetEdges()) {
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+    if (bidirectional_) {
+        incoming_offsets_.assign(graph.GetVertexCount() + 1, 0);
+        for (const auto& edge : graph.GetEdges()) {
+            ++incoming_offsets_[edge.to + 1];
+        }
+        for (VertexId vertex = 0; vertex < graph.GetVertexCount(); ++vertex) {
+            incoming_offsets_[vertex + 1] += incoming_offsets_[vertex];
+        }
+        std::vector<size_t> positions(incoming_offsets_.begin(), incoming_offsets_.end() - 1);
+        incoming_edges_.resize(graph.GetEdgeCount());
+        for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            incoming_edges_[positions[graph.GetEdge(edge_id).to]++] = edge_id;
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<typename AStarRouter<Weight>::RouteInfo> AStarRouter<Weight>::BuildRoute(VertexId from,
+                                                                                       VertexId to) const {
+    if (from >= graph_.GetVertexCount() || to >= graph_.GetVertexCount()) {
+        throw std::out_of_range("Vertex is out of graph");
+    }
+    ++queries_;
+    if (from == to) {
+        return RouteInfo{ZERO_WEIGHT, {}};
+    }
+    return bidirectional_ ? BuildRouteBidirectional(from, to) : BuildRouteForward(from, to);
+}
+
+template <typename Weight>
+std::optional<typename AStarRouter<Weight>::RouteInfo> AStarRouter<Weight>::BuildRouteForward(VertexId from,
+                                                                                              VertexId to) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    std::vector<Weight> weights(vertex_count, INFINITE_WEIGHT);
+    std::vector<Weight> estimates(vertex_count);
+    std::vector<EdgeId> prev_edges(vertex_count);
+    size_t settled_vertices = 0;
+    Queue queue;
+
+    weights[from] = ZERO_WEIGHT;
+    estimates[from] = Estimate(from, to);
+    queue.push({estimates[from], from});
+    while (!queue.empty()) {
+        const auto [key, vertex] = queue.top();
+        queue.pop();
+        if (weights[vertex] + estimates[vertex] < key) {
+            continue;  // устаревшая запись очереди
+        }
+        ++settled_vertices;
+        if (vertex == to) {
+            break;
+        }
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            const Weight candidate_weight = weights[vertex] + edge.weight;
+            if (candidate_weight < weights[edge.to]) {
+                if (weights[edge.to] == INFINITE_WEIGHT) {
+                    estimates[edge.to] = Estimate(edge.to, to);
+                }
+                weights[edge.to] = candidate_weight;
+                prev_edges[edge.to] = edge_id;
+                queue.push({candidate_weight + estimates[edge.to], edge.to});
+            }
+        }
+    }
+    settled_vertices_ += settled_vertices;
+
+    if (weights[to] == INFINITE_WEIGHT) {
+        return std::nullopt;
+    }
+    std::vector<EdgeId> edges;
+    for (VertexId vertex = to; vertex != from; vertex = graph_.GetEdge(edges.back()).from) {
+        edges.push_back(prev_edges[vertex]);
+    }
+    std::reverse(edges.begin(), edges.end());
+    return RouteInfo{weights[to], std::move(edges)};
+}
+
+template <typename Weight>
+std::optional<typename AStarRouter<Weight>::RouteInfo> AStarRouter<Weight>::BuildRouteBidirectional(
+        VertexId from, VertexId to) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    // индекс 0 - прямой поиск от from, 1 - обратный поиск от to
+    std::vector<Weight> weights[2] = {std::vector<Weight>(vertex_count, INFINITE_WEIGHT),
+                                      std::vector<Weight>(vertex_count, INFINITE_WEIGHT)};
+    std::vector<EdgeId> route_edges[2] = {std::vector<EdgeId>(vertex_count), std::vector<EdgeId>(vertex_count)};
+    std::vector<Weight> potentials(vertex_count);
+    Queue queues[2];
+    size_t settled_vertices = 0;
+
+    // потенциал прямого поиска; у обратного он с противоположным знаком
+    const auto potential = [&](VertexId vertex) {
+        return (Estimate(vertex, to) - Estimate(from, vertex)) / 2;
+    };
+    const auto key = [&](size_t direction, VertexId vertex) {
+        return direction == 0 ? weights[0][vertex] + potentials[vertex] : weights[1][vertex] - potentials[vertex];
+    };
+
+    Weight best_weight = INFINITE_WEIGHT;
+    VertexId meeting_vertex = from;
+    potentials[from] = potential(from);
+    potentials[to] = potential(to);
+    weights[0][from] = ZERO_WEIGHT;
+    weights[1][to] = ZERO_WEIGHT;
+    queues[0].push({key(0, from), from});
+    queues[1].push({key(1, to), to});
+
+    while (!queues[0].empty() && !queues[1].empty()) {
+        if (queues[0].top().first + queues[1].top().first >= best_weight) {
+            break;  // ни один путь через непросмотренные вершины не короче найденного
+        }
+        // продолжаем поиск с меньшим приведённым расстоянием
+        const size_t direction = queues[0].top().first - potentials[from]
+            <= queues[1].top().first + potentials[to] ? 0 : 1;
+        const Weight vertex_key = queues[direction].top().first;
+        const VertexId vertex = queues[direction].top().second;
+        queues[direction].pop();
+        if (key(direction, vertex) < vertex_key) {
+            continue;  // устаревшая запись очереди
+        }
+        ++settled_vertices;
+
+        const auto relax = [&](EdgeId edge_id) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            const VertexId next = direction == 0 ? edge.to : edge.from;
+            const Weight candidate_weight = weights[direction][vertex] + edge.weight;
+            if (candidate_weight < weights[direction][next]) {
+                if (weights[0][next] == INFINITE_WEIGHT && weights[1][next] == INFINITE_WEIGHT) {
+                    potentials[next] = potential(next);
+                }
+                weights[direction][next] = candidate_weight;
+                route_edges[direction][next] = edge_id;
+                queues[direction].push({key(direction, next), next});
+            }
+            if (weights[1 - direction][next] != INFINITE_WEIGHT
+                && weights[0][next] + weights[1][next] < best_weight) {
+                best_weight = weights[0][next] + weights[1][next];
+                meeting_vertex = next;
+            }
+        };
+        if (direction == 0) {
+            for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+                relax(edge_id);
+            }
+        } else {
+            for (size_t n = incoming_offsets_[vertex]; n < incoming_offsets_[vertex + 1]; ++n) {
+                relax(incoming_edges_[n]);
+            }
+        }
+    }
+    settled_vertices_ += settled_vertices;
+
+    if (best_weight == INFINITE_WEIGHT) {
+        return std::nullopt;
+    }
+    // рёбра от from до точки встречи, затем от неё до to
+    std::vector<EdgeId> edges;
+    for (VertexId vertex = meeting_vertex; vertex != from; vertex = graph_.GetEdge(edges.back()).from) {
+        edges.push_back(route_edges[0][vertex]);
+    }
+    std::reverse(edges.begin(), edges.end());
+    for (VertexId vertex = meeting_vertex; vertex != to; vertex = graph_.GetEdge(edges.back()).to) {
+        edges.push_back(route_edges[1][vertex]);
+    }
+    return RouteInfo{best_weight, std::move(edges)};
+}
+
 }  // namespace graph
@@ -0,0 +1,247 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace graph {
+
+// Непрерывный блок памяти, выровненный по границе строки кэша.
+// Большие блоки в Linux выделяются через mmap и помечаются MADV_HUGEPAGE,
+// чтобы таблица маршрутов занимала меньше записей TLB.
+// Блок может быть и чужим, например частью отображённого в память файла базы: тогда его
+// держит owner, а сам блок только для чтения.
+class TableMemory {
+public:
+    static constexpr size_t ALIGNMENT = 64;
+    static constexpr size_t HUGE_PAGE_THRESHOLD = size_t{2} << 20;
+
+    TableMemory() = default;
+    explicit TableMemory(size_t size)
+        : size_(size) {
+        if (size_ == 0) {
+            return;
+        }
+#ifdef __linux__
+        if (size_ >= HUGE_PAGE_THRESHOLD) {
+            void* data = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (data != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+                madvise(data, size_, MADV_HUGEPAGE);
+#endif
+                data_ = data;
+                mapped_ = true;
+                return;
+            }
+        }
+#endif
+        data_ = ::operator new(size_, std::align_val_t{ALIGNMENT});
+    }
+
+    // чужой блок: data должен быть выровнен по ALIGNMENT и жить, пока жив owner
+    TableMemory(std::shared_ptr<const void> owner, const void* data, size_t size)
+        : data_(const_cast<void*>(data))
+        , size_(size)
+        , owner_(std::move(owner)) {
+        if (reinterpret_cast<uintptr_t>(data) % ALIGNMENT != 0) {
+            throw std::invalid_argument("Table memory is not aligned");
+        }
+    }
+
+    TableMemory(const TableMemory&) = delete;
+    TableMemory& operator=(const TableMemory&) = delete;
+
+    TableMemory(TableMemory&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr))
+        , size_(std::exchange(other.size_, 0))
+        , mapped_(std::exchange(other.mapped_, false))
+        , owner_(std::move(other.owner_)) {
+    }
+
+    TableMemory& operator=(TableMemory&& other) noexcept {
+        if (this != &other) {
+            Release();
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+            mapped_ = std::exchange(other.mapped_, false);
+            owner_ = std::move(other.owner_);
+        }
+        return *this;
+    }
+
+    ~TableMemory() {
+        Release();
+    }
+
+    void* GetData() const {
+        return data_;
+    }
+
+    size_t GetSize() const {
+        return size_;
+    }
+
+private:
+    void Release() noexcept {
+        if (data_ == nullptr) {
+            return;
+        }
+        if (owner_) {
+            owner_.reset();
+            data_ = nullptr;
+            return;
+        }
+#ifdef __linux__
+        if (mapped_) {
+            munmap(data_, size_);
+            data_ = nullptr;
+            return;
+        }
+#endif
+        ::operator delete(data_, std::align_val_t{ALIGNMENT});
+        data_ = nullptr;
+    }
+
+    void* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    std::shared_ptr<const void> owner_;
+};
+
+// Значения-метки ячеек таблицы маршрутов.
+// Для вещественных весов "маршрута нет" - бесконечность. Для целых (фиксированная точка)
+// - половина диапазона: сумма двух допустимых весов не переполняет тип и не совпадает
+// с меткой, а сумма с меткой никогда не меньше допустимого веса.
+template <typename Value>
+struct RoutesTableValues {
+    static constexpr Value NO_ROUTE = std::numeric_limits<Value>::has_infinity
+        ? std::numeric_limits<Value>::infinity()
+        : std::numeric_limits<Value>::max() / 2;
+    static constexpr Value NO_EDGE = std::numeric_limits<Value>::max();
+};
+
+// Таблица кратчайших маршрутов между всеми парами вершин: плоская матрица весов
+// и отдельная матрица последних рёбер маршрутов в одном непрерывном блоке памяти.
+// Строки дополнены до ROW_ALIGNMENT элементов, чтобы каждая строка начиналась
+// с выровненного адреса.
+//   StoredWeight - тип хранимого веса (Weight или вес в фиксированной точке);
+//   StoredEdge - тип хранимого id ребра (EdgeId или 32-битный id).
+template <typename StoredWeight, typename StoredEdge = EdgeId>
+class RoutesTable {
+    static_assert(std::is_arithmetic_v<StoredWeight> && std::is_unsigned_v<StoredEdge>);
+
+public:
+    using WeightValue = StoredWeight;
+    using EdgeValue = StoredEdge;
+
+    static constexpr StoredWeight NO_ROUTE = RoutesTableValues<StoredWeight>::NO_ROUTE;
+    static constexpr StoredEdge NO_EDGE = RoutesTableValues<StoredEdge>::NO_EDGE;
+    static constexpr size_t ROW_ALIGNMENT = 16;
+
+    RoutesTable() = default;
+    explicit RoutesTable(size_t vertex_count)
+        : vertex_count_(vertex_count)
+        , stride_((vertex_count + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT)
+        , edges_offset_(AlignUp(vertex_count_ * stride_ * sizeof(StoredWeight)))
+        , memory_(edges_offset_ + vertex_count_ * stride_ * sizeof(StoredEdge)) {
+        std::fill_n(GetWeightsRow(0), vertex_count_ * stride_, NO_ROUTE);
+        std::fill_n(GetPrevEdgesRow(0), vertex_count_ * stride_, NO_EDGE);
+    }
+    // таблица в готовом блоке памяти с раскладкой GetMemoryData()
+    RoutesTable(size_t vertex_count, TableMemory memory)
+        : vertex_count_(vertex_count)
+        , stride_((vertex_count + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT)
+        , edges_offset_(AlignUp(vertex_count_ * stride_ * sizeof(StoredWeight)))
+        , memory_(std::move(memory)) {
+        if (memory_.GetSize() != edges_offset_ + vertex_count_ * stride_ * sizeof(StoredEdge)) {
+            throw std::invalid_argument("Routes table memory does not match vertex count");
+        }
+    }
+
+    size_t GetVertexCount() const {
+        return vertex_count_;
+    }
+
+    // расстояние в элементах между началами соседних строк
+    size_t GetStride() const {
+        return stride_;
+    }
+
+    // размер таблицы в байтах
+    size_t GetMemorySize() const {
+        return memory_.GetSize();
+    }
+
+    // вся таблица одним блоком: матрица весов, затем с выровненного смещения матрица рёбер
+    const void* GetMemoryData() const {
+        return memory_.GetData();
+    }
+
+    StoredWeight* GetWeightsRow(VertexId from) {
+        return static_cast<StoredWeight*>(memory_.GetData()) + from * stride_;
+    }
+    const StoredWeight* GetWeightsRow(VertexId from) const {
+        return static_cast<const StoredWeight*>(memory_.GetData()) + from * stride_;
+    }
+    StoredEdge* GetPrevEdgesRow(VertexId from) {
+        return reinterpret_cast<StoredEdge*>(static_cast<char*>(memory_.GetData()) + edges_offset_) + from * stride_;
+    }
+    const StoredEdge* GetPrevEdgesRow(VertexId from) const {
+        return reinterpret_cast<const StoredEdge*>(static_cast<const char*>(memory_.GetData()) + edges_offset_)
+            + from * stride_;
+    }
+
+    StoredWeight GetWeight(VertexId from, VertexId to) const {
+        return GetWeightsRow(from)[to];
+    }
+    StoredEdge GetPrevEdge(VertexId from, VertexId to) const {
+        return GetPrevEdgesRow(from)[to];
+    }
+    bool HasRoute(VertexId from, VertexId to) const {
+        return GetWeight(from, to) != NO_ROUTE;
+    }
+
+    void SetRoute(VertexId from, VertexId to, StoredWeight weight, StoredEdge prev_edge) {
+        GetWeightsRow(from)[to] = weight;
+        GetPrevEdgesRow(from)[to] = prev_edge;
+    }
+
+private:
+    static size_t AlignUp(size_t size) {
+        return (size + TableMemory::ALIGNMENT - 1) / TableMemory::ALIGNMENT * TableMemory::ALIGNMENT;
+    }
+
+    size_t vertex_count_ = 0;
+    size_t stride_ = 0;
+    size_t edges_offset_ = 0;
+    TableMemory memory_;
+};
+
+// Компактная таблица: веса - 32-битная фиксированная точка, рёбра - 32-битные id.
+// 8 байт на пару вершин вместо 16 у таблицы с весами double.
+using CompactRoutesTable = RoutesTable<uint32_t, uint32_t>;
+
+// переводит вес в фиксированную точку компактной таблицы
+template <typename Weight>
+uint32_t ToFixedPointWeight(Weight weight, double ticks_per_unit) {
+    const double ticks = std::round(static_cast<double>(weight) * ticks_per_unit);
+    if (!(ticks >= 0.0 && ticks < static_cast<double>(CompactRoutesTable::NO_ROUTE))) {
+        throw std::out_of_range("Edge weight doesn't fit the compact routes table");
+    }
+    return static_cast<uint32_t>(ticks);
+}
+
+}  // namespace graph
@@ -1,124 +1,977 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
 #include "serialization.h"
 
 namespace serialization {
 
+	namespace {
+
+		// разделы отображаемой базы
+		namespace section {
+			constexpr uint32_t SETTINGS = 1;           // Base только с render_settings и route_settings
+			constexpr uint32_t NAMES = 2;              // названия подряд по порядку id
+			constexpr uint32_t NAME_LENGTHS = 3;
+			constexpr uint32_t NAME_SEED = 4;          // PerfectHash::Data
+			constexpr uint32_t NAME_PILOTS = 5;
+			constexpr uint32_t NAME_SORTED_IDS = 6;
+			constexpr uint32_t STOP_NAME_IDS = 7;      // остановки по id
+			constexpr uint32_t STOP_LATITUDES = 8;
+			constexpr uint32_t STOP_LONGITUDES = 9;
+			constexpr uint32_t ROUTE_NAME_IDS = 10;    // маршруты по id
+			constexpr uint32_t ROUTE_TYPES = 11;
+			constexpr uint32_t ROUTE_STOP_OFFSETS = 12; // остановки маршрута id - ROUTE_STOP_IDS
+			constexpr uint32_t ROUTE_STOP_IDS = 13;     // с номерами [offsets[id], offsets[id + 1])
+			constexpr uint32_t DISTANCES = 14;         // заданные расстояния
+			constexpr uint32_t ROUTE_INFOS = 15;
+			constexpr uint32_t STOP_ROUTE_OFFSETS = 16; // StopRoutes
+			constexpr uint32_t STOP_ROUTE_IDS = 17;
+			constexpr uint32_t STOP_GRID = 18;          // SpatialIndex::Data
+			constexpr uint32_t STOP_GRID_OFFSETS = 19;
+			constexpr uint32_t STOP_GRID_IDS = 20;
+			constexpr uint32_t GRAPH_VERTEX_COUNT = 21;
+			constexpr uint32_t GRAPH_EDGES = 22;
+			constexpr uint32_t ROUTES_TABLE = 23;      // MappedRoutesTable
+			constexpr uint32_t ROUTES_TABLE_MEMORY = 24; // блок RoutesTable как в памяти
+			constexpr uint32_t HIERARCHY_SHORTCUTS = 25;
+			constexpr uint32_t HIERARCHY_UPWARD_OFFSETS = 26;
+			constexpr uint32_t HIERARCHY_UPWARD_EDGES = 27;
+			constexpr uint32_t HIERARCHY_DOWNWARD_OFFSETS = 28;
+			constexpr uint32_t HIERARCHY_DOWNWARD_EDGES = 29;
+			constexpr uint32_t SOURCE = 30;            // MappedSource, только в образе в общей памяти
+			constexpr uint32_t NAME_POSITIONS = 31;    // id названий по позициям хеш-функции
+			constexpr uint32_t DISTANCE_OFFSETS = 32;  // StopDistances
+			constexpr uint32_t DISTANCE_NEIGHBOURS = 33;
+			constexpr uint32_t DISTANCE_VALUES = 34;
+			constexpr uint32_t ROUTE_FORWARD_DISTANCES = 35; // суммы расстояний вдоль маршрутов
+			constexpr uint32_t ROUTE_BACKWARD_DISTANCES = 36;
+			constexpr uint32_t STOP_UNIT_X = 37;       // единичные векторы остановок по id
+			constexpr uint32_t STOP_UNIT_Y = 38;
+			constexpr uint32_t STOP_UNIT_Z = 39;
+			constexpr uint32_t STOP_GRID_X = 40;       // единичные векторы остановок в порядке сетки
+			constexpr uint32_t STOP_GRID_Y = 41;
+			constexpr uint32_t STOP_GRID_Z = 42;
+			constexpr uint32_t GRAPH_OFFSETS = 43;     // смещения рёбер по вершинам
+		} // namespace section
+
+		struct MappedGrid {
+			double min_lat;
+			double min_lng;
+			double cell_lat;
+			double cell_lng;
+			uint32_t rows;
+			uint32_t cols;
+		};
+
+		struct MappedRouteInfo {
+			uint32_t stop_count;
+			uint32_t unique_stop_count;
+			uint64_t route_length;
+			double curvature;
+		};
+
+		// файл базы, из которого собран образ в общей памяти
+		struct MappedSource {
+			uint64_t file_size;
+			int64_t modified; // время изменения в единицах file_time_type
+		};
+
+		// false, если файла базы нет
+		bool GetSourceStamp(const Path& path, MappedSource& stamp) {
+			std::error_code error;
+			const uintmax_t file_size = std::filesystem::file_size(path, error);
+			if (error) {
+				return false;
+			}
+			const std::filesystem::file_time_type modified = std::filesystem::last_write_time(path, error);
+			if (error) {
+				return false;
+			}
+			stamp.file_size = file_size;
+			stamp.modified = static_cast<int64_t>(modified.time_since_epoch().count());
+			return true;
+		}
+
+		// позиция следующего значения при чтении таблицы маршрутов по строкам
+		struct TableCursor {
+			size_t row = 0;
+			size_t column = 0;
+			bool overflow = false; // значение пришло до размера таблицы или сверх него
+
+			// true, если в таблице есть место для следующего значения
+			template <typename Table>
+			bool Reserve(const std::optional<Table>& table) {
+				overflow = overflow || !table || row >= table->GetVertexCount();
+				return !overflow;
+			}
+
+			void Next(size_t vertex_count) {
+				if (++column == vertex_count) {
+					column = 0;
+					++row;
+				}
+			}
+
+			template <typename Table>
+			bool Complete(const Table& table) const {
+				return !overflow && row == table.GetVertexCount();
+			}
+		};
+
+		struct MappedRoutesTable {
+			uint64_t vertex_count;
+			uint32_t compact; // 1 - CompactRoutesTable, 0 - таблица с весами double
+			uint32_t reserved;
+		};
+
+		// CompactCatalogue
+
+		// наибольшее число знаков после запятой в координатах с фиксированной точкой
+		constexpr uint32_t MAX_COORDINATE_DIGITS = 9;
+
+		double PowerOfTen(uint32_t digits) {
+			double result = 1.0;
+			for (uint32_t n = 0; n < digits; ++n) {
+				result *= 10.0;
+			}
+			return result;
+		}
+
+		// наименьшее число знаков после запятой, с которым все координаты восстанавливаются
+		// без потерь; nullopt, если его нет среди 0..MAX_COORDINATE_DIGITS
+		std::optional<uint32_t> FindCoordinateDigits(const transport_catalogue::StopCoordinates& coordinates) {
+			const auto exact = [](const ranges::FrozenArray<double>& values, double scale) {
+				return std::all_of(values.begin(), values.end(), [scale](double value) {
+					if (!std::isfinite(value) || std::abs(value * scale) >= 1e15) {
+						return false;
+					}
+					const double restored = static_cast<double>(std::llround(value * scale)) / scale;
+					return restored == value && std::signbit(restored) == std::signbit(value);
+				});
+			};
+			for (uint32_t digits = 0; digits <= MAX_COORDINATE_DIGITS; ++digits) {
+				const double scale = PowerOfTen(digits);
+				if (exact(coordinates.latitudes, scale) && exact(coordinates.longitudes, scale)) {
+					return digits;
+				}
+			}
+			return std::nullopt;
+		}
+
+		// названия по возрастанию и длины общих начал с предыдущим названием
+		struct FrontCodedNames {
+			std::vector<uint32_t> sorted_ids;
+			std::vector<uint32_t> prefix_lengths;
+		};
+
+		FrontCodedNames FrontCodeNames(const transport_catalogue::NamePool& names) {
+			FrontCodedNames result;
+			if (names.IsFrozen()) {
+				result.sorted_ids.assign(names.GetSortedIds().begin(), names.GetSortedIds().end());
+			} else {
+				result.sorted_ids.resize(names.Size());
+				std::iota(result.sorted_ids.begin(), result.sorted_ids.end(), 0);
+				std::sort(result.sorted_ids.begin(), result.sorted_ids.end(), [&names](uint32_t lhs, uint32_t rhs) {
+					return names.Get(lhs) < names.Get(rhs);
+				});
+			}
+			result.prefix_lengths.reserve(result.sorted_ids.size());
+			std::string_view previous;
+			for (const uint32_t name_id : result.sorted_ids) {
+				const std::string_view name = names.Get(name_id);
+				const size_t common = std::min(previous.size(), name.size());
+				const size_t prefix = std::mismatch(name.begin(), name.begin() + common, previous.begin()).first - name.begin();
+				result.prefix_lengths.push_back(static_cast<uint32_t>(prefix));
+				previous = name;
+			}
+			return result;
+		}
+
+		// упакованное поле sint64 из разностей соседних значений value(n), первое - разность с нулём
+		template <typename Sink, typename Value>
+		void WritePackedDeltas(Sink& sink, int field, size_t count, Value value) {
+			WritePackedField<SintEncoding>(sink, field, count, 1, [&value](size_t n, size_t) {
+				return static_cast<int64_t>(value(n)) - (n > 0 ? static_cast<int64_t>(value(n - 1)) : 0);
+			});
+		}
+
+		template <typename Sink>
+		void WriteCompactCatalogue(Sink& sink, const transport_catalogue::TransportCatalogue& catalogue,
+			const FrontCodedNames& names, std::optional<uint32_t> coordinate_digits) {
+			using Proto = transport_catalogue_proto::CompactCatalogue;
+			const transport_catalogue::NamePool& pool = catalogue.GetNames();
+			const size_t name_count = names.sorted_ids.size();
+
+			WritePackedVarints(sink, Proto::kNamePrefixLengthsFieldNumber, names.prefix_lengths);
+			WritePackedField<VarintEncoding>(sink, Proto::kNameSuffixLengthsFieldNumber, name_count, 1,
+				[&pool, &names](size_t n, size_t) {
+					return pool.Get(names.sorted_ids[n]).size() - names.prefix_lengths[n];
+				});
+			WriteNestedField(sink, Proto::kNameSuffixesFieldNumber, [&pool, &names, name_count](auto& bytes) {
+				for (size_t n = 0; n < name_count; ++n) {
+					const std::string_view suffix = pool.Get(names.sorted_ids[n]).substr(names.prefix_lengths[n]);
+					bytes.WriteRaw(suffix.data(), static_cast<int>(suffix.size()));
+				}
+			});
+			WritePackedVarints(sink, Proto::kSortedIdsFieldNumber, names.sorted_ids);
+
+			const size_t stop_count = catalogue.GetNumberStops();
+			WritePackedDeltas(sink, Proto::kStopNameIdDeltasFieldNumber, stop_count, [&catalogue](size_t id) {
+				return catalogue.GetStopById(static_cast<uint32_t>(id))->name_id;
+			});
+			const transport_catalogue::StopCoordinates& coordinates = catalogue.GetStopCoordinates();
+			if (coordinate_digits) {
+				const double scale = PowerOfTen(*coordinate_digits);
+				WriteVarintField(sink, Proto::kCoordinateDigitsFieldNumber, *coordinate_digits);
+				WritePackedDeltas(sink, Proto::kLatitudeDeltasFieldNumber, stop_count, [&coordinates, scale](size_t id) {
+					return std::llround(coordinates.latitudes[id] * scale);
+				});
+				WritePackedDeltas(sink, Proto::kLongitudeDeltasFieldNumber, stop_count, [&coordinates, scale](size_t id) {
+					return std::llround(coordinates.longitudes[id] * scale);
+				});
+			} else {
+				WritePackedField<DoubleEncoding>(sink, Proto::kLatitudesFieldNumber, stop_count, 1,
+					[&coordinates](size_t id, size_t) { return coordinates.latitudes[id]; });
+				WritePackedField<DoubleEncoding>(sink, Proto::kLongitudesFieldNumber, stop_count, 1,
+					[&coordinates](size_t id, size_t) { return coordinates.longitudes[id]; });
+			}
+
+			const size_t route_count = catalogue.GetNumberRoutes();
+			const auto route_of = [&catalogue](size_t id) {
+				return catalogue.GetRouteById(static_cast<uint32_t>(id));
+			};
+			WritePackedDeltas(sink, Proto::kRouteNameIdDeltasFieldNumber, route_count, [&route_of](size_t id) {
+				return route_of(id)->name_id;
+			});
+			WritePackedField<VarintEncoding>(sink, Proto::kRouteCircularFieldNumber, route_count, 1,
+				[&route_of](size_t id, size_t) { return route_of(id)->route_type == RouteType::CIRCLE ? 1 : 0; });
+			WritePackedField<VarintEncoding>(sink, Proto::kRouteStopCountsFieldNumber, route_count, 1,
+				[&route_of](size_t id, size_t) { return route_of(id)->stops.size(); });
+			std::vector<int64_t> stop_deltas;
+			for (size_t id = 0; id < route_count; ++id) {
+				const uint32_t* stop_ids = route_of(id)->stops.GetIds();
+				for (size_t n = 0; n < route_of(id)->stops.size(); ++n) {
+					stop_deltas.push_back(static_cast<int64_t>(stop_ids[n]) - (n > 0 ? static_cast<int64_t>(stop_ids[n - 1]) : 0));
+				}
+			}
+			WritePackedField<SintEncoding>(sink, Proto::kRouteStopDeltasFieldNumber, stop_deltas.size(), 1,
+				[&stop_deltas](size_t n, size_t) { return stop_deltas[n]; });
+
+			// после заморозки расстояния упорядочены по остановкам, поэтому разности малы
+			const auto& distances = catalogue.GetAllDistanceBeetweenPairStops();
+			WritePackedDeltas(sink, Proto::kDistanceFromDeltasFieldNumber, distances.size(), [&distances](size_t n) {
+				return distances[n].id_stop_from;
+			});
+			WritePackedField<SintEncoding>(sink, Proto::kDistanceToDeltasFieldNumber, distances.size(), 1,
+				[&distances](size_t n, size_t) {
+					const bool same_from = n > 0 && distances[n - 1].id_stop_from == distances[n].id_stop_from;
+					return static_cast<int64_t>(distances[n].id_stop_to)
+						- (same_from ? static_cast<int64_t>(distances[n - 1].id_stop_to) : 0);
+				});
+			WritePackedField<VarintEncoding>(sink, Proto::kDistancesFieldNumber, distances.size(), 1,
+				[&distances](size_t n, size_t) { return distances[n].distance; });
+		}
+
+		// рёбра замороженного графа упорядочены по начальной вершине: она задаётся числом
+		// исходящих рёбер каждой вершины
+		template <typename Sink>
+		void WriteCompactGraph(Sink& sink, const transport_router::Graph& graph) {
+			using Proto = transport_router_proto::CompactGraph;
+			const auto& edges = graph.GetEdges();
+
+			WriteVarintField(sink, Proto::kVertexCountFieldNumber, graph.GetVertexCount());
+			WritePackedField<VarintEncoding>(sink, Proto::kOutDegreesFieldNumber, graph.GetVertexCount(), 1,
+				[&graph](size_t vertex, size_t) {
+					const auto outgoing_edges = graph.GetOutgoingEdges(vertex);
+					return static_cast<uint64_t>(outgoing_edges.end() - outgoing_edges.begin());
+				});
+			WritePackedField<SintEncoding>(sink, Proto::kToDeltasFieldNumber, edges.size(), 1, [&edges](size_t n, size_t) {
+				return static_cast<int64_t>(edges[n].to) - static_cast<int64_t>(edges[n].from);
+			});
+			WritePackedField<DoubleEncoding>(sink, Proto::kWeightsFieldNumber, edges.size(), 1,
+				[&edges](size_t n, size_t) { return edges[n].weight; });
+			WritePackedField<VarintEncoding>(sink, Proto::kSpanCountsFieldNumber, edges.size(), 1,
+				[&edges](size_t n, size_t) { return edges[n].span_count; });
+			WritePackedField<VarintEncoding>(sink, Proto::kBusNameIdsFieldNumber, edges.size(), 1,
+				[&edges](size_t n, size_t) { return edges[n].bus_name_id; });
+		}
+
+	} // namespace
+
 	Serialization::Serialization(transport_catalogue::TransportCatalogue& transport_catalogue, 
 	    renderer::MapRenderer& map_renderer, transport_router::TransportRouter& transport_router) :
 		transport_catalogue_(transport_catalogue), map_renderer_(map_renderer), 
 		transport_router_(transport_router) { };
 
 	void Serialization::SaveTo() {
+		if (serialization_settings_.format == BaseFormat::MAPPED) {
+			if (!SaveMapped(serialization_settings_.file_name, false)) {
+				throw std::runtime_error("Cannot write base " + serialization_settings_.file_name.string());
+			}
+			return;
+		}
 		std::ofstream output(serialization_settings_.file_name, std::ios::binary);
 		
 		if (!output) {
-			return;
+			throw std::runtime_error("Cannot write base " + serialization_settings_.file_name.string());
 		}
 
-		transport_catalogue_proto::Base base;
+		// сообщение Base пишется по полям: настройки и справочник без расстояний собираются
+		// сообщениями, расстояния, граф, таблица маршрутов и иерархия пишутся потоком прямо из
+		// структур программы, поэтому их копий в памяти не появляется
+		google::protobuf::io::OstreamOutputStream stream(&output);
+		CodedOutputStream coded(&stream);
+		using Base = transport_catalogue_proto::Base;
+
+		const bool compact = serialization_settings_.format == BaseFormat::COMPACT;
+		if (compact) {
+			// только исходные данные справочника; производные структуры строятся при загрузке
+			const FrontCodedNames names = FrontCodeNames(transport_catalogue_.GetNames());
+			const std::optional<uint32_t> coordinate_digits =
+				FindCoordinateDigits(transport_catalogue_.GetStopCoordinates());
+			WriteNestedField(coded, Base::kCompactCatalogueFieldNumber, [this, &names, coordinate_digits](auto& sink) {
+				WriteCompactCatalogue(sink, transport_catalogue_, names, coordinate_digits);
+			});
+		} else {
+			const transport_catalogue_proto::TransportCatalogue catalogue = TransportCatalogueToProto();
+			catalogue.ByteSizeLong();
+			WriteNestedField(coded, Base::kTransportCatalogueFieldNumber, [this, &catalogue](auto& sink) {
+				using ProtoDistance = transport_catalogue_proto::Distance;
+				WriteMessageBody(sink, catalogue);
+				for (const DistanceBeetweenPairStops& distance : transport_catalogue_.GetAllDistanceBeetweenPairStops()) {
+					WriteNestedField(sink, transport_catalogue_proto::TransportCatalogue::kDistancesFieldNumber,
+						[&distance](auto& proto_distance) {
+							WriteVarintField(proto_distance, ProtoDistance::kIdStopFromFieldNumber, distance.id_stop_from);
+							WriteVarintField(proto_distance, ProtoDistance::kIdStopToFieldNumber, distance.id_stop_to);
+							WriteVarintField(proto_distance, ProtoDistance::kDistanceFieldNumber, distance.distance);
+						});
+				}
+			});
+		}
 
-		*(base.mutable_transport_catalogue()) = TransportCatalogueToProto();
-		*(base.mutable_render_settings()) = RenderSettingsToProto(map_renderer_.GetRenderSettings());
-		*(base.mutable_route_settings()) = RouteSettingsToProto(transport_router_.GetRoutingSettings());
-	    *(base.mutable_graph()) = GraphToProto();
+		const map_renderer_proto::RenderSettings render_settings = RenderSettingsToProto(map_renderer_.GetRenderSettings());
+		render_settings.ByteSizeLong();
+		WriteMessageField(coded, Base::kRenderSettingsFieldNumber, render_settings);
+		const transport_router_proto::RouterSettings route_settings =
+			RouteSettingsToProto(transport_router_.GetRoutingSettings());
+		route_settings.ByteSizeLong();
+		WriteMessageField(coded, Base::kRouteSettingsFieldNumber, route_settings);
 
-		base.SerializeToOstream(&output);
+		if (compact) {
+			WriteNestedField(coded, Base::kCompactGraphFieldNumber, [this](auto& sink) {
+				WriteCompactGraph(sink, transport_router_.GetGraph());
+			});
+		} else {
+			WriteNestedField(coded, Base::kGraphFieldNumber, [this](auto& sink) {
+				WriteGraph(sink);
+			});
+		}
+		if (transport_router_.GetRoutingSettings().router_engine == RouterEngine::ALL_PAIRS) {
+			WriteNestedField(coded, Base::kRoutesInternalDataFieldNumber, [this](auto& sink) {
+				WriteRoutesInternalData(sink);
+			});
+		}
+		if (transport_router_.GetRoutingSettings().router_engine == RouterEngine::CONTRACTION_HIERARCHY) {
+			WriteNestedField(coded, Base::kContractionHierarchyFieldNumber, [this](auto& sink) {
+				WriteHierarchy(sink);
+			});
+		}
 	}
 
 	void Serialization::LoadFrom() {
-		std::ifstream input(serialization_settings_.file_name, std::ios::binary);
-		if (!input) {
+		if (!serialization_settings_.shared_image.empty()) {
+			LoadSharedImage();
+			return;
+		}
+		LoadBase();
+	}
+
+	void Serialization::LoadBase() {
+		if (IsMappedBase(serialization_settings_.file_name)) {
+			LoadMapped(std::make_shared<const MappedBase>(serialization_settings_.file_name,
+				serialization_settings_.verify_checksums));
+			return;
+		}
+		auto input = std::make_shared<std::ifstream>(serialization_settings_.file_name, std::ios::binary);
+		if (!*input) {
 			return;
 		}
 
-		transport_catalogue_proto::Base base;
-		if (!base.ParseFromIstream(&input)) {
+		// оглавление сообщения Base: положение каждого поля в файле. Сразу разбираются только
+		// справочник и настройки маршрутов; остальные поля читаются из файла потоком при первом
+		// запросе, которому они нужны
+		using Base = transport_catalogue_proto::Base;
+		auto contents = std::make_shared<std::unordered_map<uint32_t, FieldSpan>>();
+		if (!ReadContents(*input, *contents)) {
 			return;
 		}
+		const auto find_span = [contents](uint32_t field) -> const FieldSpan* {
+			const auto span = contents->find(field);
+			return span != contents->end() ? &span->second : nullptr;
+		};
 
-		ProtoToTransportCatalogue(*base.mutable_transport_catalogue());
-		ProtoToRenderSettings(*base.mutable_render_settings());
-		ProtoToRouteSettings(*base.mutable_route_settings());
-		ProtoToGraph(*base.mutable_graph());
+		transport_router_proto::RouterSettings route_settings;
+		if (const FieldSpan* span = find_span(Base::kRouteSettingsFieldNumber);
+			span != nullptr && !ParseSpan(*input, *span, route_settings)) {
+			return;
+		}
+		if (const FieldSpan* span = find_span(Base::kCompactCatalogueFieldNumber); span != nullptr) {
+			ReadCompactCatalogue(*input, *span);
+		} else {
+			transport_catalogue_proto::TransportCatalogue catalogue;
+			if (const FieldSpan* span = find_span(Base::kTransportCatalogueFieldNumber);
+				span != nullptr && !ParseSpan(*input, *span, catalogue)) {
+				return;
+			}
+			ProtoToTransportCatalogue(catalogue);
+		}
+		ProtoToRouteSettings(route_settings);
 
+		pending_render_settings_ = [this, input, find_span] {
+			map_renderer_proto::RenderSettings render_settings;
+			if (const FieldSpan* span = find_span(Base::kRenderSettingsFieldNumber);
+				span != nullptr && !ParseSpan(*input, *span, render_settings)) {
+				throw std::invalid_argument("Corrupted render settings");
+			}
+			ProtoToRenderSettings(render_settings);
+		};
+		// таблицы маршрутизатора рассчитаны при make_base, поэтому здесь ничего не пересчитываем;
+		// для базы без таблиц маршрутизатор строится по загруженному графу
+		pending_router_ = [this, input, find_span] {
+			transport_router::Graph graph;
+			if (const FieldSpan* span = find_span(Base::kCompactGraphFieldNumber); span != nullptr) {
+				graph = ReadCompactGraph(*input, *span);
+			} else if (const FieldSpan* span = find_span(Base::kGraphFieldNumber); span != nullptr) {
+				graph = ReadGraph(*input, *span);
+			}
+			const FieldSpan* table_span = find_span(Base::kRoutesInternalDataFieldNumber);
+			const FieldSpan* hierarchy_span = find_span(Base::kContractionHierarchyFieldNumber);
+			if (table_span != nullptr
+				&& transport_router_.GetRoutingSettings().router_engine == RouterEngine::ALL_PAIRS) {
+				transport_router_.SetGraph(std::move(graph), ReadRoutesInternalData(*input, *table_span));
+			} else if (hierarchy_span != nullptr
+				&& transport_router_.GetRoutingSettings().router_engine == RouterEngine::CONTRACTION_HIERARCHY) {
+				transport_router_.SetGraph(std::move(graph), ReadHierarchy(*input, *hierarchy_span));
+			} else {
+				transport_router_.SetGraph(std::move(graph));
+			}
+		};
+	}
+
+	void Serialization::LoadRouter() {
+		if (pending_router_) {
+			const std::function<void()> load = std::move(pending_router_);
+			pending_router_ = nullptr;
+			load();
+		}
+	}
+
+	void Serialization::LoadRenderSettings() {
+		if (pending_render_settings_) {
+			const std::function<void()> load = std::move(pending_render_settings_);
+			pending_render_settings_ = nullptr;
+			load();
+		}
 	}
 
 	void Serialization::SetSettings(SerializationSettings serialization_settings) {
 		serialization_settings_ = serialization_settings;
 	}
 
+	// MappedBase -----------------------------------------------------------------
+
+	bool Serialization::SaveMapped(const Path& path, bool stamp_source) {
+		MappedBaseWriter writer;
+		if (stamp_source) {
+			MappedSource source;
+			if (!GetSourceStamp(serialization_settings_.file_name, source)) {
+				return false;
+			}
+			writer.AddValue(section::SOURCE, source);
+		}
+
+		transport_catalogue_proto::Base settings;
+		*(settings.mutable_render_settings()) = RenderSettingsToProto(map_renderer_.GetRenderSettings());
+		*(settings.mutable_route_settings()) = RouteSettingsToProto(transport_router_.GetRoutingSettings());
+		writer.AddBytes(section::SETTINGS, settings.SerializeAsString());
+
+		// массивы, которые писатель не копирует, живут до WriteTo
+		const transport_catalogue::NamePool& names = transport_catalogue_.GetNames();
+		std::string name_block;
+		std::vector<uint32_t> name_lengths;
+		name_lengths.reserve(names.Size());
+		for (uint32_t name_id = 0; name_id < names.Size(); ++name_id) {
+			name_block.append(names.Get(name_id));
+			name_lengths.push_back(static_cast<uint32_t>(names.Get(name_id).size()));
+		}
+		writer.AddBytes(section::NAMES, std::move(name_block));
+		writer.AddArray(section::NAME_LENGTHS, name_lengths);
+		if (names.IsFrozen()) {
+			writer.AddValue(section::NAME_SEED, names.GetIndex().GetData().seed);
+			writer.AddArray(section::NAME_PILOTS, names.GetIndex().GetData().pilots);
+			writer.AddArray(section::NAME_SORTED_IDS, names.GetSortedIds());
+			writer.AddArray(section::NAME_POSITIONS, names.GetNameIdsByPosition());
+		}
+
+		const uint32_t stop_count = transport_catalogue_.GetNumberStops();
+		std::vector<uint32_t> stop_name_ids(stop_count);
+		for (uint32_t id = 0; id < stop_count; ++id) {
+			stop_name_ids[id] = transport_catalogue_.GetStopById(id)->name_id;
+		}
+		writer.AddArray(section::STOP_NAME_IDS, stop_name_ids);
+		const transport_catalogue::StopCoordinates& coordinates = transport_catalogue_.GetStopCoordinates();
+		writer.AddArray(section::STOP_LATITUDES, coordinates.latitudes);
+		writer.AddArray(section::STOP_LONGITUDES, coordinates.longitudes);
+		writer.AddArray(section::STOP_UNIT_X, coordinates.unit_vectors.x);
+		writer.AddArray(section::STOP_UNIT_Y, coordinates.unit_vectors.y);
+		writer.AddArray(section::STOP_UNIT_Z, coordinates.unit_vectors.z);
+
+		const uint32_t route_count = transport_catalogue_.GetNumberRoutes();
+		std::vector<uint32_t> route_name_ids(route_count);
+		std::vector<uint8_t> route_types(route_count);
+		std::vector<uint32_t> route_stop_offsets(route_count + 1, 0);
+		std::vector<uint32_t> route_stop_ids;
+		for (uint32_t id = 0; id < route_count; ++id) {
+			const Route* route = transport_catalogue_.GetRouteById(id);
+			route_name_ids[id] = route->name_id;
+			route_types[id] = static_cast<uint8_t>(route->route_type);
+			route_stop_ids.insert(route_stop_ids.end(), route->stops.GetIds(), route->stops.GetIds() + route->stops.size());
+			route_stop_offsets[id + 1] = static_cast<uint32_t>(route_stop_ids.size());
+		}
+		writer.AddArray(section::ROUTE_NAME_IDS, route_name_ids);
+		writer.AddArray(section::ROUTE_TYPES, route_types);
+		writer.AddArray(section::ROUTE_STOP_OFFSETS, route_stop_offsets);
+		writer.AddArray(section::ROUTE_STOP_IDS, route_stop_ids);
+
+		writer.AddArray(section::DISTANCES, transport_catalogue_.GetAllDistanceBeetweenPairStops());
+		const transport_catalogue::StopDistances& distances = transport_catalogue_.GetStopDistances();
+		writer.AddArray(section::DISTANCE_OFFSETS, distances.offsets);
+		writer.AddArray(section::DISTANCE_NEIGHBOURS, distances.neighbours);
+		writer.AddArray(section::DISTANCE_VALUES, distances.distances);
+		writer.AddArray(section::ROUTE_FORWARD_DISTANCES, transport_catalogue_.GetRouteForwardDistances());
+		writer.AddArray(section::ROUTE_BACKWARD_DISTANCES, transport_catalogue_.GetRouteBackwardDistances());
+
+		std::vector<MappedRouteInfo> route_infos;
+		route_infos.reserve(transport_catalogue_.GetRouteInfos().size());
+		for (const RouteInfo& route_info : transport_catalogue_.GetRouteInfos()) {
+			route_infos.push_back({static_cast<uint32_t>(route_info.number_of_stops),
+				static_cast<uint32_t>(route_info.number_of_unique_stops), route_info.route_length, route_info.curvature});
+		}
+		writer.AddArray(section::ROUTE_INFOS, route_infos);
+
+		writer.AddArray(section::STOP_ROUTE_OFFSETS, transport_catalogue_.GetStopRoutes().offsets);
+		writer.AddArray(section::STOP_ROUTE_IDS, transport_catalogue_.GetStopRoutes().route_ids);
+
+		const geo::SpatialIndex::Data& grid = transport_catalogue_.GetStopIndex().GetData();
+		writer.AddValue(section::STOP_GRID, MappedGrid{grid.min_lat, grid.min_lng, grid.cell_lat, grid.cell_lng,
+			grid.rows, grid.cols});
+		writer.AddArray(section::STOP_GRID_OFFSETS, grid.offsets);
+		writer.AddArray(section::STOP_GRID_IDS, grid.ids);
+		const geo::UnitVectors& grid_points = transport_catalogue_.GetStopIndex().GetPoints();
+		writer.AddArray(section::STOP_GRID_X, grid_points.x);
+		writer.AddArray(section::STOP_GRID_Y, grid_points.y);
+		writer.AddArray(section::STOP_GRID_Z, grid_points.z);
+
+		const transport_router::Graph& graph = transport_router_.GetGraph();
+		writer.AddValue(section::GRAPH_VERTEX_COUNT, static_cast<uint64_t>(graph.GetVertexCount()));
+		writer.AddArray(section::GRAPH_EDGES, graph.GetEdges());
+		writer.AddArray(section::GRAPH_OFFSETS, graph.GetOffsets());
+
+		const RoutingSettings& routing_settings = transport_router_.GetRoutingSettings();
+		if (routing_settings.router_engine == RouterEngine::ALL_PAIRS) {
+			std::visit([&writer](const auto& table) {
+				using Table = std::decay_t<decltype(table)>;
+				writer.AddValue(section::ROUTES_TABLE, MappedRoutesTable{table.GetVertexCount(),
+					std::is_same_v<Table, graph::CompactRoutesTable> ? 1u : 0u, 0});
+				writer.AddArray(section::ROUTES_TABLE_MEMORY, static_cast<const char*>(table.GetMemoryData()),
+					table.GetMemorySize());
+			}, transport_router_.GetRoutesInternalData());
+		}
+		if (routing_settings.router_engine == RouterEngine::CONTRACTION_HIERARCHY) {
+			const transport_router::TransportRouter::Hierarchy& hierarchy = transport_router_.GetHierarchy();
+			writer.AddArray(section::HIERARCHY_SHORTCUTS, hierarchy.shortcuts);
+			writer.AddArray(section::HIERARCHY_UPWARD_OFFSETS, hierarchy.upward_offsets);
+			writer.AddArray(section::HIERARCHY_UPWARD_EDGES, hierarchy.upward_edges);
+			writer.AddArray(section::HIERARCHY_DOWNWARD_OFFSETS, hierarchy.downward_offsets);
+			writer.AddArray(section::HIERARCHY_DOWNWARD_EDGES, hierarchy.downward_edges);
+		}
+
+		return writer.WriteTo(path);
+	}
+
+	void Serialization::LoadMapped(std::shared_ptr<const MappedBase> mapped_base) {
+		const MappedBase& base = *mapped_base;
+		auto settings = std::make_shared<transport_catalogue_proto::Base>();
+		const std::string_view settings_bytes = base.GetBytes(section::SETTINGS);
+		if (!settings->ParseFromArray(settings_bytes.data(), static_cast<int>(settings_bytes.size()))) {
+			throw std::runtime_error("Mapped base settings are corrupted");
+		}
+		ProtoToRouteSettings(settings->route_settings());
+		pending_render_settings_ = [this, settings] {
+			ProtoToRenderSettings(settings->render_settings());
+		};
+
+		// массивы справочника используются прямо в отображении файла; заново создаются только
+		// записи остановок и маршрутов, названия которых ссылаются на блок названий базы
+		if (!base.HasSection(section::NAME_SEED)) {
+			throw std::runtime_error("Mapped base names are not frozen");
+		}
+		transport_catalogue::FrozenCatalogue catalogue;
+		const auto [name_lengths, name_count] = base.GetArray<uint32_t>(section::NAME_LENGTHS);
+		transport_catalogue::PerfectHash::Data index;
+		index.seed = base.GetValue<uint64_t>(section::NAME_SEED);
+		index.pilots = base.GetFrozenArray<uint32_t>(section::NAME_PILOTS);
+		catalogue.names = std::make_shared<transport_catalogue::NamePool>();
+		catalogue.names->Attach(base.GetOwner(), base.GetBytes(section::NAMES), name_lengths, name_count,
+			std::move(index), base.GetFrozenArray<uint32_t>(section::NAME_POSITIONS),
+			base.GetFrozenArray<uint32_t>(section::NAME_SORTED_IDS));
+
+		// LoadStops
+		catalogue.stop_name_ids = base.GetFrozenArray<uint32_t>(section::STOP_NAME_IDS);
+		catalogue.stop_coordinates.latitudes = base.GetFrozenArray<double>(section::STOP_LATITUDES);
+		catalogue.stop_coordinates.longitudes = base.GetFrozenArray<double>(section::STOP_LONGITUDES);
+		catalogue.stop_coordinates.unit_vectors = {base.GetFrozenArray<double>(section::STOP_UNIT_X),
+			base.GetFrozenArray<double>(section::STOP_UNIT_Y), base.GetFrozenArray<double>(section::STOP_UNIT_Z)};
+
+		// LoadRoutes
+		catalogue.route_name_ids = base.GetFrozenArray<uint32_t>(section::ROUTE_NAME_IDS);
+		catalogue.route_types = base.GetFrozenArray<uint8_t>(section::ROUTE_TYPES);
+		catalogue.route_stop_offsets = base.GetFrozenArray<uint32_t>(section::ROUTE_STOP_OFFSETS);
+		catalogue.route_stop_ids = base.GetFrozenArray<uint32_t>(section::ROUTE_STOP_IDS);
+
+		// LoadDistances
+		catalogue.distance_list = base.GetFrozenArray<DistanceBeetweenPairStops>(section::DISTANCES);
+		catalogue.distances = {base.GetFrozenArray<uint32_t>(section::DISTANCE_OFFSETS),
+			base.GetFrozenArray<uint32_t>(section::DISTANCE_NEIGHBOURS),
+			base.GetFrozenArray<uint32_t>(section::DISTANCE_VALUES)};
+		catalogue.route_forward_distances = base.GetFrozenArray<uint64_t>(section::ROUTE_FORWARD_DISTANCES);
+		catalogue.route_backward_distances = base.GetFrozenArray<uint64_t>(section::ROUTE_BACKWARD_DISTANCES);
+
+		// LoadRouteInfos
+		const auto [mapped_route_infos, route_info_count] = base.GetArray<MappedRouteInfo>(section::ROUTE_INFOS);
+		catalogue.route_infos.resize(route_info_count);
+		for (size_t n = 0; n < route_info_count; ++n) {
+			catalogue.route_infos[n].number_of_stops = static_cast<int>(mapped_route_infos[n].stop_count);
+			catalogue.route_infos[n].number_of_unique_stops = static_cast<int>(mapped_route_infos[n].unique_stop_count);
+			catalogue.route_infos[n].route_length = mapped_route_infos[n].route_length;
+			catalogue.route_infos[n].curvature = mapped_route_infos[n].curvature;
+		}
+
+		// LoadStopRoutes
+		catalogue.stop_routes = {base.GetFrozenArray<uint32_t>(section::STOP_ROUTE_OFFSETS),
+			base.GetFrozenArray<uint32_t>(section::STOP_ROUTE_IDS)};
+
+		// LoadStopIndex
+		const MappedGrid mapped_grid = base.GetValue<MappedGrid>(section::STOP_GRID);
+		geo::SpatialIndex::Data& grid = catalogue.stop_grid;
+		grid.min_lat = mapped_grid.min_lat;
+		grid.min_lng = mapped_grid.min_lng;
+		grid.cell_lat = mapped_grid.cell_lat;
+		grid.cell_lng = mapped_grid.cell_lng;
+		grid.rows = mapped_grid.rows;
+		grid.cols = mapped_grid.cols;
+		grid.offsets = base.GetFrozenArray<uint32_t>(section::STOP_GRID_OFFSETS);
+		grid.ids = base.GetFrozenArray<uint32_t>(section::STOP_GRID_IDS);
+		catalogue.stop_grid_points = {base.GetFrozenArray<double>(section::STOP_GRID_X),
+			base.GetFrozenArray<double>(section::STOP_GRID_Y), base.GetFrozenArray<double>(section::STOP_GRID_Z)};
+
+		transport_catalogue_.Attach(std::move(catalogue));
+
+		// разделы графа и маршрутизатора не читаются до первого запроса Route
+		pending_router_ = [this, mapped_base] {
+			LoadMappedRouter(*mapped_base);
+		};
+	}
+
+	void Serialization::LoadMappedRouter(const MappedBase& base) {
+		// граф, таблица маршрутов и иерархия используются прямо в отображении файла
+		transport_router::Graph graph(base.GetValue<uint64_t>(section::GRAPH_VERTEX_COUNT),
+			base.GetFrozenArray<graph::Edge<double>>(section::GRAPH_EDGES),
+			base.GetFrozenArray<graph::EdgeId>(section::GRAPH_OFFSETS));
+
+		const RoutingSettings& routing_settings = transport_router_.GetRoutingSettings();
+		if (base.HasSection(section::ROUTES_TABLE) && routing_settings.router_engine == RouterEngine::ALL_PAIRS) {
+			const MappedRoutesTable mapped_table = base.GetValue<MappedRoutesTable>(section::ROUTES_TABLE);
+			const bool compact = routing_settings.routes_table == RoutesTableFormat::COMPACT;
+			if ((mapped_table.compact == 1) != compact) {
+				throw std::runtime_error("Mapped base routes table does not match routing settings");
+			}
+			const std::string_view memory_bytes = base.GetBytes(section::ROUTES_TABLE_MEMORY);
+			graph::TableMemory memory(base.GetOwner(), memory_bytes.data(), memory_bytes.size());
+			if (compact) {
+				transport_router_.SetGraph(std::move(graph),
+					graph::CompactRoutesTable(mapped_table.vertex_count, std::move(memory)));
+			} else {
+				transport_router_.SetGraph(std::move(graph),
+					graph::Router<double>::WideRoutesTable(mapped_table.vertex_count, std::move(memory)));
+			}
+		} else if (base.HasSection(section::HIERARCHY_SHORTCUTS)
+			&& routing_settings.router_engine == RouterEngine::CONTRACTION_HIERARCHY) {
+			transport_router::TransportRouter::Hierarchy hierarchy;
+			hierarchy.shortcuts = base.GetFrozenArray<decltype(hierarchy.shortcuts)::value_type>(
+				section::HIERARCHY_SHORTCUTS);
+			hierarchy.upward_offsets = base.GetFrozenArray<size_t>(section::HIERARCHY_UPWARD_OFFSETS);
+			hierarchy.upward_edges = base.GetFrozenArray<graph::EdgeId>(section::HIERARCHY_UPWARD_EDGES);
+			hierarchy.downward_offsets = base.GetFrozenArray<size_t>(section::HIERARCHY_DOWNWARD_OFFSETS);
+			hierarchy.downward_edges = base.GetFrozenArray<graph::EdgeId>(section::HIERARCHY_DOWNWARD_EDGES);
+			transport_router_.SetGraph(std::move(graph), std::move(hierarchy));
+		} else {
+			transport_router_.SetGraph(std::move(graph));
+		}
+	}
+
+	// SharedImage ----------------------------------------------------------------
+
+	void Serialization::LoadSharedImage() {
+		if (AttachSharedImage()) {
+			return;
+		}
+		{
+			// образ собирает один обработчик: остальные ждут блокировку и затем подключаются
+			// к уже собранному образу, а не собирают и не переименовывают свой
+			Path lock_path = serialization_settings_.shared_image;
+			lock_path += ".lock";
+			const FileLock lock(lock_path);
+			if (AttachSharedImage()) {
+				return;
+			}
+			PublishSharedImage();
+			if (AttachSharedImage()) {
+				return;
+			}
+		}
+		// образ не удалось записать: обработчик работает с собственной копией базы
+		LoadBase();
+	}
+
+	bool Serialization::AttachSharedImage() {
+		MappedSource source;
+		if (!IsMappedBase(serialization_settings_.shared_image)
+			|| !GetSourceStamp(serialization_settings_.file_name, source)) {
+			return false;
+		}
+		try {
+			auto image = std::make_shared<const MappedBase>(serialization_settings_.shared_image,
+				serialization_settings_.verify_checksums);
+			if (!image->HasSection(section::SOURCE)) {
+				return false;
+			}
+			const MappedSource image_source = image->GetValue<MappedSource>(section::SOURCE);
+			if (image_source.file_size != source.file_size || image_source.modified != source.modified) {
+				return false;
+			}
+			// образ в памяти, поэтому он проверяется сразу целиком: повреждённый образ
+			// пересобирается, пока справочник не начал заполняться
+			image->VerifySections();
+			LoadMapped(std::move(image));
+		} catch (const std::runtime_error&) {
+			// повреждённый образ пересобирается
+			return false;
+		}
+		return true;
+	}
+
+	void Serialization::PublishSharedImage() {
+		transport_catalogue::TransportCatalogue catalogue;
+		renderer::MapRenderer map_renderer;
+		transport_router::TransportRouter router(catalogue);
+		Serialization base(catalogue, map_renderer, router);
+		SerializationSettings settings = serialization_settings_;
+		settings.shared_image.clear();
+		base.SetSettings(std::move(settings));
+		base.LoadBase();
+		base.LoadRenderSettings();
+		base.LoadRouter();
+
+		// образ появляется под своим именем целиком: читатели не увидят недописанный файл
+		Path temporary = serialization_settings_.shared_image;
+		temporary += ".tmp" + std::to_string(std::random_device{}());
+		std::error_code error;
+		if (base.SaveMapped(temporary, true)) {
+			std::filesystem::rename(temporary, serialization_settings_.shared_image, error);
+		}
+		std::filesystem::remove(temporary, error);
+	}
+
     // TransportCatalogue ---------------------------------------------------------
 
 	transport_catalogue_proto::TransportCatalogue Serialization::TransportCatalogueToProto() {
 
 		transport_catalogue_proto::TransportCatalogue proto_date;
-        
-		// SaveStops
-		for (const auto& [stop_name, stop_date] : transport_catalogue_.GetAllStops()) {
+
+		// SaveNames
+		const transport_catalogue::NamePool& names = transport_catalogue_.GetNames();
+		std::string* proto_names = proto_date.mutable_names();
+		for (uint32_t name_id = 0; name_id < names.Size(); ++name_id) {
+			proto_names->append(names.Get(name_id));
+			proto_date.add_name_lengths(static_cast<uint32_t>(names.Get(name_id).size()));
+		}
+
+		if (names.IsFrozen()) {
+			const transport_catalogue::PerfectHash::Data& index = names.GetIndex().GetData();
+			proto_date.mutable_name_index()->set_seed(index.seed);
+			proto_date.mutable_name_index()->mutable_pilots()->Add(index.pilots.begin(), index.pilots.end());
+			proto_date.mutable_name_index()->mutable_sorted_ids()->Add(names.GetSortedIds().begin(),
+				names.GetSortedIds().end());
+		}
+
+		// SaveStops (по порядку id)
+		for (uint32_t id = 0; id < transport_catalogue_.GetNumberStops(); ++id) {
+			const Stop* stop_date = transport_catalogue_.GetStopById(id);
 			transport_catalogue_proto::Coordinates proto_coordinate;
 			proto_coordinate.set_lat(stop_date->coordinate.lat);
 			proto_coordinate.set_lng(stop_date->coordinate.lng);
 			
 			transport_catalogue_proto::Stop* proto_stop = proto_date.add_stops();
-			proto_stop->set_name(stop_date->name);
+			proto_stop->set_name_id(stop_date->name_id);
             *proto_stop->mutable_coordinate() = std::move(proto_coordinate);
 			proto_stop->set_id(stop_date->id);
 		}
 
-        // SaveRoutes
-		for (const auto& [route_name, route_date] : transport_catalogue_.GetAllRoutes()) {
+        // SaveRoutes (по порядку id)
+		for (uint32_t id = 0; id < transport_catalogue_.GetNumberRoutes(); ++id) {
+			const Route* route_date = transport_catalogue_.GetRouteById(id);
 			transport_catalogue_proto::Route* proto_route = proto_date.add_routes();
 
-            proto_route->set_name(route_date->name);
+			proto_route->set_name_id(route_date->name_id);
 			proto_route->set_is_circular(route_date->route_type==RouteType::CIRCLE);
-			for (const auto& stop : route_date->stops) {
-				proto_route->add_id_stops(stop->id);
-			}
+			proto_route->mutable_id_stops()->Add(route_date->stops.GetIds(),
+				route_date->stops.GetIds() + route_date->stops.size());
 			proto_route->set_id(route_date->id);
 		}
 
-        // SaveDistances
-		for (const auto& pair_stops_distance : transport_catalogue_.GetAllDistanceBeetweenPairStops()) {
-			transport_catalogue_proto::Distance* proto_distance = proto_date.add_distances();
-			proto_distance->set_id_stop_from(pair_stops_distance.id_stop_from);
-			proto_distance->set_id_stop_to(pair_stops_distance.id_stop_to);
-			proto_distance->set_distance(pair_stops_distance.distance);
+        // расстояния дописываются к сообщению потоком в SaveTo
+
+		// SaveRouteInfos
+		for (const RouteInfo& route_info : transport_catalogue_.GetRouteInfos()) {
+			transport_catalogue_proto::RouteInfo* proto_route_info = proto_date.add_route_infos();
+			proto_route_info->set_stop_count(route_info.number_of_stops);
+			proto_route_info->set_unique_stop_count(route_info.number_of_unique_stops);
+			proto_route_info->set_route_length(route_info.route_length);
+			proto_route_info->set_curvature(route_info.curvature);
 		}
 
+		// SaveStopRoutes
+		const transport_catalogue::StopRoutes& stop_routes = transport_catalogue_.GetStopRoutes();
+		proto_date.mutable_stop_routes()->mutable_offsets()->Add(stop_routes.offsets.begin(), stop_routes.offsets.end());
+		proto_date.mutable_stop_routes()->mutable_route_ids()->Add(stop_routes.route_ids.begin(), stop_routes.route_ids.end());
+
+		// SaveStopIndex
+		const geo::SpatialIndex::Data& stop_index = transport_catalogue_.GetStopIndex().GetData();
+		transport_catalogue_proto::StopIndex* proto_stop_index = proto_date.mutable_stop_index();
+		proto_stop_index->set_min_lat(stop_index.min_lat);
+		proto_stop_index->set_min_lng(stop_index.min_lng);
+		proto_stop_index->set_cell_lat(stop_index.cell_lat);
+		proto_stop_index->set_cell_lng(stop_index.cell_lng);
+		proto_stop_index->set_rows(stop_index.rows);
+		proto_stop_index->set_cols(stop_index.cols);
+		proto_stop_index->mutable_offsets()->Add(stop_index.offsets.begin(), stop_index.offsets.end());
+		proto_stop_index->mutable_stop_ids()->Add(stop_index.ids.begin(), stop_index.ids.end());
+
 		return proto_date;
 	}
 
 	void Serialization::ProtoToTransportCatalogue(
 		transport_catalogue_proto::TransportCatalogue& proto_catalogue) {
 
+        // LoadNames: весь блок названий копируется в пул одним выделением памяти,
+		// поиск по названиям сразу идёт по сохранённой хеш-функции
+		const bool has_names = proto_catalogue.name_lengths_size() > 0;
+		if (has_names) {
+			std::optional<transport_catalogue::PerfectHash::Data> index;
+			std::vector<uint32_t> sorted_ids;
+			if (proto_catalogue.has_name_index()) {
+				index.emplace();
+				index->seed = proto_catalogue.name_index().seed();
+				index->pilots = std::vector<uint32_t>(proto_catalogue.name_index().pilots().begin(),
+					proto_catalogue.name_index().pilots().end());
+				sorted_ids.assign(proto_catalogue.name_index().sorted_ids().begin(),
+					proto_catalogue.name_index().sorted_ids().end());
+			}
+			transport_catalogue_.LoadNames(proto_catalogue.names(),
+				{proto_catalogue.name_lengths().begin(), proto_catalogue.name_lengths().end()}, std::move(index),
+				std::move(sorted_ids));
+		}
+		const transport_catalogue::NamePool& names = transport_catalogue_.GetNames();
+		const auto name_of = [has_names, &names](const auto& proto_object) -> std::string_view {
+			return has_names ? names.Get(proto_object.name_id()) : std::string_view(proto_object.name());
+		};
+
         // LoadStops
 		for (int n = 0; n < proto_catalogue.stops_size(); ++n) {
 			const geo::Coordinates coordinate = 
 			  { proto_catalogue.stops(n).coordinate().lat(),
 				proto_catalogue.stops(n).coordinate().lng() };
-			transport_catalogue_.AddStop(proto_catalogue.stops(n).name(), coordinate, proto_catalogue.stops(n).id());
+			transport_catalogue_.AddStop(name_of(proto_catalogue.stops(n)), coordinate, proto_catalogue.stops(n).id());
 		}
 
         // LoadRoutes
 		for (int n = 0; n < proto_catalogue.routes_size(); ++n) {
 			const transport_catalogue_proto::Route& proto_route = proto_catalogue.routes(n);
 
-			std::string_view name = proto_route.name();
+			std::string_view name = name_of(proto_route);
 			RouteType type = (proto_route.is_circular()) ? RouteType::CIRCLE : RouteType::LINEAR;
-			std::vector<std::string_view> stops;
-
-			for (int m = 0; m < proto_route.id_stops_size(); ++m) {
-				stops.push_back(transport_catalogue_.GetStopNameById(proto_route.id_stops(m)));
-			}
-			transport_catalogue_.AddRoute(name, type, stops, proto_catalogue.routes(n).id());
+			const std::vector<uint32_t> stop_ids(proto_route.id_stops().begin(), proto_route.id_stops().end());
+			transport_catalogue_.AddRoute(name, type, stop_ids, proto_catalogue.routes(n).id());
 		}
 
         // LoadDistances
 		for (int n = 0; n < proto_catalogue.distances_size(); ++n) {
 			transport_catalogue_.SetStopDistance(
-				transport_catalogue_.GetStopByName(transport_catalogue_.GetStopNameById(proto_catalogue.distances(n).id_stop_from())),
-				transport_catalogue_.GetStopByName(transport_catalogue_.GetStopNameById(proto_catalogue.distances(n).id_stop_to())),
+				transport_catalogue_.GetStopById(proto_catalogue.distances(n).id_stop_from()),
+				transport_catalogue_.GetStopById(proto_catalogue.distances(n).id_stop_to()),
 			    proto_catalogue.distances(n).distance() );
 		}
+
+		transport_catalogue_.FreezeDistances();
+		if (!has_names) {
+			transport_catalogue_.FreezeNames();
+		}
+
+		// LoadRouteInfos; для базы без таблицы она рассчитывается заново
+		if (proto_catalogue.route_infos_size() == proto_catalogue.routes_size()) {
+			std::vector<RouteInfo> route_infos(proto_catalogue.route_infos_size());
+			for (int n = 0; n < proto_catalogue.route_infos_size(); ++n) {
+				const auto& proto_route_info = proto_catalogue.route_infos(n);
+				route_infos[n].number_of_stops = static_cast<int>(proto_route_info.stop_count());
+				route_infos[n].number_of_unique_stops = static_cast<int>(proto_route_info.unique_stop_count());
+				route_infos[n].route_length = proto_route_info.route_length();
+				route_infos[n].curvature = proto_route_info.curvature();
+			}
+			transport_catalogue_.SetRouteInfos(std::move(route_infos));
+		} else {
+			transport_catalogue_.BuildRouteInfos();
+		}
+
+		// LoadStopRoutes; для базы без списков они строятся заново
+		if (proto_catalogue.has_stop_routes()) {
+			const transport_catalogue_proto::StopRoutes& proto_stop_routes = proto_catalogue.stop_routes();
+			transport_catalogue_.SetStopRoutes({
+				std::vector<uint32_t>(proto_stop_routes.offsets().begin(), proto_stop_routes.offsets().end()),
+				std::vector<uint32_t>(proto_stop_routes.route_ids().begin(), proto_stop_routes.route_ids().end())});
+		} else {
+			transport_catalogue_.BuildStopRoutes();
+		}
+
+		// LoadStopIndex; для базы без сетки она строится заново
+		if (proto_catalogue.has_stop_index()) {
+			const transport_catalogue_proto::StopIndex& proto_stop_index = proto_catalogue.stop_index();
+			geo::SpatialIndex::Data stop_index;
+			stop_index.min_lat = proto_stop_index.min_lat();
+			stop_index.min_lng = proto_stop_index.min_lng();
+			stop_index.cell_lat = proto_stop_index.cell_lat();
+			stop_index.cell_lng = proto_stop_index.cell_lng();
+			stop_index.rows = proto_stop_index.rows();
+			stop_index.cols = proto_stop_index.cols();
+			stop_index.offsets = std::vector<uint32_t>(proto_stop_index.offsets().begin(),
+				proto_stop_index.offsets().end());
+			stop_index.ids = std::vector<uint32_t>(proto_stop_index.stop_ids().begin(),
+				proto_stop_index.stop_ids().end());
+			transport_catalogue_.SetStopIndex(std::move(stop_index));
+		} else {
+			transport_catalogue_.BuildStopIndex();
+		}
 	}
 
 	// MapRenderer ----------------------------------------------------------------
@@ -226,57 +1079,554 @@ namespace serialization {
 
 	    proto_settings.set_bus_wait_time(route_settings.bus_wait_time);
 	    proto_settings.set_bus_velocity(route_settings.bus_velocity);
+	    switch (route_settings.router_engine) {
+		    case RouterEngine::ALL_PAIRS:
+			    proto_settings.set_router_engine(transport_router_proto::ALL_PAIRS);
+			    break;
+		    case RouterEngine::DIJKSTRA:
+			    proto_settings.set_router_engine(transport_router_proto::DIJKSTRA);
+			    break;
+		    case RouterEngine::ASTAR:
+			    proto_settings.set_router_engine(transport_router_proto::ASTAR);
+			    break;
+		    case RouterEngine::BIDIRECTIONAL_ASTAR:
+			    proto_settings.set_router_engine(transport_router_proto::BIDIRECTIONAL_ASTAR);
+			    break;
+		    case RouterEngine::CONTRACTION_HIERARCHY:
+			    proto_settings.set_router_engine(transport_router_proto::CONTRACTION_HIERARCHY);
+			    break;
+	    }
+	    proto_settings.set_route_cache_size(static_cast<uint32_t>(route_settings.route_cache_size));
+	    proto_settings.set_all_pairs_build(route_settings.all_pairs_build == AllPairsBuild::DIJKSTRA
+		    ? transport_router_proto::ALL_PAIRS_DIJKSTRA : transport_router_proto::FLOYD_WARSHALL);
+	    proto_settings.set_router_threads(static_cast<uint32_t>(route_settings.router_threads));
+	    proto_settings.set_routes_table(route_settings.routes_table == RoutesTableFormat::COMPACT
+		    ? transport_router_proto::COMPACT : transport_router_proto::WIDE);
+	    proto_settings.set_graph_model(route_settings.graph_model == GraphModel::STOP_BUS_STATES
+		    ? transport_router_proto::STOP_BUS_STATES : transport_router_proto::STOP_PAIRS);
 
 	    return proto_settings;
     }
 
-    transport_router_proto::Graph Serialization::GraphToProto() {
-	    transport_router_proto::Graph proto_graph;
-	    std::shared_ptr<transport_router::Graph> orig_graph = transport_router_.GetGraph();
-        
-        auto& edges = orig_graph.get()->GetEdges();
-        for (size_t n = 0; n < edges.size(); ++n) {
-            transport_router_proto::Edge* s_edge = proto_graph.add_edges();
-            s_edge->set_from(edges.at(n).from);
-            s_edge->set_to(edges.at(n).to);
-            s_edge->set_weight(edges.at(n).weight);
-			s_edge->set_span_count(edges.at(n).span_count);
-			s_edge->set_bus_name_id(edges.at(n).bus_name_id);
-        }
-		auto& incidence_lists = orig_graph.get()->GetIncidenceLists();
-        for (size_t n = 0; n < incidence_lists.size(); ++n) {
-            transport_router_proto::IncidenceList* new_list = proto_graph.add_incidence_lists();
-            for (size_t m = 0; m < incidence_lists.at(n).size(); ++m) {
-                new_list->add_edge_id(incidence_lists.at(n).at(m));;
-            }
-        }
-		
-        return proto_graph;
+    template <typename Sink>
+    void Serialization::WriteGraph(Sink& sink) {
+	    using ProtoGraph = transport_router_proto::Graph;
+	    using ProtoEdge = transport_router_proto::Edge;
+	    const transport_router::Graph& graph = transport_router_.GetGraph();
+
+	    for (const graph::Edge<double>& edge : graph.GetEdges()) {
+		    WriteNestedField(sink, ProtoGraph::kEdgesFieldNumber, [&edge](auto& proto_edge) {
+			    WriteVarintField(proto_edge, ProtoEdge::kFromFieldNumber, edge.from);
+			    WriteVarintField(proto_edge, ProtoEdge::kToFieldNumber, edge.to);
+			    WriteDoubleField(proto_edge, ProtoEdge::kWeightFieldNumber, edge.weight);
+			    WriteVarintField(proto_edge, ProtoEdge::kSpanCountFieldNumber, edge.span_count);
+			    WriteVarintField(proto_edge, ProtoEdge::kBusNameIdFieldNumber, edge.bus_name_id);
+		    });
+	    }
+	    WriteVarintField(sink, ProtoGraph::kVertexCountFieldNumber, graph.GetVertexCount());
+    }
+
+    template <typename Sink>
+    void Serialization::WriteRoutesInternalData(Sink& sink) {
+	    using ProtoData = transport_router_proto::RoutesInternalData;
+	    std::visit([&sink](const auto& table) {
+		    using Table = std::decay_t<decltype(table)>;
+		    const size_t vertex_count = table.GetVertexCount();
+
+		    WriteVarintField(sink, ProtoData::kVertexCountFieldNumber, vertex_count);
+		    if constexpr (std::is_same_v<Table, graph::CompactRoutesTable>) {
+			    WritePackedField<VarintEncoding>(sink, ProtoData::kWeightTicksFieldNumber, vertex_count, vertex_count,
+				    [&table](size_t from, size_t to) {
+					    const uint32_t weight = table.GetWeightsRow(from)[to];
+					    return weight == Table::NO_ROUTE ? NO_ROUTE_TICKS : weight;
+				    });
+		    } else {
+			    WritePackedField<DoubleEncoding>(sink, ProtoData::kWeightFieldNumber, vertex_count, vertex_count,
+				    [&table](size_t from, size_t to) {
+					    return table.HasRoute(from, to) ? table.GetWeightsRow(from)[to] : -1.0;
+				    });
+		    }
+		    WritePackedField<VarintEncoding>(sink, ProtoData::kPrevEdgeFieldNumber, vertex_count, vertex_count,
+			    [&table](size_t from, size_t to) {
+				    const auto prev_edge = table.GetPrevEdgesRow(from)[to];
+				    return prev_edge == Table::NO_EDGE ? 0 : uint64_t{prev_edge} + 1;
+			    });
+	    }, transport_router_.GetRoutesInternalData());
+    }
+
+    template <typename Sink>
+    void Serialization::WriteHierarchy(Sink& sink) {
+	    using ProtoHierarchy = transport_router_proto::ContractionHierarchy;
+	    using ProtoShortcut = transport_router_proto::Shortcut;
+	    const transport_router::TransportRouter::Hierarchy& hierarchy = transport_router_.GetHierarchy();
+
+	    for (const auto& shortcut : hierarchy.shortcuts) {
+		    WriteNestedField(sink, ProtoHierarchy::kShortcutsFieldNumber, [&shortcut](auto& proto_shortcut) {
+			    WriteVarintField(proto_shortcut, ProtoShortcut::kFromFieldNumber, shortcut.from);
+			    WriteVarintField(proto_shortcut, ProtoShortcut::kToFieldNumber, shortcut.to);
+			    WriteDoubleField(proto_shortcut, ProtoShortcut::kWeightFieldNumber, shortcut.weight);
+			    WriteVarintField(proto_shortcut, ProtoShortcut::kFirstFieldNumber, shortcut.first);
+			    WriteVarintField(proto_shortcut, ProtoShortcut::kSecondFieldNumber, shortcut.second);
+		    });
+	    }
+	    WritePackedVarints(sink, ProtoHierarchy::kUpwardOffsetsFieldNumber, hierarchy.upward_offsets);
+	    WritePackedVarints(sink, ProtoHierarchy::kUpwardEdgesFieldNumber, hierarchy.upward_edges);
+	    WritePackedVarints(sink, ProtoHierarchy::kDownwardOffsetsFieldNumber, hierarchy.downward_offsets);
+	    WritePackedVarints(sink, ProtoHierarchy::kDownwardEdgesFieldNumber, hierarchy.downward_edges);
     }
 
     void Serialization::ProtoToRouteSettings(const transport_router_proto::RouterSettings& proto_settings) {
-        transport_router_.SetRoutingSettings(proto_settings.bus_wait_time(),
-		    proto_settings.bus_velocity());
-		transport_router_.InitializeGraph();
+	    RoutingSettings settings;
+	    settings.bus_wait_time = proto_settings.bus_wait_time();
+	    settings.bus_velocity = proto_settings.bus_velocity();
+	    switch (proto_settings.router_engine()) {
+		    case transport_router_proto::DIJKSTRA:
+			    settings.router_engine = RouterEngine::DIJKSTRA;
+			    break;
+		    case transport_router_proto::ASTAR:
+			    settings.router_engine = RouterEngine::ASTAR;
+			    break;
+		    case transport_router_proto::BIDIRECTIONAL_ASTAR:
+			    settings.router_engine = RouterEngine::BIDIRECTIONAL_ASTAR;
+			    break;
+		    case transport_router_proto::CONTRACTION_HIERARCHY:
+			    settings.router_engine = RouterEngine::CONTRACTION_HIERARCHY;
+			    break;
+		    default:
+			    settings.router_engine = RouterEngine::ALL_PAIRS;
+			    break;
+	    }
+	    settings.route_cache_size = proto_settings.route_cache_size();
+	    settings.all_pairs_build = proto_settings.all_pairs_build() == transport_router_proto::ALL_PAIRS_DIJKSTRA
+		    ? AllPairsBuild::DIJKSTRA : AllPairsBuild::FLOYD_WARSHALL;
+	    settings.router_threads = proto_settings.router_threads();
+	    settings.routes_table = proto_settings.routes_table() == transport_router_proto::COMPACT
+		    ? RoutesTableFormat::COMPACT : RoutesTableFormat::WIDE;
+	    settings.graph_model = proto_settings.graph_model() == transport_router_proto::STOP_BUS_STATES
+		    ? GraphModel::STOP_BUS_STATES : GraphModel::STOP_PAIRS;
+        transport_router_.SetRoutingSettings(settings);
     }
 
-    void Serialization::ProtoToGraph(const transport_router_proto::Graph& proto_graph) {
-	
-        std::vector<graph::Edge<double>> edges(proto_graph.edges_size());
-        std::vector<std::vector<graph::EdgeId>> incidence_lists(proto_graph.incidence_lists_size());
-        for (size_t n = 0; n < edges.size(); ++n) {
-            const transport_router_proto::Edge& e = proto_graph.edges(n);
-            edges[n] = { static_cast<size_t>(e.from()), static_cast<size_t>(e.to()), e.weight(),
-			e.span_count(), e.bus_name_id()};
-        }
-        for (size_t n = 0; n < incidence_lists.size(); ++n) {
-            const transport_router_proto::IncidenceList& v = proto_graph.incidence_lists(n);
-            incidence_lists[n].reserve(v.edge_id_size());
-            for (const auto& id : v.edge_id()) {
-                incidence_lists[n].push_back(id);
-            }
-        }
-        transport_router_.SetGraph(graph::DirectedWeightedGraph<double>(edges, incidence_lists));
+    transport_router::Graph Serialization::ReadGraph(std::istream& input, const FieldSpan& span) {
+	    using ProtoGraph = transport_router_proto::Graph;
+	    std::vector<graph::Edge<double>> edges;
+	    uint64_t vertex_count = 0;
+	    transport_router_proto::Edge proto_edge;
+
+	    const bool parsed = ReadSpan(input, span, [&](CodedInputStream& coded) {
+		    while (const uint32_t tag = coded.ReadTag()) {
+			    switch (WireFormat::GetTagFieldNumber(tag)) {
+				    case ProtoGraph::kEdgesFieldNumber:
+					    if (!ReadMessage(coded, tag, proto_edge)) {
+						    return false;
+					    }
+					    edges.push_back({proto_edge.from(), proto_edge.to(), proto_edge.weight(), proto_edge.span_count(),
+						    proto_edge.bus_name_id()});
+					    break;
+				    case ProtoGraph::kVertexCountFieldNumber:
+					    if (!ReadVarints(coded, tag, [&vertex_count](uint64_t value) { vertex_count = value; })) {
+						    return false;
+					    }
+					    break;
+				    default:
+					    if (!WireFormat::SkipField(&coded, tag)) {
+						    return false;
+					    }
+			    }
+		    }
+		    return true;
+	    });
+	    if (!parsed) {
+		    throw std::invalid_argument("Corrupted graph");
+	    }
+        // рёбра сохранены уже упорядоченными по начальной вершине, смещения восстанавливаются за O(V + E)
+        return transport_router::Graph(vertex_count, std::move(edges));
+    }
+
+    transport_router::TransportRouter::RoutesInternalData Serialization::ReadRoutesInternalData(
+		std::istream& input, const FieldSpan& span) {
+	    if (transport_router_.GetRoutingSettings().routes_table == RoutesTableFormat::COMPACT) {
+		    return ReadRoutesTable<graph::CompactRoutesTable>(input, span);
+	    }
+	    return ReadRoutesTable<graph::Router<double>::WideRoutesTable>(input, span);
+    }
+
+    // значения таблицы приходят по строкам; таблица создаётся по vertex_count, которое
+    // записано первым полем
+    template <typename Table>
+    Table Serialization::ReadRoutesTable(std::istream& input, const FieldSpan& span) {
+	    using ProtoData = transport_router_proto::RoutesInternalData;
+	    constexpr bool compact = std::is_same_v<Table, graph::CompactRoutesTable>;
+	    std::optional<Table> table;
+	    // позиции следующего веса и следующего ребра
+	    TableCursor weight_cursor;
+	    TableCursor edge_cursor;
+
+	    const auto on_weight = [&table, &weight_cursor](auto weight) {
+		    if (!weight_cursor.Reserve(table)) {
+			    return;
+		    }
+		    if constexpr (compact) {
+			    if (weight != NO_ROUTE_TICKS) {
+				    table->GetWeightsRow(weight_cursor.row)[weight_cursor.column] = static_cast<uint32_t>(weight);
+			    }
+		    } else {
+			    if (weight >= 0.0) {
+				    table->GetWeightsRow(weight_cursor.row)[weight_cursor.column] = weight;
+			    }
+		    }
+		    weight_cursor.Next(table->GetVertexCount());
+	    };
+	    const auto on_edge = [&table, &edge_cursor](uint64_t prev_edge) {
+		    if (!edge_cursor.Reserve(table)) {
+			    return;
+		    }
+		    if (prev_edge != 0) {
+			    table->GetPrevEdgesRow(edge_cursor.row)[edge_cursor.column] =
+				    static_cast<typename Table::EdgeValue>(prev_edge - 1);
+		    }
+		    edge_cursor.Next(table->GetVertexCount());
+	    };
+
+	    const bool parsed = ReadSpan(input, span, [&](CodedInputStream& coded) {
+		    while (const uint32_t tag = coded.ReadTag()) {
+			    const int field = WireFormat::GetTagFieldNumber(tag);
+			    bool read = true;
+			    if (field == ProtoData::kVertexCountFieldNumber && !table) {
+				    read = ReadVarints(coded, tag, [&table](uint64_t value) { table.emplace(value); });
+			    } else if (field == (compact ? ProtoData::kWeightTicksFieldNumber : ProtoData::kWeightFieldNumber)) {
+				    if constexpr (compact) {
+					    read = ReadVarints(coded, tag, on_weight);
+				    } else {
+					    read = ReadDoubles(coded, tag, on_weight);
+				    }
+			    } else if (field == ProtoData::kPrevEdgeFieldNumber) {
+				    read = ReadVarints(coded, tag, on_edge);
+			    } else {
+				    read = WireFormat::SkipField(&coded, tag);
+			    }
+			    if (!read) {
+				    return false;
+			    }
+		    }
+		    return true;
+	    });
+
+	    if (!parsed || !table || !weight_cursor.Complete(*table) || !edge_cursor.Complete(*table)) {
+		    throw std::invalid_argument("Corrupted routes internal data");
+	    }
+	    return std::move(*table);
+    }
+
+    transport_router::TransportRouter::Hierarchy Serialization::ReadHierarchy(std::istream& input, const FieldSpan& span) {
+	    using ProtoHierarchy = transport_router_proto::ContractionHierarchy;
+	    transport_router::TransportRouter::Hierarchy hierarchy;
+	    transport_router_proto::Shortcut proto_shortcut;
+
+	    const auto append_to = [](auto& values) {
+		    return [&values](uint64_t value) {
+			    values.push_back(static_cast<typename std::decay_t<decltype(values)>::value_type>(value));
+		    };
+	    };
+	    const bool parsed = ReadSpan(input, span, [&](CodedInputStream& coded) {
+		    while (const uint32_t tag = coded.ReadTag()) {
+			    bool read = true;
+			    switch (WireFormat::GetTagFieldNumber(tag)) {
+				    case ProtoHierarchy::kShortcutsFieldNumber:
+					    read = ReadMessage(coded, tag, proto_shortcut);
+					    if (read) {
+						    hierarchy.shortcuts.push_back({proto_shortcut.from(), proto_shortcut.to(), proto_shortcut.weight(),
+							    proto_shortcut.first(), proto_shortcut.second()});
+					    }
+					    break;
+				    case ProtoHierarchy::kUpwardOffsetsFieldNumber:
+					    read = ReadVarints(coded, tag, append_to(hierarchy.upward_offsets));
+					    break;
+				    case ProtoHierarchy::kUpwardEdgesFieldNumber:
+					    read = ReadVarints(coded, tag, append_to(hierarchy.upward_edges));
+					    break;
+				    case ProtoHierarchy::kDownwardOffsetsFieldNumber:
+					    read = ReadVarints(coded, tag, append_to(hierarchy.downward_offsets));
+					    break;
+				    case ProtoHierarchy::kDownwardEdgesFieldNumber:
+					    read = ReadVarints(coded, tag, append_to(hierarchy.downward_edges));
+					    break;
+				    default:
+					    read = WireFormat::SkipField(&coded, tag);
+			    }
+			    if (!read) {
+				    return false;
+			    }
+		    }
+		    return true;
+	    });
+	    if (!parsed) {
+		    throw std::invalid_argument("Corrupted contraction hierarchy");
+	    }
+	    return hierarchy;
+    }
+
+    // CompactCatalogue -----------------------------------------------------------
+
+    void Serialization::ReadCompactCatalogue(std::istream& input, const FieldSpan& span) {
+	    using Proto = transport_catalogue_proto::CompactCatalogue;
+	    std::vector<uint32_t> prefix_lengths;
+	    std::vector<uint32_t> suffix_lengths;
+	    std::string suffixes;
+	    std::vector<uint32_t> sorted_ids;
+	    std::vector<int64_t> stop_name_id_deltas;
+	    uint64_t coordinate_digits = 0;
+	    std::vector<int64_t> latitude_deltas;
+	    std::vector<int64_t> longitude_deltas;
+	    std::vector<double> latitudes;
+	    std::vector<double> longitudes;
+	    std::vector<int64_t> route_name_id_deltas;
+	    std::vector<bool> route_circular;
+	    std::vector<uint32_t> route_stop_counts;
+	    std::vector<int64_t> route_stop_deltas;
+	    std::vector<int64_t> distance_from_deltas;
+	    std::vector<int64_t> distance_to_deltas;
+	    std::vector<uint64_t> distances;
+
+	    const auto append_to = [](auto& values) {
+		    return [&values](auto value) {
+			    values.push_back(static_cast<typename std::decay_t<decltype(values)>::value_type>(value));
+		    };
+	    };
+	    const bool parsed = ReadSpan(input, span, [&](CodedInputStream& coded) {
+		    while (const uint32_t tag = coded.ReadTag()) {
+			    bool read = true;
+			    switch (WireFormat::GetTagFieldNumber(tag)) {
+				    case Proto::kNamePrefixLengthsFieldNumber:
+					    read = ReadVarints(coded, tag, append_to(prefix_lengths));
+					    break;
+				    case Proto::kNameSuffixLengthsFieldNumber:
+					    read = ReadVarints(coded, tag, append_to(suffix_lengths));
+					    break;
+				    case Proto::kNameSuffixesFieldNumber:
+					    read = ReadBytes(coded, tag, suffixes);
+					    break;
+				    case Proto::kSortedIdsFieldNumber:
+					    read = ReadVarints(coded, tag, append_to(sorted_ids));
+					    break;
+				    case Proto::kStopNameIdDeltasFieldNumber:
+					    read = ReadSints(coded, tag, append_to(stop_name_id_deltas));
+					    break;
+				    case Proto::kCoordinateDigitsFieldNumber:
+					    read = ReadVarints(coded, tag, [&coordinate_digits](uint64_t value) { coordinate_digits = value; });
+					    break;
+				    case Proto::kLatitudeDeltasFieldNumber:
+					    read = ReadSints(coded, tag, append_to(latitude_deltas));
+					    break;
+				    case Proto::kLongitudeDeltasFieldNumber:
+					    read = ReadSints(coded, tag, append_to(longitude_deltas));
+					    break;
+				    case Proto::kLatitudesFieldNumber:
+					    read = ReadDoubles(coded, tag, append_to(latitudes));
+					    break;
+				    case Proto::kLongitudesFieldNumber:
+					    read = ReadDoubles(coded, tag, append_to(longitudes));
+					    break;
+				    case Proto::kRouteNameIdDeltasFieldNumber:
+					    read = ReadSints(coded, tag, append_to(route_name_id_deltas));
+					    break;
+				    case Proto::kRouteCircularFieldNumber:
+					    read = ReadVarints(coded, tag, append_to(route_circular));
+					    break;
+				    case Proto::kRouteStopCountsFieldNumber:
+					    read = ReadVarints(coded, tag, append_to(route_stop_counts));
+					    break;
+				    case Proto::kRouteStopDeltasFieldNumber:
+					    read = ReadSints(coded, tag, append_to(route_stop_deltas));
+					    break;
+				    case Proto::kDistanceFromDeltasFieldNumber:
+					    read = ReadSints(coded, tag, append_to(distance_from_deltas));
+					    break;
+				    case Proto::kDistanceToDeltasFieldNumber:
+					    read = ReadSints(coded, tag, append_to(distance_to_deltas));
+					    break;
+				    case Proto::kDistancesFieldNumber:
+					    read = ReadVarints(coded, tag, append_to(distances));
+					    break;
+				    default:
+					    read = WireFormat::SkipField(&coded, tag);
+			    }
+			    if (!read) {
+				    return false;
+			    }
+		    }
+		    return true;
+	    });
+	    const auto check = [](bool condition) {
+		    if (!condition) {
+			    throw std::invalid_argument("Corrupted catalogue");
+		    }
+	    };
+	    check(parsed);
+
+	    // названия: k-е по возрастанию - начало предыдущего и своё окончание
+	    const size_t name_count = sorted_ids.size();
+	    check(prefix_lengths.size() == name_count && suffix_lengths.size() == name_count);
+	    std::vector<std::string> names(name_count);
+	    std::string previous;
+	    size_t suffix_offset = 0;
+	    for (size_t n = 0; n < name_count; ++n) {
+		    check(sorted_ids[n] < name_count && prefix_lengths[n] <= previous.size()
+			    && suffix_lengths[n] <= suffixes.size() - suffix_offset);
+		    previous.resize(prefix_lengths[n]);
+		    previous.append(suffixes, suffix_offset, suffix_lengths[n]);
+		    suffix_offset += suffix_lengths[n];
+		    names[sorted_ids[n]] = previous;
+	    }
+	    check(suffix_offset == suffixes.size());
+	    std::string block;
+	    std::vector<uint32_t> lengths;
+	    block.reserve(suffixes.size());
+	    lengths.reserve(name_count);
+	    for (const std::string& name : names) {
+		    block += name;
+		    lengths.push_back(static_cast<uint32_t>(name.size()));
+	    }
+	    // хеш-функция строится заново; порядок названий проверяется, повтор id - ошибка
+	    transport_catalogue_.LoadNames(block, lengths, std::nullopt, std::move(sorted_ids));
+	    const transport_catalogue::NamePool& pool = transport_catalogue_.GetNames();
+	    const auto name_of = [&pool, &check](int64_t name_id) {
+		    check(name_id >= 0 && static_cast<uint64_t>(name_id) < pool.Size());
+		    return pool.Get(static_cast<uint32_t>(name_id));
+	    };
+
+	    // остановки
+	    const size_t stop_count = stop_name_id_deltas.size();
+	    const bool fixed_point = latitudes.empty() && longitudes.empty();
+	    if (fixed_point) {
+		    check(latitude_deltas.size() == stop_count && longitude_deltas.size() == stop_count
+			    && coordinate_digits <= MAX_COORDINATE_DIGITS);
+	    } else {
+		    check(latitudes.size() == stop_count && longitudes.size() == stop_count);
+	    }
+	    const double scale = PowerOfTen(static_cast<uint32_t>(coordinate_digits));
+	    int64_t name_id = 0;
+	    int64_t latitude = 0;
+	    int64_t longitude = 0;
+	    for (size_t id = 0; id < stop_count; ++id) {
+		    name_id += stop_name_id_deltas[id];
+		    geo::Coordinates coordinate;
+		    if (fixed_point) {
+			    latitude += latitude_deltas[id];
+			    longitude += longitude_deltas[id];
+			    coordinate = {static_cast<double>(latitude) / scale, static_cast<double>(longitude) / scale};
+		    } else {
+			    coordinate = {latitudes[id], longitudes[id]};
+		    }
+		    transport_catalogue_.AddStop(name_of(name_id), coordinate, static_cast<uint32_t>(id));
+	    }
+	    const auto stop_of = [this, stop_count, &check](int64_t stop_id) {
+		    check(stop_id >= 0 && static_cast<uint64_t>(stop_id) < stop_count);
+		    return transport_catalogue_.GetStopById(static_cast<uint32_t>(stop_id));
+	    };
+
+	    // маршруты
+	    const size_t route_count = route_name_id_deltas.size();
+	    check(route_circular.size() == route_count && route_stop_counts.size() == route_count);
+	    name_id = 0;
+	    size_t position = 0;
+	    std::vector<uint32_t> stop_ids;
+	    for (size_t id = 0; id < route_count; ++id) {
+		    name_id += route_name_id_deltas[id];
+		    check(route_stop_counts[id] <= route_stop_deltas.size() - position);
+		    stop_ids.clear();
+		    int64_t stop_id = 0;
+		    for (uint32_t n = 0; n < route_stop_counts[id]; ++n) {
+			    stop_id += route_stop_deltas[position++];
+			    stop_ids.push_back(stop_of(stop_id)->id);
+		    }
+		    transport_catalogue_.AddRoute(name_of(name_id), route_circular[id] ? RouteType::CIRCLE : RouteType::LINEAR,
+			    stop_ids, static_cast<uint16_t>(id));
+	    }
+	    check(position == route_stop_deltas.size());
+
+	    // расстояния
+	    check(distance_to_deltas.size() == distance_from_deltas.size() && distances.size() == distance_from_deltas.size());
+	    int64_t from = 0;
+	    int64_t to = 0;
+	    for (size_t n = 0; n < distances.size(); ++n) {
+		    const int64_t previous_from = from;
+		    from += distance_from_deltas[n];
+		    to = (n > 0 && from == previous_from ? to : 0) + distance_to_deltas[n];
+		    transport_catalogue_.SetStopDistance(stop_of(from), stop_of(to), distances[n]);
+	    }
+
+	    // производные структуры не хранятся: они строятся так же, как при make_base
+	    transport_catalogue_.FreezeDistances();
+	    transport_catalogue_.BuildRouteInfos();
+	    transport_catalogue_.BuildStopRoutes();
+	    transport_catalogue_.BuildStopIndex();
+    }
+
+    transport_router::Graph Serialization::ReadCompactGraph(std::istream& input, const FieldSpan& span) {
+	    using Proto = transport_router_proto::CompactGraph;
+	    uint64_t vertex_count = 0;
+	    std::vector<uint32_t> out_degrees;
+	    std::vector<int64_t> to_deltas;
+	    std::vector<double> weights;
+	    std::vector<uint32_t> span_counts;
+	    std::vector<uint32_t> bus_name_ids;
+
+	    const auto append_to = [](auto& values) {
+		    return [&values](auto value) {
+			    values.push_back(static_cast<typename std::decay_t<decltype(values)>::value_type>(value));
+		    };
+	    };
+	    const bool parsed = ReadSpan(input, span, [&](CodedInputStream& coded) {
+		    while (const uint32_t tag = coded.ReadTag()) {
+			    bool read = true;
+			    switch (WireFormat::GetTagFieldNumber(tag)) {
+				    case Proto::kVertexCountFieldNumber:
+					    read = ReadVarints(coded, tag, [&vertex_count](uint64_t value) { vertex_count = value; });
+					    break;
+				    case Proto::kOutDegreesFieldNumber:
+					    read = ReadVarints(coded, tag, append_to(out_degrees));
+					    break;
+				    case Proto::kToDeltasFieldNumber:
+					    read = ReadSints(coded, tag, append_to(to_deltas));
+					    break;
+				    case Proto::kWeightsFieldNumber:
+					    read = ReadDoubles(coded, tag, append_to(weights));
+					    break;
+				    case Proto::kSpanCountsFieldNumber:
+					    read = ReadVarints(coded, tag, append_to(span_counts));
+					    break;
+				    case Proto::kBusNameIdsFieldNumber:
+					    read = ReadVarints(coded, tag, append_to(bus_name_ids));
+					    break;
+				    default:
+					    read = WireFormat::SkipField(&coded, tag);
+			    }
+			    if (!read) {
+				    return false;
+			    }
+		    }
+		    return true;
+	    });
+	    const size_t edge_count = to_deltas.size();
+	    if (!parsed || out_degrees.size() != vertex_count || weights.size() != edge_count
+		    || span_counts.size() != edge_count || bus_name_ids.size() != edge_count
+		    || std::accumulate(out_degrees.begin(), out_degrees.end(), uint64_t{0}) != edge_count) {
+		    throw std::invalid_argument("Corrupted graph");
+	    }
+	    std::vector<graph::Edge<double>> edges;
+	    edges.reserve(edge_count);
+	    for (uint32_t from = 0; from < out_degrees.size(); ++from) {
+		    for (uint32_t n = 0; n < out_degrees[from]; ++n) {
+			    const size_t edge = edges.size();
+			    const int64_t to = static_cast<int64_t>(from) + to_deltas[edge];
+			    if (to < 0 || static_cast<uint64_t>(to) >= vertex_count) {
+				    throw std::invalid_argument("Corrupted graph");
+			    }
+			    edges.push_back({from, static_cast<uint32_t>(to), weights[edge], span_counts[edge], bus_name_ids[edge]});
+		    }
+	    }
+	    return transport_router::Graph(vertex_count, std::move(edges));
     }
 
-} // namespace serialization
\ No newline at end of file
+} // namespace serialization
@@ -1,7 +1,18 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
 #include <fstream> 
+#include <functional>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <random>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <variant>
 
 #include "transport_catalogue.h"
 #include "transport_catalogue.pb.h"
@@ -10,14 +21,31 @@
 #include "svg.pb.h"
 #include "transport_router.h"
 #include "graph.pb.h"
+#include "mapped_base.h"
+#include "proto_stream.h"
 
 
 namespace serialization {
 
     using Path = std::filesystem::path;
 
+	// значение weight_ticks в RoutesInternalData для отсутствующего маршрута
+	constexpr uint32_t NO_ROUTE_TICKS = 0xFFFFFFFF;
+
+	// формат файла базы
+	enum class BaseFormat {
+		PROTOBUF, // сообщение transport_catalogue_proto::Base
+		MAPPED,   // разделы для отображения в память (mapped_base.h)
+		COMPACT,  // Base с CompactCatalogue и CompactGraph: наименьший файл
+	};
+
 	struct SerializationSettings {
 		Path file_name; // Название файла. Именно в этот файл нужно сохранить сериализованную базу.
+		BaseFormat format = BaseFormat::PROTOBUF; // формат при сохранении; при загрузке определяется по файлу
+		bool verify_checksums = true; // проверять ли контрольные суммы разделов отображаемой базы
+		// образ базы для обработчиков, работающих одновременно (файл в tmpfs, например /dev/shm);
+		// пустой путь - каждый обработчик загружает базу сам
+		Path shared_image;
 	};
 
 	class Serialization {
@@ -25,15 +53,26 @@ namespace serialization {
 		Serialization() = default;
 		Serialization(transport_catalogue::TransportCatalogue& transport_catalogue, 
 	        renderer::MapRenderer& map_renderer, transport_router::TransportRouter& transport_router);
+		// записывает базу в файл из настроек; std::runtime_error, если файл не записан
 		void SaveTo();
+		// загружает справочник и настройки маршрутов; настройки отрисовки и маршрутизатор
+		// загружаются при первом запросе, которому они нужны (LoadRenderSettings, LoadRouter)
 		void LoadFrom();
 		void SetSettings(SerializationSettings serialization_settings);
 
+		// загружают отложенные разделы базы; повторный вызов ничего не делает
+		void LoadRouter();
+		void LoadRenderSettings();
+
 	private:
 		SerializationSettings serialization_settings_;
 		transport_catalogue::TransportCatalogue& transport_catalogue_;
 		renderer::MapRenderer& map_renderer_;
 		transport_router::TransportRouter& transport_router_;
+
+		// загрузка отложенных разделов; держит разобранную или отображённую базу
+		std::function<void()> pending_router_;
+		std::function<void()> pending_render_settings_;
         
 		// TransportCatalogue ---------------------------------------------------------
 		
@@ -52,10 +91,55 @@ namespace serialization {
         // TransportRouter ------------------------------------------------------------
 
 		transport_router_proto::RouterSettings RouteSettingsToProto(const RoutingSettings& route_settings);
-	    transport_router_proto::Graph GraphToProto();
-
 	    void ProtoToRouteSettings(const transport_router_proto::RouterSettings& proto_settings);
-	    void ProtoToGraph(const transport_router_proto::Graph& proto_graph);
+
+		// граф, таблица маршрутов и иерархия пишутся в приёмник Sink (proto_stream.h) и читаются
+		// из поля базы потоком, без промежуточного сообщения
+		template <typename Sink>
+		void WriteGraph(Sink& sink);
+		template <typename Sink>
+		void WriteRoutesInternalData(Sink& sink);
+		template <typename Sink>
+		void WriteHierarchy(Sink& sink);
+
+	    transport_router::Graph ReadGraph(std::istream& input, const FieldSpan& span);
+	    transport_router::TransportRouter::RoutesInternalData ReadRoutesInternalData(
+			std::istream& input, const FieldSpan& span);
+		template <typename Table>
+		Table ReadRoutesTable(std::istream& input, const FieldSpan& span);
+	    transport_router::TransportRouter::Hierarchy ReadHierarchy(std::istream& input, const FieldSpan& span);
+
+		// CompactCatalogue -----------------------------------------------------------
+
+		// разбирает справочник базы "compact" и строит производные структуры заново
+		void ReadCompactCatalogue(std::istream& input, const FieldSpan& span);
+		transport_router::Graph ReadCompactGraph(std::istream& input, const FieldSpan& span);
+
+		// MappedBase -----------------------------------------------------------------
+
+		// сохраняет базу в формате для отображения в память; false, если файл не записан.
+		// stamp_source - записать размер и время изменения файла базы для образа в общей памяти
+		bool SaveMapped(const Path& path, bool stamp_source);
+		// загружает базу, отображённую в память: массивы справочника, граф, таблица маршрутов и
+		// иерархия используются на месте, создаются только записи остановок и маршрутов
+		void LoadMapped(std::shared_ptr<const MappedBase> mapped_base);
+		void LoadMappedRouter(const MappedBase& base);
+
+		// загружает базу из file_name в любом формате
+		void LoadBase();
+
+		// SharedImage ----------------------------------------------------------------
+
+		// подключается к образу базы или, если его нет или он устарел, собирает и публикует его.
+		// Сборка идёт под исключительной блокировкой файла shared_image + ".lock": получив её,
+		// обработчик сначала проверяет образ ещё раз - его мог собрать предыдущий владелец
+		void LoadSharedImage();
+		// загружает образ, если он собран из текущего файла базы; false - образа нет, он
+		// устарел или повреждён, справочник при этом не изменяется
+		bool AttachSharedImage();
+		// собирает образ во временных справочнике и маршрутизаторе и переименовывает его на место
+		// образа (под блокировкой из LoadSharedImage)
+		void PublishSharedImage();
 
 	}; // class Serialization
 
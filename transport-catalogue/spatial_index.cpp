@@ -0,0 +1,240 @@
+#include "spatial_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace geo {
+
+namespace {
+
+constexpr double DEGREES_TO_RADIANS = M_PI / 180.0;
+// среднее число точек в ячейке
+constexpr double POINTS_PER_CELL = 2.0;
+// сколько расстояний считать за один вызов ComputeDistances
+constexpr size_t BATCH_SIZE = 64;
+// половина длины большого круга: дальше на сфере точек нет
+const double MAX_DISTANCE = M_PI * Earth_radius;
+
+bool ByDistance(const SpatialIndex::Found& lhs, const SpatialIndex::Found& rhs) {
+    return lhs.distance < rhs.distance || (lhs.distance == rhs.distance && lhs.id < rhs.id);
+}
+
+}  // namespace
+
+SpatialIndex::SpatialIndex(const ranges::FrozenArray<double>& latitudes,
+                           const ranges::FrozenArray<double>& longitudes) {
+    if (latitudes.size() != longitudes.size()) {
+        throw std::invalid_argument("Latitudes and longitudes should match");
+    }
+    const size_t count = latitudes.size();
+    if (count == 0) {
+        return;
+    }
+    const auto [min_lat, max_lat] = std::minmax_element(latitudes.begin(), latitudes.end());
+    const auto [min_lng, max_lng] = std::minmax_element(longitudes.begin(), longitudes.end());
+    data_.min_lat = *min_lat;
+    data_.min_lng = *min_lng;
+    const double lat_span = *max_lat - *min_lat;
+    const double lng_span = *max_lng - *min_lng;
+
+    // ячейки примерно квадратные на местности: долгота сжимается к полюсам
+    const double lng_scale = std::max(std::cos((*min_lat + *max_lat) / 2.0 * DEGREES_TO_RADIANS), 1e-6);
+    const double height = std::max(lat_span, 1e-9);
+    const double width = std::max(lng_span * lng_scale, 1e-9);
+    const double cells = std::max(1.0, static_cast<double>(count) / POINTS_PER_CELL);
+    const double side = std::sqrt(height * width / cells);
+    data_.rows = static_cast<uint32_t>(std::clamp(std::ceil(height / side), 1.0, cells));
+    data_.cols = static_cast<uint32_t>(std::clamp(std::ceil(width / side), 1.0, cells));
+    // границы максимальных координат попадают в последнюю ячейку
+    data_.cell_lat = lat_span > 0.0 ? lat_span / data_.rows : 1.0;
+    data_.cell_lng = lng_span > 0.0 ? lng_span / data_.cols : 1.0;
+
+    // раскладка точек по ячейкам подсчётом
+    const size_t cell_count = static_cast<size_t>(data_.rows) * data_.cols;
+    std::vector<uint32_t> cells_of_points(count);
+    std::vector<uint32_t> offsets(cell_count + 1, 0);
+    for (size_t id = 0; id < count; ++id) {
+        cells_of_points[id] = GetRow(latitudes[id]) * data_.cols + GetCol(longitudes[id]);
+        ++offsets[cells_of_points[id] + 1];
+    }
+    for (size_t cell = 0; cell < cell_count; ++cell) {
+        offsets[cell + 1] += offsets[cell];
+    }
+    std::vector<uint32_t> ids(count);
+    std::vector<uint32_t> positions(offsets.begin(), offsets.end() - 1);
+    for (size_t id = 0; id < count; ++id) {
+        ids[positions[cells_of_points[id]]++] = static_cast<uint32_t>(id);
+    }
+    data_.offsets = std::move(offsets);
+    data_.ids = std::move(ids);
+    FillCoordinates(latitudes, longitudes);
+}
+
+SpatialIndex::SpatialIndex(Data data, const ranges::FrozenArray<double>& latitudes,
+                           const ranges::FrozenArray<double>& longitudes)
+    : data_(std::move(data)) {
+    if (latitudes.size() != longitudes.size() || data_.ids.size() != latitudes.size()) {
+        throw std::invalid_argument("Spatial index does not match points");
+    }
+    if (data_.ids.empty()) {
+        data_ = {};
+        return;
+    }
+    CheckData(data_.ids.size());
+    const size_t cell_count = static_cast<size_t>(data_.rows) * data_.cols;
+    // каждая точка должна лежать в своей ячейке ровно один раз
+    std::vector<bool> seen(data_.ids.size(), false);
+    for (size_t cell = 0; cell < cell_count; ++cell) {
+        for (uint32_t n = data_.offsets[cell]; n < data_.offsets[cell + 1]; ++n) {
+            const uint32_t id = data_.ids[n];
+            if (id >= seen.size() || seen[id]
+                    || GetRow(latitudes[id]) * data_.cols + GetCol(longitudes[id]) != cell) {
+                throw std::invalid_argument("Spatial index does not match points");
+            }
+            seen[id] = true;
+        }
+    }
+    FillCoordinates(latitudes, longitudes);
+}
+
+SpatialIndex::SpatialIndex(Data data, UnitVectors points)
+    : data_(std::move(data))
+    , points_(std::move(points)) {
+    const size_t count = data_.ids.size();
+    if (points_.x.size() != count || points_.y.size() != count || points_.z.size() != count) {
+        throw std::invalid_argument("Spatial index does not match points");
+    }
+    if (count == 0) {
+        data_ = {};
+        return;
+    }
+    CheckData(count);
+    if (!std::all_of(data_.ids.begin(), data_.ids.end(), [count](uint32_t id) { return id < count; })) {
+        throw std::invalid_argument("Spatial index does not match points");
+    }
+}
+
+void SpatialIndex::CheckData(size_t count) const {
+    const size_t cell_count = static_cast<size_t>(data_.rows) * data_.cols;
+    if (cell_count == 0 || data_.offsets.size() != cell_count + 1 || data_.offsets.front() != 0
+            || data_.offsets.back() != count || !(data_.cell_lat > 0.0) || !(data_.cell_lng > 0.0)
+            || !std::is_sorted(data_.offsets.begin(), data_.offsets.end())) {
+        throw std::invalid_argument("Spatial index is malformed");
+    }
+}
+
+std::vector<SpatialIndex::Found> SpatialIndex::Find(Coordinates center, std::optional<double> radius,
+                                                    std::optional<size_t> count) const {
+    std::vector<Found> result;
+    if (Empty() || (count && *count == 0) || (radius && *radius < 0.0)) {
+        return result;
+    }
+    const double max_radius = radius ? std::min(*radius, MAX_DISTANCE) : MAX_DISTANCE;
+    if (!count) {
+        FindInRadius(center, max_radius, result);
+    } else {
+        // начинаем с круга, в котором при равномерной плотности ожидается count точек,
+        // и удваиваем радиус, пока точек не хватит
+        const double cell_height = data_.cell_lat * DEGREES_TO_RADIANS * Earth_radius;
+        double search_radius = std::min(max_radius,
+            cell_height * std::sqrt(static_cast<double>(*count) / POINTS_PER_CELL));
+        while (true) {
+            result.clear();
+            FindInRadius(center, search_radius, result);
+            if (result.size() >= *count || search_radius >= max_radius) {
+                break;
+            }
+            search_radius = std::min(max_radius, std::max(search_radius * 2.0, 1.0));
+        }
+    }
+    if (count && result.size() > *count) {
+        std::partial_sort(result.begin(), result.begin() + *count, result.end(), ByDistance);
+        result.resize(*count);
+    } else {
+        std::sort(result.begin(), result.end(), ByDistance);
+    }
+    return result;
+}
+
+bool SpatialIndex::Empty() const {
+    return data_.ids.empty();
+}
+
+const SpatialIndex::Data& SpatialIndex::GetData() const {
+    return data_;
+}
+
+const UnitVectors& SpatialIndex::GetPoints() const {
+    return points_;
+}
+
+void SpatialIndex::FillCoordinates(const ranges::FrozenArray<double>& latitudes,
+                                   const ranges::FrozenArray<double>& longitudes) {
+    points_ = {};
+    for (const uint32_t id : data_.ids) {
+        points_.Add({latitudes[id], longitudes[id]});
+    }
+}
+
+uint32_t SpatialIndex::GetRow(double lat) const {
+    const double row = std::floor((lat - data_.min_lat) / data_.cell_lat);
+    return static_cast<uint32_t>(std::clamp(row, 0.0, static_cast<double>(data_.rows - 1)));
+}
+
+uint32_t SpatialIndex::GetCol(double lng) const {
+    const double col = std::floor((lng - data_.min_lng) / data_.cell_lng);
+    return static_cast<uint32_t>(std::clamp(col, 0.0, static_cast<double>(data_.cols - 1)));
+}
+
+void SpatialIndex::FindInRadius(Coordinates center, double radius, std::vector<Found>& result) const {
+    // угловой радиус круга; по широте точки круга отстоят от центра не больше чем на него
+    const double angle = radius / Earth_radius;
+    const double lat_delta = angle / DEGREES_TO_RADIANS;
+    const uint32_t row_begin = GetRow(center.lat - lat_delta);
+    const uint32_t row_end = GetRow(center.lat + lat_delta);
+
+    // по долготе - не больше asin(sin(angle) / cos(lat)), если круг не накрывает полюс
+    const double lat = center.lat * DEGREES_TO_RADIANS;
+    if (angle >= M_PI / 2.0 - std::abs(lat) || std::sin(angle) >= std::cos(lat)) {
+        ScanCells(center, radius, row_begin, row_end, -360.0, 360.0, result);
+        return;
+    }
+    const double lng_delta = std::asin(std::sin(angle) / std::cos(lat)) / DEGREES_TO_RADIANS;
+    ScanCells(center, radius, row_begin, row_end, center.lng - lng_delta, center.lng + lng_delta, result);
+    // часть круга за линией перемены дат
+    if (center.lng - lng_delta < -180.0) {
+        ScanCells(center, radius, row_begin, row_end, center.lng - lng_delta + 360.0, 180.0, result);
+    }
+    if (center.lng + lng_delta > 180.0) {
+        ScanCells(center, radius, row_begin, row_end, -180.0, center.lng + lng_delta - 360.0, result);
+    }
+}
+
+void SpatialIndex::ScanCells(Coordinates center, double radius, uint32_t row_begin, uint32_t row_end,
+                             double lng_begin, double lng_end, std::vector<Found>& result) const {
+    const double max_lng = data_.min_lng + data_.cell_lng * data_.cols;
+    if (lng_end < data_.min_lng || lng_begin > max_lng) {
+        return;
+    }
+    const uint32_t col_begin = GetCol(lng_begin);
+    const uint32_t col_end = GetCol(lng_end);
+    const UnitVector point = ToUnitVector(center);
+    double distances[BATCH_SIZE];
+    for (uint32_t row = row_begin; row <= row_end; ++row) {
+        // ячейки строки с col_begin по col_end лежат в памяти подряд
+        const uint32_t begin = data_.offsets[row * data_.cols + col_begin];
+        const uint32_t end = data_.offsets[row * data_.cols + col_end + 1];
+        for (uint32_t batch = begin; batch < end; batch += BATCH_SIZE) {
+            const size_t size = std::min<size_t>(BATCH_SIZE, end - batch);
+            ComputeDistances(point, points_, batch, size, distances);
+            for (size_t n = 0; n < size; ++n) {
+                if (distances[n] <= radius) {
+                    result.push_back({data_.ids[batch + n], distances[n]});
+                }
+            }
+        }
+    }
+}
+
+}  // namespace geo
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "geo.h"
+
+namespace geo {
+
+// SpatialIndex - равномерная сетка по широте и долготе над точками с id 0..n-1. Размер ячейки
+// подбирается так, чтобы на ячейку приходилось около двух точек, а ячейки были близки
+// к квадратным на местности. Точки хранятся по ячейкам подряд вместе с координатами, поэтому
+// запрос просматривает несколько непрерывных отрезков памяти. Поиск в радиусе перебирает ячейки
+// в полосе широт и долгот, которая по сферической геометрии гарантированно накрывает круг,
+// поиск ближайших - поиск в радиусе с удвоением радиуса. Расстояния до точек подряд идущих ячеек
+// считаются пакетно по единичным векторам.
+class SpatialIndex {
+public:
+    // сетка без координат точек - то, что сохраняется в базе
+    struct Data {
+        double min_lat = 0.0;
+        double min_lng = 0.0;
+        double cell_lat = 1.0; // размер ячейки в градусах
+        double cell_lng = 1.0;
+        uint32_t rows = 0;
+        uint32_t cols = 0;
+        // точки ячейки cell = row * cols + col - ids[offsets[cell]..offsets[cell + 1])
+        ranges::FrozenArray<uint32_t> offsets;
+        ranges::FrozenArray<uint32_t> ids;
+    };
+
+    // найденная точка и расстояние до неё в метрах
+    struct Found {
+        uint32_t id;
+        double distance;
+    };
+
+    SpatialIndex() = default;
+    // строит сетку над точками (latitudes[id], longitudes[id])
+    SpatialIndex(const ranges::FrozenArray<double>& latitudes, const ranges::FrozenArray<double>& longitudes);
+    // восстанавливает сетку, построенную для тех же точек
+    SpatialIndex(Data data, const ranges::FrozenArray<double>& latitudes,
+                 const ranges::FrozenArray<double>& longitudes);
+    // восстанавливает сетку вместе с единичными векторами точек в порядке data.ids (GetPoints);
+    // массивы используются на месте, принадлежность точек ячейкам не проверяется
+    SpatialIndex(Data data, UnitVectors points);
+
+    // точки не дальше radius метров от center, не больше count ближайших (без ограничения
+    // при nullopt); результат упорядочен по расстоянию, при равенстве - по id
+    std::vector<Found> Find(Coordinates center, std::optional<double> radius, std::optional<size_t> count) const;
+
+    bool Empty() const;
+    const Data& GetData() const;
+    // единичные векторы точек в порядке GetData().ids
+    const UnitVectors& GetPoints() const;
+
+private:
+    Data data_;
+    // единичные векторы точек в порядке data_.ids
+    UnitVectors points_;
+
+    void FillCoordinates(const ranges::FrozenArray<double>& latitudes, const ranges::FrozenArray<double>& longitudes);
+    // проверяет размеры и смещения ячеек data_ для count точек
+    void CheckData(size_t count) const;
+    uint32_t GetRow(double lat) const;
+    uint32_t GetCol(double lng) const;
+    // точки не дальше radius метров, без упорядочивания
+    void FindInRadius(Coordinates center, double radius, std::vector<Found>& result) const;
+    // точки ячеек строк [row_begin, row_end] и столбцов, покрывающих долготы [lng_begin, lng_end]
+    void ScanCells(Coordinates center, double radius, uint32_t row_begin, uint32_t row_end,
+                   double lng_begin, double lng_end, std::vector<Found>& result) const;
+};
+
+}  // namespace geo
@@ -0,0 +1,126 @@
+// Проверки расстояний по единичным векторам: пакетный расчёт против поштучного, поштучный
+// против расчёта по координатам, и поиск ближайших остановок по сетке против перебора.
+
+#include "../geo.h"
+#include "../spatial_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+void Check(bool condition, const std::string& message) {
+    if (!condition) {
+        throw std::runtime_error(message);
+    }
+}
+
+bool IsClose(double lhs, double rhs, double absolute) {
+    return std::abs(lhs - rhs) <= absolute + 1e-9 * std::max(std::abs(lhs), std::abs(rhs));
+}
+
+// точки вокруг Москвы: расстояния от метров до сотни километров
+std::vector<geo::Coordinates> MakeRandomPoints(size_t count, std::mt19937& random) {
+    std::uniform_real_distribution<double> lat(55.3, 56.1);
+    std::uniform_real_distribution<double> lng(37.1, 38.1);
+    std::vector<geo::Coordinates> points;
+    for (size_t n = 0; n < count; ++n) {
+        points.push_back({lat(random), lng(random)});
+    }
+    return points;
+}
+
+void CheckDistances(const std::vector<geo::Coordinates>& points) {
+    geo::UnitVectors vectors;
+    for (const geo::Coordinates& point : points) {
+        vectors.Add(point);
+    }
+    std::vector<double> distances(points.size());
+    for (size_t from = 0; from < points.size(); ++from) {
+        Check(geo::ComputeDistance(vectors[from], vectors[from]) == 0.0, "distance to the same point is not 0");
+        geo::ComputeDistances(vectors[from], vectors, 0, points.size(), distances.data());
+        for (size_t to = 0; to < points.size(); ++to) {
+            const double single = geo::ComputeDistance(vectors[from], vectors[to]);
+            Check(IsClose(distances[to], single, 1e-6), "batch distance differs from the single one");
+            // acos в расчёте по координатам теряет точность на малых углах (до 0.1 м), а для
+            // совпадающих точек может дать NaN
+            Check(to == from || IsClose(single, geo::ComputeDistance(points[from], points[to]), 0.5),
+                  "unit vector distance differs from the coordinate one");
+        }
+    }
+
+    std::vector<uint32_t> path;
+    double length = 0.0;
+    for (uint32_t id = 0; id < points.size(); id += 3) {
+        if (!path.empty()) {
+            length += geo::ComputeDistance(vectors[path.back()], vectors[id]);
+        }
+        path.push_back(id);
+    }
+    Check(IsClose(geo::ComputePathLength(vectors, path.data(), path.size()), length, 1e-6),
+          "path length differs from the sum of distances");
+}
+
+void CheckSpatialIndex(const std::vector<geo::Coordinates>& points, std::mt19937& random) {
+    std::vector<double> latitudes;
+    std::vector<double> longitudes;
+    for (const geo::Coordinates& point : points) {
+        latitudes.push_back(point.lat);
+        longitudes.push_back(point.lng);
+    }
+    const geo::SpatialIndex index(latitudes, longitudes);
+
+    std::uniform_real_distribution<double> radius(0.0, 20000.0);
+    std::uniform_int_distribution<size_t> count(0, 12);
+    for (const geo::Coordinates& center : MakeRandomPoints(50, random)) {
+        for (int variant = 0; variant < 3; ++variant) {
+            // радиус, число или оба ограничения
+            const std::optional<double> max_radius = variant != 1 ? std::optional<double>(radius(random)) : std::nullopt;
+            const std::optional<size_t> max_count = variant != 0 ? std::optional<size_t>(count(random)) : std::nullopt;
+
+            std::vector<geo::SpatialIndex::Found> expected;
+            for (uint32_t id = 0; id < points.size(); ++id) {
+                const double distance = geo::ComputeDistance(geo::ToUnitVector(center), geo::ToUnitVector(points[id]));
+                if (!max_radius || distance <= *max_radius) {
+                    expected.push_back({id, distance});
+                }
+            }
+            std::sort(expected.begin(), expected.end(), [](const auto& lhs, const auto& rhs) {
+                return lhs.distance < rhs.distance || (lhs.distance == rhs.distance && lhs.id < rhs.id);
+            });
+            if (max_count && expected.size() > *max_count) {
+                expected.resize(*max_count);
+            }
+
+            const std::vector<geo::SpatialIndex::Found> found = index.Find(center, max_radius, max_count);
+            Check(found.size() == expected.size(), "nearby stops count differs from the full scan");
+            for (size_t n = 0; n < found.size(); ++n) {
+                Check(found[n].id == expected[n].id && IsClose(found[n].distance, expected[n].distance, 1e-6),
+                      "nearby stops differ from the full scan");
+            }
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    try {
+        std::mt19937 random(42);
+        const std::vector<geo::Coordinates> points = MakeRandomPoints(300, random);
+        CheckDistances(points);
+        CheckSpatialIndex(points, random);
+    } catch (const std::exception& e) {
+        std::cerr << "geo_tests: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "geo_tests: OK" << std::endl;
+    return 0;
+}
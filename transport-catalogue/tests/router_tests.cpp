@@ -0,0 +1,244 @@
+// Проверки маршрутизаторов graph: векторные ядра Флойда-Уоршелла против скалярного цикла,
+// таблицы всех пар, построенные Флойдом-Уоршеллом и поиском Дейкстры, и поиск по запросу
+// (Дейкстра, A*, иерархия сжатия) против таблицы на случайных графах; итератор id рёбер
+// против алгоритмов стандартной библиотеки.
+
+#include "../contraction_hierarchy.h"
+#include "../floyd_warshall.h"
+#include "../graph.h"
+#include "../router.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Graph = graph::DirectedWeightedGraph<double>;
+using RouteInfo = graph::Router<double>::RouteInfo;
+
+void Check(bool condition, const std::string& message) {
+    if (!condition) {
+        throw std::runtime_error(message);
+    }
+}
+
+// веса - целые числа, чтобы суммы не зависели от порядка сложения и веса маршрутов
+// разных алгоритмов можно было сравнивать точно
+Graph MakeRandomGraph(size_t vertex_count, size_t edge_count, std::mt19937& random) {
+    std::uniform_int_distribution<uint32_t> vertex(0, static_cast<uint32_t>(vertex_count - 1));
+    std::uniform_int_distribution<int> weight(0, 100);
+    std::vector<graph::Edge<double>> edges;
+    for (size_t n = 0; n < edge_count; ++n) {
+        edges.push_back({vertex(random), vertex(random), static_cast<double>(weight(random)), 1, 0});
+    }
+    return Graph(vertex_count, std::move(edges));
+}
+
+// маршрут - путь из from в to с заявленным весом
+void CheckRoute(const Graph& graph, const RouteInfo& route, graph::VertexId from, graph::VertexId to,
+                const std::string& name) {
+    double weight = 0.0;
+    graph::VertexId vertex = from;
+    for (const graph::EdgeId edge_id : route.edges) {
+        const auto& edge = graph.GetEdge(edge_id);
+        Check(edge.from == vertex, name + ": route edges are not a path");
+        weight += edge.weight;
+        vertex = edge.to;
+    }
+    Check(vertex == to, name + ": route does not end at the destination");
+    Check(weight == route.weight, name + ": route weight differs from its edges");
+}
+
+// исходящие рёбра вершины - диапазон произвольного доступа
+void CheckEdgeIdIterator(const Graph& graph) {
+    for (graph::VertexId vertex = 0; vertex < graph.GetVertexCount(); ++vertex) {
+        const auto edges = graph.GetIncidentEdges(vertex);
+        const std::vector<graph::EdgeId> ids(edges.begin(), edges.end());
+        const graph::EdgeIdIterator begin = edges.begin();
+        const graph::EdgeIdIterator end = edges.end();
+        Check(end - begin == static_cast<std::ptrdiff_t>(ids.size()) && std::distance(begin, end) == end - begin,
+              "edge id iterator difference differs from the range size");
+        Check(std::equal(ids.begin(), ids.end(), begin, end), "edge id iterator differs from incident edges");
+        for (size_t n = 0; n < ids.size(); ++n) {
+            graph::EdgeIdIterator it = begin;
+            it += static_cast<std::ptrdiff_t>(n);
+            Check(*it == ids[n] && begin[n] == ids[n] && *(begin + n) == ids[n] && *(n + begin) == ids[n]
+                      && *(end - (ids.size() - n)) == ids[n] && begin < end && it >= begin && it < end,
+                  "edge id iterator random access is wrong");
+            Check(*std::lower_bound(begin, end, ids[n]) == ids[n], "lower_bound on edge ids is wrong");
+        }
+        if (!ids.empty()) {
+            graph::EdgeIdIterator it = end;
+            const graph::EdgeIdIterator before = it--;
+            Check(before == end && *it == ids.back() && *std::prev(end) == ids.back(),
+                  "edge id iterator decrement is wrong");
+            const graph::EdgeIdIterator last = it++;
+            Check(it == end && *last == ids.back() && *--it == ids.back(), "edge id iterator increment is wrong");
+        }
+    }
+}
+
+template <typename StoredWeight, typename StoredEdge>
+void CheckRelaxRowKernels(std::mt19937& random) {
+    using Table = graph::RoutesTable<StoredWeight, StoredEdge>;
+    std::uniform_int_distribution<int> value(0, 1000);
+    std::uniform_int_distribution<int> missing(0, 4);
+    const auto random_weight = [&]() {
+        return missing(random) == 0 ? Table::NO_ROUTE : static_cast<StoredWeight>(value(random));
+    };
+    const auto random_edge = [&]() {
+        return missing(random) == 0 ? Table::NO_EDGE : static_cast<StoredEdge>(value(random));
+    };
+
+    for (size_t count = 0; count < 40; ++count) {
+        std::vector<StoredWeight> weights_i(count);
+        std::vector<StoredWeight> weights_k(count);
+        std::vector<StoredEdge> edges_i(count);
+        std::vector<StoredEdge> edges_k(count);
+        for (size_t j = 0; j < count; ++j) {
+            weights_i[j] = random_weight();
+            weights_k[j] = random_weight();
+            edges_i[j] = random_edge();
+            edges_k[j] = random_edge();
+        }
+        const StoredWeight weight_ik = static_cast<StoredWeight>(value(random));
+        const StoredEdge edge_ik = static_cast<StoredEdge>(value(random));
+
+        // скалярный вариант RelaxRowThroughVertex
+        std::vector<StoredWeight> expected_weights = weights_i;
+        std::vector<StoredEdge> expected_edges = edges_i;
+        for (size_t j = 0; j < count; ++j) {
+            const StoredWeight candidate = weight_ik + weights_k[j];
+            if (candidate < expected_weights[j]) {
+                expected_weights[j] = candidate;
+                expected_edges[j] = edges_k[j] != Table::NO_EDGE ? edges_k[j] : edge_ik;
+            }
+        }
+
+        std::vector<StoredWeight> actual_weights = weights_i;
+        std::vector<StoredEdge> actual_edges = edges_i;
+        graph::RelaxRowThroughVertex(actual_weights.data(), actual_edges.data(), weights_k.data(), edges_k.data(),
+                                     weight_ik, edge_ik, count);
+        Check(actual_weights == expected_weights && actual_edges == expected_edges,
+              "RelaxRowThroughVertex differs from the scalar loop, count " + std::to_string(count));
+
+        // ядра каждого набора инструкций, который есть у процессора, отдельно от выбранного
+        const auto check_kernel = [&](auto kernel, const char* isa) {
+            std::vector<StoredWeight> weights = weights_i;
+            std::vector<StoredEdge> edges = edges_i;
+            const size_t done = kernel(weights.data(), edges.data(), weights_k.data(), edges_k.data(),
+                                       weight_ik, edge_ik, Table::NO_EDGE, count);
+            Check(done <= count, std::string(isa) + " kernel went past the row");
+            for (size_t j = 0; j < done; ++j) {
+                Check(weights[j] == expected_weights[j] && edges[j] == expected_edges[j],
+                      std::string(isa) + " kernel differs from the scalar loop, count " + std::to_string(count));
+            }
+        };
+        [[maybe_unused]] const graph::detail::VectorIsa isa = graph::detail::GetVectorIsa();
+#if defined(FLOYD_WARSHALL_AVX2)
+        if (isa == graph::detail::VectorIsa::AVX2) {
+            check_kernel([](auto... args) { return graph::detail::RelaxRowAvx2(args...); }, "AVX2");
+        }
+#endif
+#if defined(FLOYD_WARSHALL_SSE41)
+        if (isa != graph::detail::VectorIsa::SCALAR) {
+            check_kernel([](auto... args) { return graph::detail::RelaxRowSse41(args...); }, "SSE4.1");
+        }
+#endif
+    }
+}
+
+// таблицы одного формата, построенные разными алгоритмами, дают маршруты одного веса
+void CheckAllPairs(const Graph& graph, graph::RoutesTableLayout layout, const std::string& name) {
+    graph::AllPairsSettings floyd_warshall;
+    floyd_warshall.layout = layout;
+    floyd_warshall.thread_count = 3;
+    graph::AllPairsSettings dijkstra = floyd_warshall;
+    dijkstra.algorithm = graph::AllPairsAlgorithm::DIJKSTRA;
+
+    const graph::Router<double> floyd_warshall_router(graph, floyd_warshall);
+    const graph::Router<double> dijkstra_router(graph, dijkstra);
+    const graph::DijkstraRouter<double> on_demand_router(graph, 8);
+    const graph::AStarRouter<double> astar_router(graph, [](graph::VertexId, graph::VertexId) { return 0.0; }, false);
+    const graph::AStarRouter<double> bidirectional_router(graph, [](graph::VertexId, graph::VertexId) { return 0.0; },
+                                                          true);
+    const graph::ContractionHierarchyRouter<double> hierarchy_router(graph);
+
+    for (graph::VertexId from = 0; from < graph.GetVertexCount(); ++from) {
+        for (graph::VertexId to = 0; to < graph.GetVertexCount(); ++to) {
+            const std::optional<RouteInfo> expected = floyd_warshall_router.BuildRoute(from, to);
+            const auto check = [&](const std::optional<RouteInfo>& route, const std::string& engine) {
+                const std::string where = name + ", " + engine + ", " + std::to_string(from) + " -> "
+                    + std::to_string(to);
+                Check(route.has_value() == expected.has_value(), where + ": reachability differs");
+                if (route) {
+                    Check(route->weight == expected->weight, where + ": weight differs");
+                    CheckRoute(graph, *route, from, to, where);
+                }
+            };
+            check(expected, "floyd_warshall");
+            check(dijkstra_router.BuildRoute(from, to), "all_pairs dijkstra");
+            check(on_demand_router.BuildRoute(from, to), "dijkstra");
+            check(astar_router.BuildRoute(from, to), "astar");
+            check(bidirectional_router.BuildRoute(from, to), "bidirectional_astar");
+            check(hierarchy_router.BuildRoute(from, to), "contraction_hierarchy");
+        }
+    }
+}
+
+void CheckBuildCancel(const Graph& graph) {
+    const std::atomic<bool> cancel{true};
+    for (const auto algorithm : {graph::AllPairsAlgorithm::FLOYD_WARSHALL, graph::AllPairsAlgorithm::DIJKSTRA}) {
+        graph::AllPairsSettings settings;
+        settings.algorithm = algorithm;
+        settings.thread_count = 2;
+        settings.cancel = &cancel;
+        bool cancelled = false;
+        try {
+            graph::Router<double> router(graph, settings);
+        } catch (const graph::BuildCancelled&) {
+            cancelled = true;
+        }
+        Check(cancelled, "all-pairs build ignores the cancel flag");
+    }
+    bool cancelled = false;
+    try {
+        graph::ContractionHierarchyRouter<double> router(graph, &cancel);
+    } catch (const graph::BuildCancelled&) {
+        cancelled = true;
+    }
+    Check(cancelled, "contraction hierarchy build ignores the cancel flag");
+}
+
+}  // namespace
+
+int main() {
+    try {
+        std::mt19937 random(42);
+        CheckRelaxRowKernels<double, graph::EdgeId>(random);
+        CheckRelaxRowKernels<uint32_t, uint32_t>(random);
+
+        // больше одного блока Флойда-Уоршелла, с недостижимыми вершинами и петлями
+        for (const auto& [vertex_count, edge_count] : {std::pair<size_t, size_t>{1, 0}, {20, 60}, {150, 600}}) {
+            const Graph graph = MakeRandomGraph(vertex_count, edge_count, random);
+            const std::string name = std::to_string(vertex_count) + " vertices";
+            CheckEdgeIdIterator(graph);
+            CheckAllPairs(graph, graph::RoutesTableLayout::WIDE, name + ", wide");
+            CheckAllPairs(graph, graph::RoutesTableLayout::COMPACT, name + ", compact");
+        }
+        CheckBuildCancel(MakeRandomGraph(150, 600, random));
+    } catch (const std::exception& e) {
+        std::cerr << "router_tests: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "router_tests: OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,34 @@
+# Собирает базу make_base по шаблону data/make_base.json.in с заданными настройками,
+# отвечает на data/process_requests.json.in и сравнивает ответ с data/expected.json:
+# ответы не должны зависеть от способа поиска маршрутов, модели графа и формата базы.
+#   cmake -DPROGRAM=<transport_catalogue> -DDATA_DIR=<tests/data> -DWORK_DIR=<каталог>
+#         -DROUTER_ENGINE=... -DGRAPH_MODEL=... -DALL_PAIRS_BUILD=... -DROUTES_TABLE=...
+#         -DFORMAT=... -P run_requests.cmake
+
+file(MAKE_DIRECTORY ${WORK_DIR})
+set(BASE_FILE ${WORK_DIR}/base.db)
+configure_file(${DATA_DIR}/make_base.json.in ${WORK_DIR}/make_base.json @ONLY)
+configure_file(${DATA_DIR}/process_requests.json.in ${WORK_DIR}/process_requests.json @ONLY)
+
+execute_process(COMMAND ${PROGRAM} make_base
+                INPUT_FILE ${WORK_DIR}/make_base.json
+                RESULT_VARIABLE result
+                ERROR_VARIABLE errors)
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "make_base failed (${result}):\n${errors}")
+endif()
+
+execute_process(COMMAND ${PROGRAM} process_requests
+                INPUT_FILE ${WORK_DIR}/process_requests.json
+                OUTPUT_FILE ${WORK_DIR}/output.json
+                RESULT_VARIABLE result
+                ERROR_VARIABLE errors)
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "process_requests failed (${result}):\n${errors}")
+endif()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK_DIR}/output.json ${DATA_DIR}/expected.json
+                RESULT_VARIABLE different)
+if (different)
+    message(FATAL_ERROR "${WORK_DIR}/output.json differs from ${DATA_DIR}/expected.json")
+endif()
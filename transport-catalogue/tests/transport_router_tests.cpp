@@ -0,0 +1,126 @@
+// Проверка моделей графа TransportRouter: на случайной сети остановок и маршрутов ответы
+// модели STOP_BUS_STATES совпадают с ответами STOP_PAIRS вплоть до последнего знака времени.
+
+#include "../transport_catalogue.h"
+#include "../transport_router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using transport_router::TransportRouter;
+
+void Check(bool condition, const std::string& message) {
+    if (!condition) {
+        throw std::runtime_error(message);
+    }
+}
+
+// остановки вокруг Москвы, маршруты из случайных остановок без повторов, часть кольцевые;
+// расстояния задаются между соседними остановками маршрутов, иногда разные в две стороны
+void FillCatalogue(transport_catalogue::TransportCatalogue& catalogue, size_t stop_count, size_t route_count,
+                   std::mt19937& random) {
+    std::uniform_real_distribution<double> lat(55.5, 55.9);
+    std::uniform_real_distribution<double> lng(37.3, 37.9);
+    for (uint32_t id = 0; id < stop_count; ++id) {
+        catalogue.AddStop("Stop " + std::to_string(id), {lat(random), lng(random)}, id);
+    }
+
+    std::uniform_int_distribution<size_t> route_length(2, 25);
+    std::uniform_int_distribution<uint64_t> distance(150, 5000);
+    std::uniform_int_distribution<int> coin(0, 3);
+    std::vector<uint32_t> stop_ids(stop_count);
+    std::iota(stop_ids.begin(), stop_ids.end(), 0);
+    for (uint16_t id = 0; id < route_count; ++id) {
+        std::shuffle(stop_ids.begin(), stop_ids.end(), random);
+        std::vector<uint32_t> route_stops(stop_ids.begin(), stop_ids.begin() + route_length(random));
+        const bool circle = coin(random) == 0;
+        if (circle) {
+            route_stops.push_back(route_stops.front());
+        }
+        for (size_t n = 0; n + 1 < route_stops.size(); ++n) {
+            const Stop* from = catalogue.GetStopById(route_stops[n]);
+            const Stop* to = catalogue.GetStopById(route_stops[n + 1]);
+            catalogue.SetStopDistance(from, to, distance(random));
+            if (coin(random) == 0) {
+                catalogue.SetStopDistance(to, from, distance(random));
+            }
+        }
+        catalogue.AddRoute("Bus " + std::to_string(id), circle ? RouteType::CIRCLE : RouteType::LINEAR,
+                           route_stops, id);
+    }
+    catalogue.FreezeNames();
+    catalogue.FreezeDistances();
+}
+
+// элементы ответа запроса Route и суммарное время; время со всеми значащими цифрами, так
+// что расхождение в последнем бите видно и тогда, когда при выводе JSON оно округляется
+std::string Describe(const std::optional<std::vector<RouteData>>& route) {
+    if (!route) {
+        return "not found";
+    }
+    std::ostringstream out;
+    out.precision(17);
+    double total_time = 0.0;
+    for (const RouteData& item : *route) {
+        out << item.type << ' ' << item.stop_name << item.bus_name << ' ' << item.span_count << ' '
+            << item.bus_wait_time << ' ' << item.motion_time << "; ";
+        total_time += item.bus_wait_time + item.motion_time;
+    }
+    out << "total " << total_time;
+    return out.str();
+}
+
+void CheckGraphModels(const transport_catalogue::TransportCatalogue& catalogue, std::mt19937& random) {
+    RoutingSettings settings;
+    settings.bus_wait_time = 6;
+    settings.bus_velocity = 40.0;
+    settings.router_engine = RouterEngine::DIJKSTRA;
+    settings.router_threads = 2;
+
+    TransportRouter stop_pairs(catalogue);
+    stop_pairs.SetRoutingSettings(settings);
+    stop_pairs.InitializeGraph();
+    settings.graph_model = GraphModel::STOP_BUS_STATES;
+    TransportRouter bus_states(catalogue);
+    bus_states.SetRoutingSettings(settings);
+    bus_states.InitializeGraph();
+
+    std::uniform_int_distribution<uint32_t> stop(0, catalogue.GetNumberStops() - 1);
+    size_t found = 0;
+    for (int n = 0; n < 400; ++n) {
+        const std::string_view from = catalogue.GetStopNameById(stop(random));
+        const std::string_view to = catalogue.GetStopNameById(stop(random));
+        const std::string expected = Describe(stop_pairs.CreatRoute(from, to));
+        const std::string actual = Describe(bus_states.CreatRoute(from, to));
+        Check(actual == expected, std::string(from) + " -> " + std::string(to) + ": stop_bus_states answer\n"
+              + actual + "\ndiffers from stop_pairs answer\n" + expected);
+        found += expected != "not found";
+    }
+    Check(found > 200, "too few routes found, the network is not connected enough");
+}
+
+}  // namespace
+
+int main() {
+    try {
+        std::mt19937 random(42);
+        transport_catalogue::TransportCatalogue catalogue;
+        FillCatalogue(catalogue, 300, 40, random);
+        CheckGraphModels(catalogue, random);
+    } catch (const std::exception& e) {
+        std::cerr << "transport_router_tests: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "transport_router_tests: OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include "thread_pool.h"
+
+namespace thread_pool {
+
+ThreadPool::ThreadPool(size_t thread_count)
+    : queues_(std::make_unique<WorkQueue[]>(thread_count == 0 ? 1 : thread_count))
+    , statistics_(thread_count == 0 ? 1 : thread_count) {
+    for (size_t n = 1; n < thread_count; ++n) {
+        workers_.emplace_back([this, n] { WorkerLoop(n); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard guard(mutex_);
+        stop_ = true;
+    }
+    start_cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::GetThreadCount() const {
+    return workers_.size() + 1;
+}
+
+size_t ThreadPool::DefaultThreadCount() {
+    const size_t count = std::thread::hardware_concurrency();
+    return count == 0 ? 1 : count;
+}
+
+std::vector<ThreadStatistics> ThreadPool::ParallelFor(size_t count, const Task& task) {
+    const size_t thread_count = GetThreadCount();
+    if (count == 0) {
+        return std::vector<ThreadStatistics>(thread_count);
+    }
+
+    {
+        std::lock_guard guard(mutex_);
+        task_ = &task;
+        for (size_t n = 0; n < thread_count; ++n) {
+            std::lock_guard queue_guard(queues_[n].mutex);
+            queues_[n].begin = count * n / thread_count;
+            queues_[n].end = count * (n + 1) / thread_count;
+            statistics_[n] = {};
+        }
+        pending_workers_ = workers_.size();
+        error_ = nullptr;
+        failed_ = false;
+        ++generation_;
+    }
+    start_cv_.notify_all();
+
+    // вызывающий поток тоже берёт задачи
+    RunTasks(0);
+
+    std::unique_lock lock(mutex_);
+    done_cv_.wait(lock, [this] { return pending_workers_ == 0; });
+    task_ = nullptr;
+    if (error_) {
+        std::rethrow_exception(std::exchange(error_, nullptr));
+    }
+    return statistics_;
+}
+
+void ThreadPool::WorkerLoop(size_t thread_index) {
+    size_t seen_generation = 0;
+    std::unique_lock lock(mutex_);
+    while (true) {
+        start_cv_.wait(lock, [&] { return stop_ || generation_ != seen_generation; });
+        if (stop_) {
+            return;
+        }
+        seen_generation = generation_;
+
+        lock.unlock();
+        RunTasks(thread_index);
+        lock.lock();
+
+        if (--pending_workers_ == 0) {
+            done_cv_.notify_one();
+        }
+    }
+}
+
+void ThreadPool::RunTasks(size_t thread_index) {
+    ThreadStatistics& statistics = statistics_[thread_index];
+    size_t task_index = 0;
+    while (!failed_) {
+        if (!PopTask(thread_index, task_index)) {
+            if (!StealTasks(thread_index)) {
+                break;  // задачи закончились у всех потоков
+            }
+            continue;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        try {
+            (*task_)(task_index, thread_index);
+        } catch (...) {
+            std::lock_guard guard(mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+            failed_ = true;
+        }
+        statistics.busy += std::chrono::steady_clock::now() - start;
+        ++statistics.tasks;
+    }
+}
+
+bool ThreadPool::PopTask(size_t thread_index, size_t& task_index) {
+    WorkQueue& queue = queues_[thread_index];
+    std::lock_guard guard(queue.mutex);
+    if (queue.begin == queue.end) {
+        return false;
+    }
+    task_index = queue.begin++;
+    return true;
+}
+
+bool ThreadPool::StealTasks(size_t thread_index) {
+    const size_t thread_count = GetThreadCount();
+    for (size_t shift = 1; shift < thread_count; ++shift) {
+        WorkQueue& victim = queues_[(thread_index + shift) % thread_count];
+        size_t begin = 0;
+        size_t end = 0;
+        {
+            std::lock_guard guard(victim.mutex);
+            if (victim.begin == victim.end) {
+                continue;
+            }
+            // забираем вторую половину оставшегося диапазона (не меньше одной задачи)
+            begin = victim.begin + (victim.end - victim.begin) / 2;
+            end = victim.end;
+            victim.end = begin;
+        }
+        WorkQueue& queue = queues_[thread_index];
+        std::lock_guard guard(queue.mutex);
+        queue.begin = begin;
+        queue.end = end;
+        ++statistics_[thread_index].steals;
+        return true;
+    }
+    return false;
+}
+
+} // namespace thread_pool
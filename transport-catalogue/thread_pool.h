@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// thread_pool — пул потоков для параллельной обработки независимых задач
+
+namespace thread_pool {
+
+// статистика одного потока за вызов ParallelFor
+struct ThreadStatistics {
+    size_t tasks = 0;                 // выполнено задач
+    size_t steals = 0;                // сколько раз поток забирал задачи у других потоков
+    std::chrono::nanoseconds busy{0}; // время выполнения задач
+};
+
+// добавляет статистику part к total (по потокам)
+inline void AccumulateStatistics(std::vector<ThreadStatistics>& total, const std::vector<ThreadStatistics>& part) {
+    if (total.size() < part.size()) {
+        total.resize(part.size());
+    }
+    for (size_t n = 0; n < part.size(); ++n) {
+        total[n].tasks += part[n].tasks;
+        total[n].steals += part[n].steals;
+        total[n].busy += part[n].busy;
+    }
+}
+
+// Пул с перехватом работы (work stealing): задачи ParallelFor делятся поровну между
+// потоками, каждый поток берёт задачи из начала своего диапазона, а освободившийся поток
+// забирает у другого потока вторую половину его оставшегося диапазона.
+class ThreadPool {
+public:
+    // task(index, thread_index); thread_index - номер потока из [0, GetThreadCount())
+    using Task = std::function<void(size_t, size_t)>;
+
+    // thread_count - общее число потоков с учётом вызывающего ParallelFor
+    explicit ThreadPool(size_t thread_count = DefaultThreadCount());
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    size_t GetThreadCount() const;
+
+    // вызывает task(index, thread_index) для каждого index из [0, count) и ждёт завершения
+    // всех вызовов; возвращает статистику по потокам. Первое исключение, выброшенное
+    // задачей, передаётся вызывающему, оставшиеся задачи при этом не выполняются
+    std::vector<ThreadStatistics> ParallelFor(size_t count, const Task& task);
+
+    static size_t DefaultThreadCount();
+
+private:
+    // невыполненный диапазон задач потока [begin, end)
+    struct WorkQueue {
+        std::mutex mutex;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    void WorkerLoop(size_t thread_index);
+    void RunTasks(size_t thread_index);
+    bool PopTask(size_t thread_index, size_t& task_index);
+    bool StealTasks(size_t thread_index);
+
+    std::vector<std::thread> workers_;
+    std::unique_ptr<WorkQueue[]> queues_;
+    std::vector<ThreadStatistics> statistics_;
+
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    bool stop_ = false;
+    size_t generation_ = 0;
+    size_t pending_workers_ = 0;
+    std::exception_ptr error_;
+    std::atomic<bool> failed_{false};
+
+    const Task* task_ = nullptr;
+};
+
+} // namespace thread_pool
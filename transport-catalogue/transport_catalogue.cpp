@@ -1,7 +1,8 @@
 #include <algorithm>
 #include <cassert>
+#include <limits>
 #include <stdexcept>
-#include <unordered_set>
+#include <tuple>
 
 #include "transport_catalogue.h"
 
@@ -9,80 +10,238 @@ using namespace std;
 
 namespace transport_catalogue {
 
+void TransportCatalogue::Attach(FrozenCatalogue catalogue) {
+    if (!stops_.empty() || !routes_.empty()) {
+        throw std::logic_error("Catalogue should be empty");
+    }
+    if (!catalogue.names || !catalogue.names->IsFrozen()) {
+        throw std::invalid_argument("Attached names should be frozen");
+    }
+    const NamePool& names = *catalogue.names;
+    const size_t stop_count = catalogue.stop_name_ids.size();
+    const StopCoordinates& coordinates = catalogue.stop_coordinates;
+    if (coordinates.latitudes.size() != stop_count || coordinates.longitudes.size() != stop_count
+            || coordinates.unit_vectors.size() != stop_count || coordinates.unit_vectors.y.size() != stop_count
+            || coordinates.unit_vectors.z.size() != stop_count) {
+        throw std::invalid_argument("Attached stops do not match coordinates");
+    }
+    const size_t route_count = catalogue.route_name_ids.size();
+    const auto& route_stop_offsets = catalogue.route_stop_offsets;
+    const size_t pool_size = catalogue.route_stop_ids.size();
+    if (route_count > std::numeric_limits<uint16_t>::max() + 1u || catalogue.route_types.size() != route_count
+            || route_stop_offsets.size() != route_count + 1 || route_stop_offsets.front() != 0
+            || route_stop_offsets.back() != pool_size
+            || !is_sorted(route_stop_offsets.begin(), route_stop_offsets.end())
+            || catalogue.route_infos.size() != route_count) {
+        throw std::invalid_argument("Attached routes are malformed");
+    }
+    const auto out_of = [](const auto& ids, size_t count) {
+        return any_of(ids.begin(), ids.end(), [count](uint32_t id) { return id >= count; });
+    };
+    if (out_of(catalogue.stop_name_ids, names.Size()) || out_of(catalogue.route_name_ids, names.Size())) {
+        throw std::invalid_argument("Attached names do not match stops and routes");
+    }
+    if (out_of(catalogue.route_stop_ids, stop_count)) {
+        throw std::invalid_argument("Attached routes do not match stops");
+    }
+    const StopDistances& distances = catalogue.distances;
+    if (distances.offsets.size() != stop_count + 1 || distances.offsets.front() != 0
+            || distances.offsets.back() != distances.neighbours.size()
+            || distances.distances.size() != distances.neighbours.size()
+            || !is_sorted(distances.offsets.begin(), distances.offsets.end())
+            || out_of(distances.neighbours, stop_count)
+            || catalogue.route_forward_distances.size() != pool_size
+            || catalogue.route_backward_distances.size() != pool_size
+            || any_of(catalogue.distance_list.begin(), catalogue.distance_list.end(),
+                      [stop_count](const DistanceBeetweenPairStops& distance) {
+                          return distance.id_stop_from >= stop_count || distance.id_stop_to >= stop_count;
+                      })) {
+        throw std::invalid_argument("Attached distances do not match stops");
+    }
+    CheckStopRoutes(catalogue.stop_routes, stop_count, route_count);
+    if (catalogue.stop_grid.ids.size() != stop_count) {
+        throw std::invalid_argument("Attached stop index does not match stops");
+    }
+    auto stop_index = std::make_shared<geo::SpatialIndex>(move(catalogue.stop_grid),
+                                                          move(catalogue.stop_grid_points));
+
+    names_ = move(catalogue.names);
+    stop_coordinates_ = std::make_shared<StopCoordinates>(move(catalogue.stop_coordinates));
+    stop_ids_by_name_id_.assign(names_->Size(), NamePool::NO_NAME);
+    for (uint32_t id = 0; id < stop_count; ++id) {
+        Stop stop;
+        stop.name_id = catalogue.stop_name_ids[id];
+        stop.name = names_->Get(stop.name_id);
+        stop.coordinate = {stop_coordinates_->latitudes[id], stop_coordinates_->longitudes[id]};
+        stop.id = id;
+        stops_.push_back(move(stop));
+        // при повторе названия остаётся первая остановка, как в AddStop
+        if (stop_ids_by_name_id_[stops_.back().name_id] == NamePool::NO_NAME) {
+            stop_ids_by_name_id_[stops_.back().name_id] = id;
+        }
+    }
+
+    route_stop_ids_ = std::make_shared<ranges::FrozenArray<uint32_t>>(move(catalogue.route_stop_ids));
+    route_ids_by_name_id_.assign(names_->Size(), NamePool::NO_NAME);
+    for (uint32_t id = 0; id < route_count; ++id) {
+        Route route;
+        route.name_id = catalogue.route_name_ids[id];
+        route.name = names_->Get(route.name_id);
+        route.route_type = static_cast<RouteType>(catalogue.route_types[id]);
+        route.id = static_cast<uint16_t>(id);
+        route.stops = RouteStops(route_stop_ids_.get(), &stops_, route_stop_offsets[id],
+                                 route_stop_offsets[id + 1] - route_stop_offsets[id]);
+        routes_.push_back(move(route));
+        route_ids_by_name_id_[routes_.back().name_id] = id;
+    }
+
+    distance_list_ = move(catalogue.distance_list);
+    distances_ = move(catalogue.distances);
+    route_forward_distances_ = move(catalogue.route_forward_distances);
+    route_backward_distances_ = move(catalogue.route_backward_distances);
+    SetRouteInfos(move(catalogue.route_infos));
+    stop_routes_ = move(catalogue.stop_routes);
+    stop_index_ = move(stop_index);
+}
+
 // добавление остановки в базу
-void TransportCatalogue::AddStop(const std::string &stop_name,
+void TransportCatalogue::AddStop(std::string_view stop_name,
         const geo::Coordinates coordinate, uint32_t stop_id) {
+    if (stop_id != stops_.size()) {
+        throw std::invalid_argument("Stop ids should be sequential");
+    }
+    if (stop_index_) {
+        throw std::logic_error("Stop index is built");
+    }
     Stop stop;
-    stop.name = stop_name;
+    stop.name_id = names_->Add(stop_name);
+    stop.name = names_->Get(stop.name_id);
     stop.coordinate = coordinate;
     stop.id = stop_id;
     stops_.push_back(move(stop));
-    stops_by_names_.insert({stops_.back().name, &stops_.back()});
+    if (stop_ids_by_name_id_.size() <= stops_.back().name_id) {
+        stop_ids_by_name_id_.resize(names_->Size(), NamePool::NO_NAME);
+    }
+    // при повторе названия остаётся первая остановка
+    if (stop_ids_by_name_id_[stops_.back().name_id] == NamePool::NO_NAME) {
+        stop_ids_by_name_id_[stops_.back().name_id] = stop_id;
+    }
+    stop_coordinates_->latitudes.push_back(coordinate.lat);
+    stop_coordinates_->longitudes.push_back(coordinate.lng);
+    stop_coordinates_->unit_vectors.Add(coordinate);
 }
 
 // добавление маршрута в базу
 void TransportCatalogue::AddRoute(string_view name, RouteType type,
         std::vector<std::string_view> stops, uint16_t route_id) {
-    Route route;
-    route.name = name;
-    route.route_type = type;
-    route.id = route_id;
-
+    std::vector<uint32_t> stop_ids;
+    stop_ids.reserve(stops.size());
     for (auto& stop : stops) {
         auto found_stop = GetStopByName(stop);
-
         if (found_stop != nullptr) {
-            route.stops.push_back(found_stop);
+            stop_ids.push_back(found_stop->id);
         }
     }
+    AddRoute(name, type, stop_ids, route_id);
+}
 
-    routes_.push_back(move(route));
-    routes_by_names_[routes_.back().name] = &routes_.back();
+void TransportCatalogue::AddRoute(string_view name, RouteType type,
+        const std::vector<uint32_t>& stop_ids, uint16_t route_id) {
+    if (route_id != routes_.size()) {
+        throw std::invalid_argument("Route ids should be sequential");
+    }
+    if (IsDistancesFrozen()) {
+        throw std::logic_error("Distances are frozen");
+    }
+    Route route;
+    route.name_id = names_->Add(name);
+    route.name = names_->Get(route.name_id);
+    route.route_type = type;
+    route.id = route_id;
+    route.stops = RouteStops(route_stop_ids_.get(), &stops_, route_stop_ids_->size(), stop_ids.size());
+    for (const uint32_t stop_id : stop_ids) {
+        route_stop_ids_->push_back(GetStopById(stop_id)->id);
+    }
 
-    for (auto& stop : stops) {
-        auto found_stop = GetStopByName(stop);
-        if (found_stop != nullptr) {
-            routes_on_stops_[found_stop].insert(routes_.back().name);
-        }
+    routes_.push_back(move(route));
+    if (route_ids_by_name_id_.size() <= routes_.back().name_id) {
+        route_ids_by_name_id_.resize(names_->Size(), NamePool::NO_NAME);
     }
+    route_ids_by_name_id_[routes_.back().name_id] = route_id;
+}
+
+uint32_t TransportCatalogue::FindByNameId(const std::vector<uint32_t>& ids_by_name_id, uint32_t name_id) {
+    return name_id < ids_by_name_id.size() ? ids_by_name_id[name_id] : NamePool::NO_NAME;
 }
 
 const Stop* TransportCatalogue::GetStopByName(
         string_view stop_name) const {
-    if (stops_by_names_.count(stop_name) == 0) {
-        return nullptr;
-    }
-    return stops_by_names_.at(stop_name);
+    const uint32_t id = FindByNameId(stop_ids_by_name_id_, names_->Find(stop_name));
+    return id == NamePool::NO_NAME ? nullptr : &stops_[id];
 }
 
 const Route* TransportCatalogue::GetRouteByName(
         string_view route_name) const {
-    if (routes_by_names_.count(route_name) == 0) {
-        return nullptr;
-    }
-    return routes_by_names_.at(route_name);
+    const uint32_t id = FindByNameId(route_ids_by_name_id_, names_->Find(route_name));
+    return id == NamePool::NO_NAME ? nullptr : &routes_[id];
+}
+
+const Stop* TransportCatalogue::GetStopById(uint32_t id) const {
+    return &stops_.at(id);
+}
+
+const Route* TransportCatalogue::GetRouteById(uint32_t id) const {
+    return &routes_.at(id);
 }
 
 std::string_view TransportCatalogue::GetStopNameById(uint32_t id) const {
-    const auto& it = std::find_if(stops_.begin(), stops_.end(),
-        [id](const Stop r) { return ( r.id == id ); });
-    return (*it).name;
+    return stops_.at(id).name;
 }
 
 std::string_view TransportCatalogue::GetRouteNameById(uint32_t id) const {
-    const auto& it = std::find_if(routes_.begin(), routes_.end(),
-        [id](const Route r) { return ( r.id == id ); });
-    return (*it).name;
-};
+    return routes_.at(id).name;
+}
+
+const StopCoordinates& TransportCatalogue::GetStopCoordinates() const {
+    return *stop_coordinates_;
+}
+
+const NamePool& TransportCatalogue::GetNames() const {
+    return *names_;
+}
 
-const std::unordered_map<string_view, const Route*>
-&TransportCatalogue::GetAllRoutes() const {
-    return routes_by_names_;
+void TransportCatalogue::LoadNames(std::string_view block, const std::vector<uint32_t>& lengths,
+        std::optional<PerfectHash::Data> index, std::vector<uint32_t> sorted_ids) {
+    names_->Load(block, lengths, std::move(index), std::move(sorted_ids));
+}
+
+void TransportCatalogue::FreezeNames() {
+    names_->Freeze();
+}
+
+void TransportCatalogue::ShareNames(const TransportCatalogue& other) {
+    if (!stops_.empty() || !routes_.empty()) {
+        throw std::logic_error("Names should be shared before adding stops and routes");
+    }
+    if (!other.names_->IsFrozen()) {
+        throw std::logic_error("Shared names should be frozen");
+    }
+    names_ = other.names_;
 }
 
-const std::unordered_map<string_view, const Stop*>
-&TransportCatalogue::GetAllStops() const {
-    return stops_by_names_;
+std::vector<const Stop*> TransportCatalogue::SuggestStops(std::string_view prefix, size_t count) const {
+    std::vector<const Stop*> result;
+    // в отрезке встречаются и названия маршрутов - их пропускаем
+    for (const uint32_t name_id : names_->FindByPrefix(prefix)) {
+        if (result.size() >= count) {
+            break;
+        }
+        const uint32_t stop_id = FindByNameId(stop_ids_by_name_id_, name_id);
+        if (stop_id != NamePool::NO_NAME) {
+            result.push_back(&stops_[stop_id]);
+        }
+    }
+    return result;
 }
 
 int CalculateStops(const Route *route) noexcept {
@@ -96,28 +255,22 @@ int CalculateStops(const Route *route) noexcept {
     return result;
 }
 
-int CalculateUniqueStops(const Route *route) noexcept {
+int CalculateUniqueStops(const Route *route) {
     int result = 0;
     if (route != nullptr) {
-        unordered_set<string_view> uniques;
-        for (auto stop : route->stops) {
-            uniques.insert(stop->name);
-        }
-        result = static_cast<int>(uniques.size());
+        std::vector<uint32_t> uniques(route->stops.GetIds(), route->stops.GetIds() + route->stops.size());
+        sort(uniques.begin(), uniques.end());
+        result = static_cast<int>(unique(uniques.begin(), uniques.end()) - uniques.begin());
     }
     return result;
 }
 
-double CalculateRouteLength(const Route *route) noexcept {
+double TransportCatalogue::CalculateRouteLength(const Route* route) const {
     double result = 0.0;
     if (route == nullptr) {
         return result;
     }
-    for (auto iter1 = route->stops.begin(), iter2 = iter1 + 1;
-            iter2 < route->stops.end(); ++iter1, ++iter2) {
-        result += geo::ComputeDistance((*iter1)->coordinate,
-                (*iter2)->coordinate);
-    }
+    result = geo::ComputePathLength(stop_coordinates_->unit_vectors, route->stops.GetIds(), route->stops.size());
     if (route->route_type == RouteType::LINEAR) {
         result *= 2;
     }
@@ -126,90 +279,350 @@ double CalculateRouteLength(const Route *route) noexcept {
 
 const RouteInfo* TransportCatalogue::GetRouteInfo(
         const std::string_view& route_name) const {
-    RouteInfo result;
     auto route = GetRouteByName(route_name);
     if (route == nullptr)
     {
         return nullptr;
     }
-    result.name = route->name;
-    result.route_type = route->route_type;
-    result.number_of_stops = CalculateStops(route);
-    result.number_of_unique_stops = CalculateUniqueStops(route);
-    result.route_length = this->CalculateRealRouteLength(route);
-    // извилистость, то есть отношение фактической длины маршрута к географическому расстоянию
-    result.curvature = static_cast<double>(result.route_length) / CalculateRouteLength(route);
-    return new RouteInfo(result);
+    return &route_infos_.at(route->id);
+}
+
+void TransportCatalogue::BuildRouteInfos() {
+    route_infos_.clear();
+    route_infos_.reserve(routes_.size());
+    for (const Route& route : routes_) {
+        RouteInfo result;
+        result.name = route.name;
+        result.route_type = route.route_type;
+        result.number_of_stops = CalculateStops(&route);
+        result.number_of_unique_stops = CalculateUniqueStops(&route);
+        result.route_length = this->CalculateRealRouteLength(&route);
+        // извилистость, то есть отношение фактической длины маршрута к географическому расстоянию
+        result.curvature = static_cast<double>(result.route_length) / CalculateRouteLength(&route);
+        route_infos_.push_back(result);
+    }
+}
+
+void TransportCatalogue::SetRouteInfos(std::vector<RouteInfo> route_infos) {
+    if (route_infos.size() != routes_.size()) {
+        throw std::invalid_argument("Route infos should match routes");
+    }
+    for (size_t id = 0; id < route_infos.size(); ++id) {
+        route_infos[id].name = routes_[id].name;
+        route_infos[id].route_type = routes_[id].route_type;
+    }
+    route_infos_ = move(route_infos);
+}
+
+const std::vector<RouteInfo>& TransportCatalogue::GetRouteInfos() const {
+    return route_infos_;
+}
+
+TransportCatalogue::RouteIdsRange TransportCatalogue::GetRoutesOnStop(const Stop* stop) const {
+    if (stop_routes_.offsets.empty()) {
+        throw std::logic_error("Stop routes should be built");
+    }
+    return {stop_routes_.route_ids.begin() + stop_routes_.offsets.at(stop->id),
+            stop_routes_.route_ids.begin() + stop_routes_.offsets.at(stop->id + 1)};
+}
+
+void TransportCatalogue::BuildStopRoutes() {
+    // маршруты с одинаковым названием считаются одним: берём тот, что находится по названию
+    std::vector<uint32_t> named_route_ids(routes_.size());
+    for (const Route& route : routes_) {
+        named_route_ids[route.id] = FindByNameId(route_ids_by_name_id_, route.name_id);
+    }
+    // место маршрута в порядке названий, чтобы дальше сравнивать числа, а не строки
+    std::vector<uint32_t> order(routes_.size());
+    for (uint32_t id = 0; id < order.size(); ++id) {
+        order[id] = id;
+    }
+    sort(order.begin(), order.end(), [this](uint32_t lhs, uint32_t rhs) {
+        return routes_[lhs].name < routes_[rhs].name;
+    });
+    std::vector<uint32_t> name_ranks(routes_.size());
+    for (uint32_t rank = 0; rank < order.size(); ++rank) {
+        name_ranks[order[rank]] = rank;
+    }
+
+    std::vector<uint32_t> offsets(stops_.size() + 1, 0);
+    for (const uint32_t stop_id : *route_stop_ids_) {
+        ++offsets[stop_id + 1];
+    }
+    for (size_t id = 0; id < stops_.size(); ++id) {
+        offsets[id + 1] += offsets[id];
+    }
+    std::vector<uint32_t> route_ids(route_stop_ids_->size());
+    std::vector<uint32_t> positions(offsets.begin(), offsets.end() - 1);
+    for (const Route& route : routes_) {
+        for (const uint32_t* stop_id = route.stops.GetIds(); stop_id != route.stops.GetIds() + route.stops.size(); ++stop_id) {
+            route_ids[positions[*stop_id]++] = named_route_ids[route.id];
+        }
+    }
+
+    // сортируем и убираем повторы внутри каждой остановки, сжимая массив на месте
+    const auto by_name = [&name_ranks](uint32_t lhs, uint32_t rhs) {
+        return name_ranks[lhs] < name_ranks[rhs];
+    };
+    size_t size = 0;
+    for (size_t id = 0; id < stops_.size(); ++id) {
+        const auto begin = route_ids.begin() + offsets[id];
+        const auto end = route_ids.begin() + offsets[id + 1];
+        sort(begin, end, by_name);
+        const auto unique_end = unique(begin, end);
+        offsets[id] = static_cast<uint32_t>(size);
+        size = copy(begin, unique_end, route_ids.begin() + size) - route_ids.begin();
+    }
+    offsets[stops_.size()] = static_cast<uint32_t>(size);
+    route_ids.resize(size);
+    route_ids.shrink_to_fit();
+    stop_routes_ = {move(offsets), move(route_ids)};
+}
+
+void TransportCatalogue::SetStopRoutes(StopRoutes stop_routes) {
+    CheckStopRoutes(stop_routes, stops_.size(), routes_.size());
+    stop_routes_ = move(stop_routes);
+}
+
+void TransportCatalogue::CheckStopRoutes(const StopRoutes& stop_routes, size_t stop_count, size_t route_count) {
+    if (stop_routes.offsets.size() != stop_count + 1 || stop_routes.offsets.front() != 0
+            || stop_routes.offsets.back() != stop_routes.route_ids.size()
+            || !is_sorted(stop_routes.offsets.begin(), stop_routes.offsets.end())) {
+        throw std::invalid_argument("Stop routes do not match stops");
+    }
+    for (const uint32_t route_id : stop_routes.route_ids) {
+        if (route_id >= route_count) {
+            throw std::invalid_argument("Stop routes do not match routes");
+        }
+    }
+}
+
+const StopRoutes& TransportCatalogue::GetStopRoutes() const {
+    return stop_routes_;
+}
+
+std::vector<NearbyStop> TransportCatalogue::FindNearbyStops(geo::Coordinates point, std::optional<double> radius,
+        std::optional<size_t> count) const {
+    if (!stop_index_) {
+        throw std::logic_error("Stop index should be built");
+    }
+    std::vector<NearbyStop> result;
+    for (const geo::SpatialIndex::Found& found : stop_index_->Find(point, radius, count)) {
+        result.push_back({&stops_[found.id], found.distance});
+    }
+    return result;
+}
+
+void TransportCatalogue::BuildStopIndex() {
+    stop_index_ = std::make_shared<geo::SpatialIndex>(stop_coordinates_->latitudes, stop_coordinates_->longitudes);
+}
+
+void TransportCatalogue::SetStopIndex(geo::SpatialIndex::Data data) {
+    stop_index_ = std::make_shared<geo::SpatialIndex>(std::move(data), stop_coordinates_->latitudes,
+                                                      stop_coordinates_->longitudes);
+}
+
+const geo::SpatialIndex& TransportCatalogue::GetStopIndex() const {
+    if (!stop_index_) {
+        throw std::logic_error("Stop index should be built");
+    }
+    return *stop_index_;
 }
 
-const std::set<std::string_view>*
-TransportCatalogue::GetRoutesOnStop(const Stop* stop) const {
-    auto found = routes_on_stops_.find(stop);
-    if (found == routes_on_stops_.end()) {
-        return {};
-    } else {
-        return &found->second;
+bool TransportCatalogue::ShareStopGeometry(const TransportCatalogue& other) {
+    if (!other.stop_index_ || stop_coordinates_->latitudes != other.stop_coordinates_->latitudes
+            || stop_coordinates_->longitudes != other.stop_coordinates_->longitudes) {
+        return false;
     }
+    stop_coordinates_ = other.stop_coordinates_;
+    stop_index_ = other.stop_index_;
+    return true;
 }
 
 void TransportCatalogue::SetStopDistance(const Stop* p_stop1,
         const Stop* p_stop2, uint64_t distance) {
+    if (IsDistancesFrozen()) {
+        throw std::logic_error("Distances are frozen");
+    }
     if (p_stop1 != nullptr && p_stop2 != nullptr) {
-        distances_[{ p_stop1, p_stop2 }] = distance;
+        distance_list_.push_back({p_stop1->id, p_stop2->id, distance});
+    }
+}
+
+void TransportCatalogue::FreezeDistances() {
+    if (IsDistancesFrozen()) {
+        return;
+    }
+    const auto by_stops = [](const DistanceBeetweenPairStops& lhs, const DistanceBeetweenPairStops& rhs) {
+        return std::tie(lhs.id_stop_from, lhs.id_stop_to) < std::tie(rhs.id_stop_from, rhs.id_stop_to);
+    };
+    const auto same_stops = [](const DistanceBeetweenPairStops& lhs, const DistanceBeetweenPairStops& rhs) {
+        return lhs.id_stop_from == rhs.id_stop_from && lhs.id_stop_to == rhs.id_stop_to;
+    };
+    // повторно заданное расстояние заменяет прежнее: оставляем последнее
+    std::vector<DistanceBeetweenPairStops> distance_list(distance_list_.begin(), distance_list_.end());
+    std::reverse(distance_list.begin(), distance_list.end());
+    std::stable_sort(distance_list.begin(), distance_list.end(), by_stops);
+    distance_list.erase(std::unique(distance_list.begin(), distance_list.end(), same_stops),
+                        distance_list.end());
+
+    // Если для двух остановок расстояние было задано только один раз,
+    // то оно считается одинаковым в обоих направлениях.
+    // Заданные расстояния идут раньше обратных, поэтому при совпадении остаются они.
+    std::vector<DistanceBeetweenPairStops> all_distances = distance_list;
+    for (const auto& pair_stops_distance : distance_list) {
+        all_distances.push_back({pair_stops_distance.id_stop_to, pair_stops_distance.id_stop_from,
+                                 pair_stops_distance.distance});
+    }
+    std::stable_sort(all_distances.begin(), all_distances.end(), by_stops);
+    all_distances.erase(std::unique(all_distances.begin(), all_distances.end(), same_stops),
+                        all_distances.end());
+
+    std::vector<uint32_t> offsets(stops_.size() + 1, 0);
+    std::vector<uint32_t> neighbours;
+    std::vector<uint32_t> distances;
+    neighbours.reserve(all_distances.size());
+    distances.reserve(all_distances.size());
+    for (const auto& pair_stops_distance : all_distances) {
+        if (pair_stops_distance.distance > std::numeric_limits<uint32_t>::max()) {
+            throw std::out_of_range("Distance between stops is too long");
+        }
+        ++offsets[pair_stops_distance.id_stop_from + 1];
+        neighbours.push_back(pair_stops_distance.id_stop_to);
+        distances.push_back(static_cast<uint32_t>(pair_stops_distance.distance));
+    }
+    for (size_t id = 0; id < stops_.size(); ++id) {
+        offsets[id + 1] += offsets[id];
+    }
+    distance_list_ = move(distance_list);
+    distances_ = {move(offsets), move(neighbours), move(distances)};
+
+    // суммы расстояний вдоль маршрутов: длина любого отрезка маршрута - одна разность
+    std::vector<uint64_t> forward_distances(route_stop_ids_->size(), 0);
+    std::vector<uint64_t> backward_distances(route_stop_ids_->size(), 0);
+    for (const Route& route : routes_) {
+        const size_t offset = route.stops.GetOffset();
+        for (size_t n = 1; n < route.stops.size(); ++n) {
+            forward_distances[offset + n] = forward_distances[offset + n - 1]
+                + GetStopDistance(route.stops[n - 1], route.stops[n]);
+            backward_distances[offset + n] = backward_distances[offset + n - 1]
+                + GetStopDistance(route.stops[n], route.stops[n - 1]);
+        }
     }
+    route_forward_distances_ = move(forward_distances);
+    route_backward_distances_ = move(backward_distances);
+}
+
+bool TransportCatalogue::IsDistancesFrozen() const {
+    return !distances_.offsets.empty();
 }
 
 uint64_t TransportCatalogue::GetStopDistance(const Stop*  p_stop1, const Stop*  p_stop2) const {
+    if (!IsDistancesFrozen()) {
+        throw std::logic_error("Distances should be frozen");
+    }
     if (p_stop1 != nullptr && p_stop2 != nullptr) {
-        // Если для двух остановок расстояние было задано только один раз,
-        // то оно считается одинаковым в обоих направлениях.
-        // Если вы не нашли расстояние от остановки x до остановки y,
-        // то поищите расстояние от y до x.
-        return (distances_.count({ p_stop1, p_stop2 })) ? 
-            distances_.at({ p_stop1, p_stop2 }) : 
-            ((distances_.count({ p_stop2, p_stop1 })) ? distances_.at({ p_stop2, p_stop1 }) : 0);
+        const auto begin = distances_.neighbours.begin() + distances_.offsets[p_stop1->id];
+        const auto end = distances_.neighbours.begin() + distances_.offsets[p_stop1->id + 1];
+        const auto found = std::lower_bound(begin, end, p_stop2->id);
+        if (found != end && *found == p_stop2->id) {
+            return distances_.distances[found - distances_.neighbours.begin()];
+        }
     }
     return 0; // static_cast<uint64_t>(ComputeDistance(p_stop1->coordinate, p_stop2->coordinate));
 }
 
+uint64_t TransportCatalogue::GetRouteDistance(const Route* route, size_t from_index, size_t to_index) const {
+    if (!IsDistancesFrozen()) {
+        throw std::logic_error("Distances should be frozen");
+    }
+    const size_t offset = route->stops.GetOffset();
+    if (from_index <= to_index) {
+        return route_forward_distances_[offset + to_index] - route_forward_distances_[offset + from_index];
+    }
+    return route_backward_distances_[offset + from_index] - route_backward_distances_[offset + to_index];
+}
+
+std::optional<uint64_t> TransportCatalogue::GetSegmentDistance(const Route* route,
+        const Stop* from, const Stop* to) const {
+    std::vector<size_t> from_indexes;
+    std::vector<size_t> to_indexes;
+    for (size_t n = 0; n < route->stops.size(); ++n) {
+        if (route->stops[n] == from) {
+            from_indexes.push_back(n);
+        }
+        if (route->stops[n] == to) {
+            to_indexes.push_back(n);
+        }
+    }
+    if (from_indexes.empty() || to_indexes.empty()) {
+        return std::nullopt;
+    }
+    if (from == to) {
+        return 0;
+    }
+    // остановки могут встречаться на маршруте несколько раз: выбираем кратчайший проезд,
+    // на некольцевом маршруте автобус идёт и в обратном направлении
+    std::optional<uint64_t> result;
+    for (const size_t from_index : from_indexes) {
+        for (const size_t to_index : to_indexes) {
+            if (from_index > to_index && route->route_type != RouteType::LINEAR) {
+                continue;
+            }
+            const uint64_t distance = GetRouteDistance(route, from_index, to_index);
+            if (!result || distance < *result) {
+                result = distance;
+            }
+        }
+    }
+    return result;
+}
+
 uint64_t  TransportCatalogue::CalculateRealRouteLength(const Route* route) const {
     uint64_t length = 0;
-    if (route != nullptr) {
+    if (route != nullptr && !route->stops.empty()) {
+        const size_t last_index = route->stops.size() - 1;
         // проходим по маршруту вперед
-        for (size_t n = 0;  n < (route->stops.size() - 1); ++n) {
-            const Stop* p_stop1 = route->stops.at(n);
-            const Stop* p_stop2 = route->stops.at(n + 1);
-            length += this->GetStopDistance(p_stop1, p_stop2);
-        }
+        length += GetRouteDistance(route, 0, last_index);
         // проходим по маршруту назад;
         if (route->route_type == RouteType::LINEAR) {
-            for (size_t n = 0; n < (route->stops.size() - 1); ++n) {
-                const Stop* p_stop1 = route->stops.at(route->stops.size() - 1 - n);
-                const Stop* p_stop2 = route->stops.at(route->stops.size() - 2 - n);
-                length += this->GetStopDistance(p_stop1, p_stop2);
-            }
+            length += GetRouteDistance(route, last_index, 0);
         }
     }
     return length;
 }
 
-//std::unordered_map<std::pair<const Stop*, const Stop*>, uint64_t, StopHasher<Stop>>& TransportCatalogue::GetAllDistanceBeetweenPairStops() {
-//    return distances_;
-//};
-
-std::vector<DistanceBeetweenPairStops> TransportCatalogue::GetAllDistanceBeetweenPairStops() {
-    std::vector<DistanceBeetweenPairStops> result;
-    for (auto& [pair_stops, distance] : distances_) {
-        DistanceBeetweenPairStops pair_stops_distance;
-        auto a = pair_stops.first;
-        pair_stops_distance.id_stop_from = pair_stops.first->id;
-        pair_stops_distance.id_stop_to = pair_stops.second->id;
-        pair_stops_distance.distance = distance;
-        result.push_back(pair_stops_distance);
+bool TransportCatalogue::ShareRouteStops(const TransportCatalogue& other) {
+    // после заморозки расстояний маршруты не добавляются, поэтому общий пул не изменится
+    if (!IsDistancesFrozen()) {
+        throw std::logic_error("Distances should be frozen");
     }
-    return result;
+    if (*route_stop_ids_ != *other.route_stop_ids_) {
+        return false;
+    }
+    route_stop_ids_ = other.route_stop_ids_;
+    for (Route& route : routes_) {
+        route.stops = RouteStops(route_stop_ids_.get(), &stops_, route.stops.GetOffset(), route.stops.size());
+    }
+    return true;
+}
+
+const ranges::FrozenArray<DistanceBeetweenPairStops>& TransportCatalogue::GetAllDistanceBeetweenPairStops() const {
+    return distance_list_;
 };
 
+const ranges::FrozenArray<uint64_t>& TransportCatalogue::GetRouteForwardDistances() const {
+    return route_forward_distances_;
+}
+
+const ranges::FrozenArray<uint64_t>& TransportCatalogue::GetRouteBackwardDistances() const {
+    return route_backward_distances_;
+}
+
+const StopDistances& TransportCatalogue::GetStopDistances() const {
+    return distances_;
+}
+
 uint32_t TransportCatalogue::GetNumberStops() const {
      return static_cast<uint32_t>(stops_.size());
 };
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <deque>
+#include <memory>
+#include <optional>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -8,35 +10,92 @@
 #include <vector>
 
 #include "domain.h"
+#include "frozen_array.h"
+#include "ranges.h"
+#include "name_pool.h"
+#include "spatial_index.h"
 
 namespace transport_catalogue {
 
 // типы данных -------------------------------------------------------------
-template<typename Type>
-class StopHasher {
-public:
-    size_t operator()(std::pair<const Type*, const Type*> stop) const {
-        return hasher_(stop.first) + 37 * hasher_(stop.second);
-    }
 
-private:
-    std::hash<const Type*> hasher_;
+// расстояния по дорогам в сжатом построчном формате: соседи остановки from - элементы
+// [offsets[from], offsets[from + 1]) массивов neighbours (по возрастанию id) и distances
+struct StopDistances {
+    ranges::FrozenArray<uint32_t> offsets;
+    ranges::FrozenArray<uint32_t> neighbours;
+    ranges::FrozenArray<uint32_t> distances;
+};
+
+// маршруты через остановки: id маршрутов, проходящих через остановку stop_id, - элементы
+// [offsets[stop_id], offsets[stop_id + 1]) массива route_ids по возрастанию названий маршрутов
+struct StopRoutes {
+    ranges::FrozenArray<uint32_t> offsets;
+    ranges::FrozenArray<uint32_t> route_ids;
+};
+
+// координаты остановок по id: широты и долготы в отдельных массивах и единичные векторы
+// для быстрого расчёта расстояний
+struct StopCoordinates {
+    ranges::FrozenArray<double> latitudes;
+    ranges::FrozenArray<double> longitudes;
+    geo::UnitVectors unit_vectors;
+};
+
+// справочник, собранный при make_base, в виде готовых массивов (см. TransportCatalogue::Attach).
+// Массивы могут лежать в чужой памяти, например в базе, отображённой в память
+struct FrozenCatalogue {
+    std::shared_ptr<NamePool> names; // замороженный пул названий
+    // остановки по id
+    ranges::FrozenArray<uint32_t> stop_name_ids;
+    StopCoordinates stop_coordinates;
+    // маршруты по id; остановки маршрута id - элементы [route_stop_offsets[id],
+    // route_stop_offsets[id + 1]) пула route_stop_ids
+    ranges::FrozenArray<uint32_t> route_name_ids;
+    ranges::FrozenArray<uint8_t> route_types;
+    ranges::FrozenArray<uint32_t> route_stop_offsets;
+    ranges::FrozenArray<uint32_t> route_stop_ids;
+    // расстояния после FreezeDistances: заданные без повторов, хранилище и суммы вдоль маршрутов
+    ranges::FrozenArray<DistanceBeetweenPairStops> distance_list;
+    StopDistances distances;
+    ranges::FrozenArray<uint64_t> route_forward_distances;
+    ranges::FrozenArray<uint64_t> route_backward_distances;
+    std::vector<RouteInfo> route_infos; // по id маршрутов, названия и типы заполняет Attach
+    StopRoutes stop_routes;
+    // сетка по координатам остановок и единичные векторы остановок в порядке сетки
+    geo::SpatialIndex::Data stop_grid;
+    geo::UnitVectors stop_grid_points;
 };
 
 // TransportCatalogue - класс транспортного справочника
+// Остановки и маршруты хранятся по порядку id, поэтому id должны выдаваться подряд с нуля.
 class TransportCatalogue {
 
 public:
+    using RouteIdsRange = ranges::Range<const uint32_t*>;
+
     // конструкторы ------------------------------------------------------------
     TransportCatalogue() = default;
+    // маршруты ссылаются на хранилища справочника, поэтому копировать его нельзя
+    TransportCatalogue(const TransportCatalogue&) = delete;
+    TransportCatalogue& operator=(const TransportCatalogue&) = delete;
 
     // методы ------------------------------------------------------------------
 
+    // заполняет пустой справочник готовыми массивами: массивы используются на месте, остановки и
+    // маршруты создаются одним проходом по id без поиска по названиям, таблицы не пересчитываются.
+    // После этого справочник такой же, как после FreezeDistances, BuildRouteInfos,
+    // BuildStopRoutes и BuildStopIndex. Бросает std::invalid_argument, если массивы не согласованы
+    void Attach(FrozenCatalogue catalogue);
+
     // добавление остановки в базу
-    void AddStop(const std::string &stop_name, geo::Coordinates coordinate, uint32_t stop_id);
+    void AddStop(std::string_view stop_name, geo::Coordinates coordinate, uint32_t stop_id);
     // добавление маршрута в базу
     void AddRoute(std::string_view number, RouteType type, std::vector<std::string_view> stops,
         uint16_t route_id);
+    // добавление маршрута в базу по id остановок
+    void AddRoute(std::string_view number, RouteType type, const std::vector<uint32_t>& stop_ids,
+        uint16_t route_id);
 
     // поиск остановки по имени
     const Stop* GetStopByName(std::string_view stop_name) const;
@@ -44,32 +103,104 @@ public:
     // поиск маршрута по имени
     const Route* GetRouteByName(std::string_view route_name) const;
 
+    // поиск остановки по ID
+    const Stop* GetStopById(uint32_t id) const;
+
+    // поиск маршрута по ID
+    const Route* GetRouteById(uint32_t id) const;
+
     // поиск имени остановки по ID
     std::string_view GetStopNameById(uint32_t id) const;
 
     // поиск имени маршрута по ID
     std::string_view GetRouteNameById(uint32_t id) const;
 
-    // поиск остановки по имени
-    const std::unordered_map<std::string_view, const Stop*>& GetAllStops() const;
+    // координаты всех остановок по ID
+    const StopCoordinates& GetStopCoordinates() const;
 
-    // поиск маршрута по имени
-    const std::unordered_map<std::string_view, const Route*>& GetAllRoutes() const;
+    // пул названий остановок и маршрутов
+    const NamePool& GetNames() const;
+    // загружает названия одним блоком (перед загрузкой остановок и маршрутов базы);
+    // index и sorted_ids - сохранённые при make_base хеш-функция и порядок названий
+    void LoadNames(std::string_view block, const std::vector<uint32_t>& lengths,
+        std::optional<PerfectHash::Data> index, std::vector<uint32_t> sorted_ids);
+    // фиксирует набор названий: поиск по названию идёт по совершенной хеш-функции
+    void FreezeNames();
+    // берёт замороженный пул названий other вместо своего (до добавления остановок и
+    // маршрутов); добавлять можно только остановки и маршруты с названиями из этого пула
+    void ShareNames(const TransportCatalogue& other);
+
+    // не больше count остановок, названия которых начинаются с prefix, по возрастанию
+    // названий (после FreezeNames)
+    std::vector<const Stop*> SuggestStops(std::string_view prefix, size_t count) const;
 
-    // получение информации о маршруте
+    // получение информации о маршруте из таблицы; nullptr, если маршрута нет
     const RouteInfo* GetRouteInfo(const std::string_view& route_name) const;
 
-    // возвращает список автобусов, проходящих через остановку
-    const std::set<std::string_view>* GetRoutesOnStop(const Stop* stop) const;
+    // расчёт таблицы информации о маршрутах (при make_base, после добавления всех маршрутов)
+    void BuildRouteInfos();
+    // восстановление таблицы, рассчитанной при make_base; элементы по порядку id маршрутов
+    void SetRouteInfos(std::vector<RouteInfo> route_infos);
+    const std::vector<RouteInfo>& GetRouteInfos() const;
+
+    // возвращает id маршрутов, проходящих через остановку, по возрастанию названий
+    // (после BuildStopRoutes или SetStopRoutes)
+    RouteIdsRange GetRoutesOnStop(const Stop* stop) const;
+
+    // строит списки маршрутов через остановки (при make_base, после добавления всех маршрутов)
+    void BuildStopRoutes();
+    // восстанавливает списки, построенные при make_base
+    void SetStopRoutes(StopRoutes stop_routes);
+    const StopRoutes& GetStopRoutes() const;
 
-    // задаёт дистанцию между остановками p_stop1 и p_stop2
+    // остановки не дальше radius метров от точки, не больше count ближайших (без ограничения
+    // при nullopt), по возрастанию расстояния (после BuildStopIndex или SetStopIndex)
+    std::vector<NearbyStop> FindNearbyStops(geo::Coordinates point, std::optional<double> radius,
+        std::optional<size_t> count) const;
+
+    // строит сетку по координатам остановок (при make_base, после добавления всех остановок)
+    void BuildStopIndex();
+    // восстанавливает сетку, построенную при make_base
+    void SetStopIndex(geo::SpatialIndex::Data data);
+    const geo::SpatialIndex& GetStopIndex() const;
+    // после добавления всех остановок: если их координаты по id совпадают с координатами
+    // other, берёт координаты и сетку other вместо своих и возвращает true. После сетки
+    // (своей или общей) добавлять остановки нельзя
+    bool ShareStopGeometry(const TransportCatalogue& other);
+
+    // задаёт дистанцию между остановками p_stop1 и p_stop2 (до FreezeDistances)
     void SetStopDistance(const Stop* p_stop1, const Stop* p_stop2, uint64_t distance);
 
-    // получение дистанцию между остановками p_stop1 и p_stop2
+    // строит хранилище расстояний по заданным; расстояние, заданное только в одну сторону,
+    // записывается и в обратную. После этого расстояния можно запрашивать, но не задавать.
+    void FreezeDistances();
+    bool IsDistancesFrozen() const;
+
+    // получение дистанцию между остановками p_stop1 и p_stop2; 0, если она не задана
     uint64_t GetStopDistance(const Stop* p_stop1, const Stop* p_stop2) const;
 
+    // расстояние по дорогам при проезде по маршруту от остановки с номером from_index до остановки
+    // с номером to_index; при from_index > to_index - в обратном направлении (после FreezeDistances)
+    uint64_t GetRouteDistance(const Route* route, size_t from_index, size_t to_index) const;
+
+    // кратчайшее расстояние проезда по маршруту от остановки from до остановки to в направлении
+    // движения автобуса в пределах одного рейса; nullopt, если такого проезда нет
+    std::optional<uint64_t> GetSegmentDistance(const Route* route, const Stop* from, const Stop* to) const;
+
+    // после FreezeDistances: если пул id остановок маршрутов совпадает с пулом other, маршруты
+    // переходят на пул other и возвращается true
+    bool ShareRouteStops(const TransportCatalogue& other);
+
     // получение всех расстояний между парами остановок
-    std::vector<DistanceBeetweenPairStops> GetAllDistanceBeetweenPairStops();
+    const ranges::FrozenArray<DistanceBeetweenPairStops>& GetAllDistanceBeetweenPairStops() const;
+
+    // суммы расстояний вдоль маршрутов (после FreezeDistances): вперёд и назад по ходу маршрута,
+    // индексы совпадают с пулом id остановок маршрутов
+    const ranges::FrozenArray<uint64_t>& GetRouteForwardDistances() const;
+    const ranges::FrozenArray<uint64_t>& GetRouteBackwardDistances() const;
+
+    // хранилище расстояний (после FreezeDistances)
+    const StopDistances& GetStopDistances() const;
 
     uint32_t GetNumberStops() const;
 
@@ -77,27 +208,50 @@ public:
 
 private:
     // типы данных -------------------------------------------------------
-    // остановки
+    // остановки по id; deque не перемещает элементы при росте, поэтому указатели на остановки
+    // и string_view их названий остаются действительными
     std::deque<Stop> stops_;
-    std::unordered_map<std::string_view, const Stop*> stops_by_names_;
-    // маршруты
+    // названия остановок и маршрутов; поиск по названию - через id названия. Замороженный
+    // пул, координаты, сетка и пул id остановок маршрутов не меняются, поэтому следующая
+    // версия справочника может разделять их с предыдущей (см. ShareNames и другие Share)
+    std::shared_ptr<NamePool> names_ = std::make_shared<NamePool>();
+    std::vector<uint32_t> stop_ids_by_name_id_;
+    std::vector<uint32_t> route_ids_by_name_id_;
+    std::shared_ptr<StopCoordinates> stop_coordinates_ = std::make_shared<StopCoordinates>();
+    // маршруты по id
     std::deque<Route> routes_;
-    std::unordered_map<std::string_view, const Route*> routes_by_names_;
+    // id остановок всех маршрутов подряд; маршрут хранит свой отрезок пула
+    std::shared_ptr<ranges::FrozenArray<uint32_t>> route_stop_ids_ = std::make_shared<ranges::FrozenArray<uint32_t>>();
+    // информация о маршрутах по id
+    std::vector<RouteInfo> route_infos_;
     // маршруты через каждую остановку
-    std::unordered_map<const Stop*, std::set<std::string_view>> routes_on_stops_;
-    // длина пути между остановками
-    std::unordered_map<std::pair<const Stop*, const Stop*>, uint64_t, StopHasher<Stop>> distances_;
+    StopRoutes stop_routes_;
+    // сетка по координатам остановок
+    std::shared_ptr<const geo::SpatialIndex> stop_index_;
+    // длина пути между остановками в порядке задания; после заморозки - без повторов
+    ranges::FrozenArray<DistanceBeetweenPairStops> distance_list_;
+    StopDistances distances_;
+    // расстояния от первой остановки маршрута до каждой его остановки вперёд по маршруту и
+    // назад (против хода, для некольцевых маршрутов); индексы совпадают с пулом route_stop_ids_
+    ranges::FrozenArray<uint64_t> route_forward_distances_;
+    ranges::FrozenArray<uint64_t> route_backward_distances_;
+
+    // бросает std::invalid_argument, если списки не подходят для stop_count остановок и
+    // route_count маршрутов
+    static void CheckStopRoutes(const StopRoutes& stop_routes, size_t stop_count, size_t route_count);
+    // id остановки или маршрута по названию; NamePool::NO_NAME, если такого нет
+    static uint32_t FindByNameId(const std::vector<uint32_t>& ids_by_name_id, uint32_t name_id);
 
     // считает общее расстояние по маршруту
     uint64_t CalculateRealRouteLength(const Route* route) const;
+    // считает географическое расстояние по маршруту
+    double CalculateRouteLength(const Route* route) const;
 
 }; //class TransportCatalogue
 
 // считает общее колисечтво остановок
 int CalculateStops(const Route *route) noexcept;
 // считает колисечтво уникальных остановок
-int CalculateUniqueStops(const Route *route) noexcept;
-// считает расстояние между остановками
-double CalculateRouteLength(const Route *route) noexcept;
+int CalculateUniqueStops(const Route *route);
 
 }//namespace transport_catalogue
@@ -1,5 +1,8 @@
 #include "transport_router.h"
 
+#include <algorithm>
+#include <limits>
+
 /*
 Задача поиска оптимального маршрута данного вида сводится к задаче поиска
 кратчайшего пути во взвешенном ориентированном графе.
@@ -32,23 +35,114 @@ namespace transport_router
     TransportRouter::TransportRouter(const transport_catalogue::TransportCatalogue& transport_catalogue) :
         transport_catalogue_(transport_catalogue) {}
 
-    void TransportRouter::SetRoutingSettings(const int bus_wait_time, const double bus_velocity)
+    void TransportRouter::SetRoutingSettings(const RoutingSettings& settings)
     {
-        settings_.bus_wait_time = bus_wait_time;
-        settings_.bus_velocity = bus_velocity;
+        settings_ = settings;
     }
 
     const RoutingSettings& TransportRouter::GetRoutingSettings() const {
         return settings_;
     }
 
+    void TransportRouter::SetBuildCancel(const std::atomic<bool>* cancel) {
+        build_cancel_ = cancel;
+    }
+
     void TransportRouter::InitializeGraph() {
         BuildGraph();
-        router_ = std::make_unique<graph::Router<double>>(graph_);
+        InitializeRouter();
+    }
+
+    void TransportRouter::InitializeRouter() {
+        router_.reset();
+        dijkstra_router_.reset();
+        astar_router_.reset();
+        hierarchy_router_.reset();
+        switch (settings_.router_engine) {
+            case RouterEngine::ALL_PAIRS:
+            {
+                graph::AllPairsSettings all_pairs_settings;
+                all_pairs_settings.algorithm = settings_.all_pairs_build == AllPairsBuild::DIJKSTRA
+                    ? graph::AllPairsAlgorithm::DIJKSTRA : graph::AllPairsAlgorithm::FLOYD_WARSHALL;
+                all_pairs_settings.layout = settings_.routes_table == RoutesTableFormat::COMPACT
+                    ? graph::RoutesTableLayout::COMPACT : graph::RoutesTableLayout::WIDE;
+                if (settings_.router_threads != 0) {
+                    all_pairs_settings.thread_count = settings_.router_threads;
+                }
+                // веса рёбер в секундах, в компактной таблице храним миллисекунды
+                all_pairs_settings.ticks_per_weight_unit = 1000.0;
+                all_pairs_settings.cancel = build_cancel_;
+                router_ = std::make_unique<graph::Router<double>>(graph_, all_pairs_settings);
+                break;
+            }
+            case RouterEngine::DIJKSTRA:
+                dijkstra_router_ = std::make_unique<graph::DijkstraRouter<double>>(graph_, settings_.route_cache_size);
+                break;
+            case RouterEngine::ASTAR:
+            case RouterEngine::BIDIRECTIONAL_ASTAR:
+                astar_router_ = std::make_unique<graph::AStarRouter<double>>(graph_, CreateDistanceHeuristic(),
+                    settings_.router_engine == RouterEngine::BIDIRECTIONAL_ASTAR);
+                break;
+            case RouterEngine::CONTRACTION_HIERARCHY:
+                hierarchy_router_ = std::make_unique<graph::ContractionHierarchyRouter<double>>(graph_, build_cancel_);
+                break;
+        }
+    }
+
+    std::optional<graph::Router<double>::RouteInfo> TransportRouter::BuildRoute(graph::VertexId from, graph::VertexId to) const {
+        if (dijkstra_router_) {
+            return dijkstra_router_->BuildRoute(from, to);
+        }
+        if (astar_router_) {
+            return astar_router_->BuildRoute(from, to);
+        }
+        if (hierarchy_router_) {
+            return hierarchy_router_->BuildRoute(from, to);
+        }
+        return router_->BuildRoute(from, to);
     }
 
-    std::optional<std::vector<RouteData>> TransportRouter::CreatRoute(const std::string_view from, const std::string_view to) {
-        std::optional<graph::Router<double>::RouteInfo> route_info = router_->BuildRoute(
+    graph::AStarRouter<double>::Heuristic TransportRouter::CreateDistanceHeuristic() const {
+        // координаты берутся из массивов справочника по id остановки вершины
+        const transport_catalogue::StopCoordinates& coordinates = transport_catalogue_.GetStopCoordinates();
+        // вершина без остановки (NO_STOP) получает оценку 0
+        constexpr uint32_t NO_STOP = std::numeric_limits<uint32_t>::max();
+        std::vector<uint32_t> vertex_stop_ids;
+        vertex_stop_ids.reserve(graph_.GetVertexCount());
+        for (const Stop* stop : GetVertexStops()) {
+            vertex_stop_ids.push_back(stop != nullptr ? stop->id : NO_STOP);
+        }
+        const auto distance_between = [&coordinates](uint32_t from, uint32_t to) {
+            if (from == NO_STOP || to == NO_STOP) {
+                return 0.0;
+            }
+            return geo::ComputeDistance(coordinates.unit_vectors[from], coordinates.unit_vectors[to]);
+        };
+        // расстояние по дорогам может быть и короче расстояния по прямой, поэтому вместо скорости
+        // автобуса берём наименьшее по всем рёбрам отношение времени к расстоянию по прямой:
+        // тогда оценка не больше веса любого ребра и по неравенству треугольника согласована
+        double seconds_per_meter = std::numeric_limits<double>::max();
+        for (const auto& edge : graph_.GetEdges()) {
+            const double distance = distance_between(vertex_stop_ids[edge.from], vertex_stop_ids[edge.to]);
+            if (distance > 0.0) {
+                seconds_per_meter = std::min(seconds_per_meter, edge.weight / distance);
+            }
+        }
+        if (seconds_per_meter == std::numeric_limits<double>::max()) {
+            return nullptr;
+        }
+        // запас на погрешность вычисления расстояний
+        seconds_per_meter *= 1.0 - 1e-9;
+
+        return [distance_between, vertex_stop_ids = std::move(vertex_stop_ids), seconds_per_meter](
+                   graph::VertexId from, graph::VertexId to) {
+            const double distance = distance_between(vertex_stop_ids[from], vertex_stop_ids[to]);
+            return distance > 0.0 ? distance * seconds_per_meter : 0.0;
+        };
+    }
+
+    std::optional<std::vector<RouteData>> TransportRouter::CreatRoute(const std::string_view from, const std::string_view to) const {
+        std::optional<graph::Router<double>::RouteInfo> route_info = BuildRoute(
                 transport_catalogue_.GetStopByName(from)->id, transport_catalogue_.GetStopByName(to)->id);
 
         if (route_info == std::nullopt) {
@@ -63,27 +157,203 @@ namespace transport_router
     }
 
     void TransportRouter::BuildGraph() {
-        Graph graph(transport_catalogue_.GetAllStops().size());
-        const std::unordered_map <std::string_view, const Route*>& all_buses = transport_catalogue_.GetAllRoutes();
-        for (const auto& [bus_name, struct_bus] : all_buses) {
-            CreateEdgesAlongRoute(graph, struct_bus->stops.begin(), struct_bus->stops.end(), bus_name);
-            if (struct_bus->route_type == RouteType::LINEAR) {
-                CreateEdgesAlongRoute(graph, struct_bus->stops.rbegin(), struct_bus->stops.rend(), bus_name);
+        const uint32_t route_count = transport_catalogue_.GetNumberRoutes();
+        const bool bus_states = settings_.graph_model == GraphModel::STOP_BUS_STATES;
+        const std::vector<graph::VertexId> first_vertices = GetRouteFirstVertices();
+
+        // рёбра маршрутов не зависят друг от друга и строятся параллельно,
+        // а в граф добавляются по порядку id маршрутов
+        std::vector<Edges> route_edges(route_count);
+        thread_pool::ThreadPool pool(settings_.router_threads != 0
+            ? settings_.router_threads : thread_pool::ThreadPool::DefaultThreadCount());
+        pool.ParallelFor(route_count, [&](size_t id, size_t) {
+            const Route &route = *transport_catalogue_.GetRouteById(static_cast<uint32_t>(id));
+            const bool linear = route.route_type == RouteType::LINEAR;
+            if (bus_states) {
+                CreateStatesAlongRoute(route, false, first_vertices[id], route_edges[id]);
+                if (linear) {
+                    CreateStatesAlongRoute(route, true, first_vertices[id] + route.stops.size(), route_edges[id]);
+                }
+            } else {
+                CreateEdgesAlongRoute(route, false, route_edges[id]);
+                if (linear) {
+                    CreateEdgesAlongRoute(route, true, route_edges[id]);
+                }
+            }
+        });
+
+        Graph graph(first_vertices.back());
+        for (const Edges &edges : route_edges) {
+            for (const auto &edge : edges) {
+                graph.AddEdge(edge);
+            }
+        }
+        graph.Freeze();
+        graph_ = std::move(graph);
+        RestoreRouteVertices();
+    }
+
+    void TransportRouter::CreateEdgesAlongRoute(const Route &route, bool reverse, Edges &edges) const {
+        const size_t stop_count = route.stops.size();
+        // номер остановки в маршруте по номеру в направлении движения
+        const auto position = [stop_count, reverse](size_t n) { return reverse ? stop_count - 1 - n : n; };
+        for (size_t from = 0; from < stop_count; ++from) {
+            const uint32_t from_stop = route.stops[position(from)]->id;
+            for (size_t to = from + 1; to < stop_count; ++to) {
+                edges.push_back({from_stop, route.stops[position(to)]->id,
+                                 GetRideWeight(route, position(from), position(to)),
+                                 static_cast<uint32_t>(to - from), route.id});
             }
         }
+    }
+
+    double TransportRouter::GetRideWeight(const Route &route, size_t from_index, size_t to_index) const {
+        const double wait = settings_.bus_wait_time * MIN_TO_SECONDS;          // переводим время в секунды
+        const double bus_speed = settings_.bus_velocity / KM_PER_H_TO_M_PER_S; // переводим скорость в м/с
+        const double lenght = static_cast<double>(transport_catalogue_.GetRouteDistance(&route, from_index, to_index));
+        return lenght / bus_speed + wait;
+    }
+
+    double TransportRouter::GetMotionTime(double ride_weight) const {
+        return (ride_weight - settings_.bus_wait_time * MIN_TO_SECONDS) / MIN_TO_SECONDS;
+    }
+
+    void TransportRouter::CreateStatesAlongRoute(const Route &route, bool reverse, graph::VertexId first_vertex,
+                                                 Edges &edges) const {
+        const double wait = settings_.bus_wait_time * MIN_TO_SECONDS;          // переводим время в секунды
+        const double bus_speed = settings_.bus_velocity / KM_PER_H_TO_M_PER_S; // переводим скорость в м/с
+
+        const size_t stop_count = route.stops.size();
+        const auto position = [stop_count, reverse](size_t n) { return reverse ? stop_count - 1 - n : n; };
+        for (size_t n = 0; n < stop_count; ++n) {
+            const uint32_t stop_vertex = route.stops[position(n)]->id;
+            const uint32_t state_vertex = static_cast<uint32_t>(first_vertex + n);
+            if (n != 0) {
+                // высадка
+                edges.push_back({state_vertex, stop_vertex, 0.0, 0, route.id});
+            }
+            if (n + 1 != stop_count) {
+                // посадка и поездка до следующей остановки
+                const double lenght = static_cast<double>(
+                    transport_catalogue_.GetRouteDistance(&route, position(n), position(n + 1)));
+                edges.push_back({stop_vertex, state_vertex, wait, 0, route.id});
+                edges.push_back({state_vertex, state_vertex + 1, lenght / bus_speed, 1, route.id});
+            }
+        }
+    }
+
+    void TransportRouter::SetGraph(Graph graph, RoutesInternalData routes_internal_data) {
+        graph_ = std::move(graph);
+        RestoreRouteVertices();
+        dijkstra_router_.reset();
+        astar_router_.reset();
+        hierarchy_router_.reset();
+        router_ = std::make_unique<graph::Router<double>>(graph_, std::move(routes_internal_data));
+    }
+
+    void TransportRouter::SetGraph(Graph graph, Hierarchy hierarchy) {
         graph_ = std::move(graph);
+        RestoreRouteVertices();
+        router_.reset();
+        dijkstra_router_.reset();
+        astar_router_.reset();
+        hierarchy_router_ = std::make_unique<graph::ContractionHierarchyRouter<double>>(graph_, std::move(hierarchy));
     }
 
     void TransportRouter::SetGraph(const Graph& graph) {
         graph_ = graph;
-        router_ = std::make_unique<graph::Router<double>>(graph_);
+        RestoreRouteVertices();
+        InitializeRouter();
     }
 
-    std::shared_ptr<Graph> TransportRouter::GetGraph() const {
-        return std::make_shared<Graph>(graph_);
+    const TransportRouter::RoutesInternalData& TransportRouter::GetRoutesInternalData() const {
+        return router_->GetRoutesInternalData();
+    }
+
+    const TransportRouter::Hierarchy& TransportRouter::GetHierarchy() const {
+        return hierarchy_router_->GetHierarchy();
+    }
+
+    const graph::Router<double>::BuildStatistics* TransportRouter::GetBuildStatistics() const {
+        return router_ ? &router_->GetBuildStatistics() : nullptr;
+    }
+
+    const graph::ContractionHierarchyRouter<double>::BuildStatistics* TransportRouter::GetHierarchyBuildStatistics() const {
+        return hierarchy_router_ ? &hierarchy_router_->GetBuildStatistics() : nullptr;
+    }
+
+    std::optional<graph::SearchStatistics> TransportRouter::GetSearchStatistics() const {
+        if (dijkstra_router_) {
+            return dijkstra_router_->GetSearchStatistics();
+        }
+        if (astar_router_) {
+            return astar_router_->GetSearchStatistics();
+        }
+        if (hierarchy_router_) {
+            return hierarchy_router_->GetSearchStatistics();
+        }
+        return std::nullopt;
+    }
+
+    std::vector<graph::VertexId> TransportRouter::GetRouteFirstVertices() const {
+        const uint32_t route_count = transport_catalogue_.GetNumberRoutes();
+        const bool bus_states = settings_.graph_model == GraphModel::STOP_BUS_STATES;
+        std::vector<graph::VertexId> first_vertices(route_count + 1, transport_catalogue_.GetNumberStops());
+        for (uint32_t id = 0; id < route_count; ++id) {
+            const Route *route = transport_catalogue_.GetRouteById(id);
+            const size_t route_vertices = bus_states
+                ? route->stops.size() * (route->route_type == RouteType::LINEAR ? 2 : 1) : 0;
+            first_vertices[id + 1] = first_vertices[id] + route_vertices;
+        }
+        return first_vertices;
+    }
+
+    std::vector<const Stop*> TransportRouter::GetVertexStops() const {
+        std::vector<const Stop*> vertex_stops(graph_.GetVertexCount(), nullptr);
+        for (uint32_t id = 0; id < transport_catalogue_.GetNumberStops(); ++id) {
+            vertex_stops.at(id) = transport_catalogue_.GetStopById(id);
+        }
+        if (settings_.graph_model != GraphModel::STOP_BUS_STATES) {
+            return vertex_stops;
+        }
+        // вершины "в автобусе" идут в том же порядке, что и в BuildGraph: по маршрутам, для каждого
+        // направления по остановкам в направлении движения. Рёбра для этого не подходят: у маршрута
+        // из одной остановки вершина "в автобусе" без рёбер
+        graph::VertexId vertex = transport_catalogue_.GetNumberStops();
+        for (uint32_t id = 0; id < transport_catalogue_.GetNumberRoutes(); ++id) {
+            const Route* route = transport_catalogue_.GetRouteById(id);
+            const size_t stop_count = route->stops.size();
+            for (size_t n = 0; n < stop_count; ++n) {
+                vertex_stops.at(vertex++) = route->stops[n];
+            }
+            if (route->route_type == RouteType::LINEAR) {
+                for (size_t n = 0; n < stop_count; ++n) {
+                    vertex_stops.at(vertex++) = route->stops[stop_count - 1 - n];
+                }
+            }
+        }
+        return vertex_stops;
+    }
+
+    void TransportRouter::RestoreRouteVertices() {
+        route_first_vertices_ = GetRouteFirstVertices();
+        if (route_first_vertices_.back() != graph_.GetVertexCount()) {
+            throw std::invalid_argument("Graph does not match routes");
+        }
+    }
+
+    bool TransportRouter::IsStopVertex(graph::VertexId vertex) const {
+        return vertex < transport_catalogue_.GetNumberStops();
+    }
+
+    const Graph &TransportRouter::GetGraph() const {
+        return graph_;
     }
 
     std::vector<RouteData> TransportRouter::CreateAnswer(const std::optional<graph::Router<double>::RouteInfo>& route_info) const {
+        if (settings_.graph_model == GraphModel::STOP_BUS_STATES) {
+            return CreateStatesAnswer(route_info.value());
+        }
         double total_time = 0.0;
         std::vector<RouteData> route_data;
 
@@ -91,11 +361,12 @@ namespace transport_router
             route_data.push_back(std::move(CreateStopAnswer(edge_index)));
             total_time += settings_.bus_wait_time;
 
-            if (edges_[edge_index].first == edges_[edge_index].second) {
+            const auto& edge = graph_.GetEdge(edge_index);
+            if (GetVertexStopName(edge.from, edge.bus_name_id) == GetVertexStopName(edge.to, edge.bus_name_id)) {
                 continue;
             }
 
-            double time = (graph_.GetEdge(edge_index).weight - settings_.bus_wait_time * MIN_TO_SECONDS) / MIN_TO_SECONDS;
+            double time = GetMotionTime(edge.weight);
             total_time += time;
 
             route_data.push_back(std::move(CreateBusAnswer(edge_index, time)));
@@ -103,6 +374,49 @@ namespace transport_router
         return route_data;
     }
 
+    std::vector<RouteData> TransportRouter::CreateStatesAnswer(const graph::Router<double>::RouteInfo& route_info) const {
+        std::vector<RouteData> route_data;
+        RouteData bus_answer;
+        // номер остановки посадки в маршруте
+        size_t board_index = 0;
+
+        for (size_t edge_index : route_info.edges) {
+            const auto& edge = graph_.GetEdge(edge_index);
+            if (IsStopVertex(edge.from)) {
+                // посадка: ожидание на остановке
+                route_data.push_back(std::move(CreateStopAnswer(edge_index)));
+                bus_answer = CreateBusAnswer(edge_index, 0.0);
+                board_index = GetStateStopIndex(edge.to, edge.bus_name_id);
+            } else if (IsStopVertex(edge.to)) {
+                // высадка: время поездки считается по расстоянию между остановками так же, как
+                // для ребра модели STOP_PAIRS, а не суммой весов перегонов, иначе ответы моделей
+                // расходятся в последних знаках
+                const Route& route = *transport_catalogue_.GetRouteById(edge.bus_name_id);
+                bus_answer.motion_time = GetMotionTime(
+                    GetRideWeight(route, board_index, GetStateStopIndex(edge.from, edge.bus_name_id)));
+                route_data.push_back(std::move(bus_answer));
+            } else {
+                // поездка до следующей остановки
+                bus_answer.span_count += edge.span_count;
+            }
+        }
+        return route_data;
+    }
+
+    size_t TransportRouter::GetStateStopIndex(graph::VertexId vertex, uint32_t route_id) const {
+        const size_t stop_count = transport_catalogue_.GetRouteById(route_id)->stops.size();
+        const size_t offset = vertex - route_first_vertices_[route_id];
+        // вершины обратного направления идут после вершин прямого
+        return offset < stop_count ? offset : 2 * stop_count - 1 - offset;
+    }
+
+    std::string_view TransportRouter::GetVertexStopName(graph::VertexId vertex, uint32_t route_id) const {
+        if (IsStopVertex(vertex)) {
+            return transport_catalogue_.GetStopNameById(vertex);
+        }
+        return transport_catalogue_.GetRouteById(route_id)->stops[GetStateStopIndex(vertex, route_id)]->name;
+    }
+
     RouteData TransportRouter::CreateBusAnswer(size_t edge_index, double time) const {
         RouteData bus_answer;
         bus_answer.type = "bus"sv;
@@ -115,7 +429,8 @@ namespace transport_router
     RouteData TransportRouter::CreateStopAnswer(size_t edge_index) const {
         RouteData stop_answer;
         stop_answer.type = "stop"sv;
-        stop_answer.stop_name = edges_[edge_index].first;
+        const auto& edge = graph_.GetEdge(edge_index);
+        stop_answer.stop_name = GetVertexStopName(edge.from, edge.bus_name_id);
         stop_answer.bus_wait_time = settings_.bus_wait_time;
         return stop_answer;
     }
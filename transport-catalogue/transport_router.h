@@ -1,10 +1,12 @@
 #pragma once
+#include <atomic>
 #include <memory>
 #include <iostream>
 
 #include "transport_catalogue.h"
 #include "domain.h"
 #include "router.h"
+#include "contraction_hierarchy.h"
 
 #define MIN_TO_SECONDS 60
 #define KM_PER_H_TO_M_PER_S 3.6
@@ -18,60 +20,90 @@ namespace transport_router
     class TransportRouter
     {
     public:
-        using EdgesList = std::vector<std::pair<std::string_view, std::string_view>>;
+        using Edges = std::vector<graph::Edge<double>>;
+        using RoutesInternalData = graph::Router<double>::RoutesInternalData;
+        using Hierarchy = graph::ContractionHierarchyRouter<double>::Hierarchy;
 
         TransportRouter(const transport_catalogue::TransportCatalogue &transport_catalogue);
 
-        void SetRoutingSettings(const int bus_wait_time, const double bus_velocity);
+        void SetRoutingSettings(const RoutingSettings &settings);
         const RoutingSettings &GetRoutingSettings() const;
+        // флаг отмены построения таблицы всех пар или иерархии сжатия: при его установке
+        // InitializeGraph и SetGraph бросают graph::BuildCancelled
+        void SetBuildCancel(const std::atomic<bool> *cancel);
 
         void InitializeGraph();
 
-        std::optional<std::vector<RouteData>> CreatRoute(const std::string_view from, const std::string_view to);
+        std::optional<std::vector<RouteData>> CreatRoute(const std::string_view from, const std::string_view to) const;
 
+        // восстанавливает граф и таблицы маршрутизатора, рассчитанные при make_base
+        void SetGraph(Graph graph, RoutesInternalData routes_internal_data);
+        void SetGraph(Graph graph, Hierarchy hierarchy);
         void SetGraph(const Graph &graph);
-        std::shared_ptr<Graph> GetGraph() const;
+        const Graph &GetGraph() const;
+
+        const RoutesInternalData &GetRoutesInternalData() const;
+        const Hierarchy &GetHierarchy() const;
+        // статистика построения иерархии сжатия; nullptr, если иерархия не строилась
+        const graph::ContractionHierarchyRouter<double>::BuildStatistics *GetHierarchyBuildStatistics() const;
+        // статистика построения таблицы маршрутов; nullptr, если таблица не строилась
+        const graph::Router<double>::BuildStatistics *GetBuildStatistics() const;
+        // статистика поиска маршрутов по запросу; nullopt для таблицы всех пар
+        std::optional<graph::SearchStatistics> GetSearchStatistics() const;
 
     private:
         const transport_catalogue::TransportCatalogue &transport_catalogue_;
         RoutingSettings settings_;
+        const std::atomic<bool> *build_cancel_ = nullptr;
         Graph graph_;
         std::unique_ptr<graph::Router<double>> router_ = nullptr;
+        std::unique_ptr<graph::DijkstraRouter<double>> dijkstra_router_ = nullptr;
+        std::unique_ptr<graph::AStarRouter<double>> astar_router_ = nullptr;
+        std::unique_ptr<graph::ContractionHierarchyRouter<double>> hierarchy_router_ = nullptr;
 
-        EdgesList edges_;
+        // первая вершина "в автобусе" каждого маршрута по id и число вершин графа последним элементом
+        std::vector<graph::VertexId> route_first_vertices_;
 
         void BuildGraph();
+        // создаёт маршрутизатор, выбранный в настройках
+        void InitializeRouter();
+        std::optional<graph::Router<double>::RouteInfo> BuildRoute(graph::VertexId from, graph::VertexId to) const;
+        // восстанавливает первые вершины маршрутов по загруженному графу; рёбра не перебираются,
+        // поэтому граф может оставаться в чужой памяти
+        void RestoreRouteVertices();
+        // вершины остановок, а в модели STOP_BUS_STATES затем по вершине на каждую остановку
+        // каждого направления маршрута; элемент id - первая вершина маршрута
+        std::vector<graph::VertexId> GetRouteFirstVertices() const;
+        // остановка каждой вершины графа
+        std::vector<const Stop *> GetVertexStops() const;
+        // оценка снизу времени пути между вершинами по расстоянию между их остановками
+        graph::AStarRouter<double>::Heuristic CreateDistanceHeuristic() const;
 
         std::vector<RouteData> CreateAnswer(const std::optional<graph::Router<double>::RouteInfo> &route_info) const;
+        // ответ для модели STOP_BUS_STATES: посадка, поездка по перегонам и высадка сворачиваются в Wait и Bus
+        std::vector<RouteData> CreateStatesAnswer(const graph::Router<double>::RouteInfo &route_info) const;
+        // вершина графа - ожидание на остановке (id вершины совпадает с id остановки)
+        bool IsStopVertex(graph::VertexId vertex) const;
+        // номер в маршруте route_id остановки вершины "в автобусе" этого маршрута
+        size_t GetStateStopIndex(graph::VertexId vertex, uint32_t route_id) const;
+        // название остановки вершины графа
+        std::string_view GetVertexStopName(graph::VertexId vertex, uint32_t route_id) const;
 
         RouteData CreateBusAnswer(size_t edge_index, double time) const;
         RouteData CreateStopAnswer(size_t edge_index) const;
         RouteData CreateEmptyAnswer() const;
 
-        template <typename Begin, typename End>
-        void CreateEdgesAlongRoute(Graph &graph, const Begin begin, const End end, std::string_view bus_name);
+        // вес ребра модели STOP_PAIRS в секундах: ожидание и поездка по маршруту от остановки
+        // с номером from_index до остановки с номером to_index
+        double GetRideWeight(const Route &route, size_t from_index, size_t to_index) const;
+        // время поездки в минутах по весу ребра модели STOP_PAIRS
+        double GetMotionTime(double ride_weight) const;
+        // рёбра между всеми парами остановок одного направления маршрута; reverse - обратное направление
+        void CreateEdgesAlongRoute(const Route &route, bool reverse, Edges &edges) const;
+        // вершины "в автобусе на остановке" одного направления маршрута начиная с first_vertex
+        // и рёбра посадки, поездки и высадки
+        void CreateStatesAlongRoute(const Route &route, bool reverse, graph::VertexId first_vertex,
+                                    Edges &edges) const;
     };
 
-    template <typename Begin, typename End>
-    void TransportRouter::CreateEdgesAlongRoute(Graph &graph, const Begin begin, const End end, std::string_view bus_name)
-    {
-        const double wait = settings_.bus_wait_time * MIN_TO_SECONDS;          // переводим время в секунды
-        const double bus_speed = settings_.bus_velocity / KM_PER_H_TO_M_PER_S; // переводим скорость в м/с
-
-        for (auto it_stop = begin; it_stop < end; ++it_stop)
-        {
-            uint32_t span_count = 1;
-            double current_lenght = 0.0;
-            for (auto from_stop = it_stop, to_stop = from_stop + 1; to_stop != end; ++from_stop, ++to_stop)
-            {
-                std::optional<double> lenght = transport_catalogue_.GetStopDistance(*from_stop, *to_stop);
-                current_lenght += lenght.value();
-                double time_weight = current_lenght / bus_speed + wait;
-                graph.AddEdge({(*it_stop)->id, (*to_stop)->id, time_weight, span_count, transport_catalogue_.GetRouteByName(bus_name)->id});
-                edges_.push_back({(*it_stop)->name, (*to_stop)->name});
-                ++span_count;
-            }
-        }
-    }
-
 } // namespace transport_router
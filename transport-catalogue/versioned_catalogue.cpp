@@ -0,0 +1,304 @@
+#include "versioned_catalogue.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace versioned_catalogue {
+
+using transport_catalogue::NamePool;
+using transport_catalogue::TransportCatalogue;
+using transport_router::TransportRouter;
+
+namespace {
+
+constexpr uint32_t NO_STOP = std::numeric_limits<uint32_t>::max();
+
+// изменения по названиям; при повторе названия действует последнее изменение
+template <typename Change>
+std::unordered_map<std::string_view, const Change*> IndexChanges(const std::vector<Change>& changes) {
+    std::unordered_map<std::string_view, const Change*> result;
+    for (const Change& change : changes) {
+        result[change.name] = &change;
+    }
+    return result;
+}
+
+template <typename Change>
+std::unordered_set<std::string_view> IndexClosed(const std::vector<std::string>& closed,
+        const std::unordered_map<std::string_view, const Change*>& changes, const char* kind) {
+    std::unordered_set<std::string_view> result;
+    for (const std::string& name : closed) {
+        if (changes.count(name) > 0) {
+            throw std::invalid_argument(std::string(kind) + " is both changed and closed: " + name);
+        }
+        result.insert(name);
+    }
+    return result;
+}
+
+const Stop* FindStop(const TransportCatalogue& catalogue, std::string_view name) {
+    const Stop* stop = catalogue.GetStopByName(name);
+    if (stop == nullptr) {
+        throw std::invalid_argument("Unknown stop: " + std::string(name));
+    }
+    return stop;
+}
+
+}  // namespace
+
+VersionedCatalogue::VersionedCatalogue(const TransportCatalogue& base, const TransportRouter& base_router)
+    : settings_(base_router.GetRoutingSettings())
+{
+    auto version = std::make_shared<Version>();
+    // справочник и маршрутизатор базы принадлежат вызывающему, поэтому без удаления
+    version->catalogue = std::shared_ptr<const TransportCatalogue>(&base, [](const TransportCatalogue*) {});
+    version->router = std::shared_ptr<const TransportRouter>(&base_router, [](const TransportRouter*) {});
+    current_ = std::move(version);
+    if (IsBuiltInBackground()) {
+        build_thread_ = std::thread([this] { BuildLoop(); });
+    }
+}
+
+VersionedCatalogue::~VersionedCatalogue() {
+    {
+        const std::lock_guard lock(build_mutex_);
+        build_stop_ = true;
+        build_cancel_ = true;
+    }
+    build_cv_.notify_one();
+    if (build_thread_.joinable()) {
+        build_thread_.join();
+    }
+}
+
+std::shared_ptr<const Version> VersionedCatalogue::Acquire() const {
+    return std::atomic_load(&current_);
+}
+
+uint64_t VersionedCatalogue::Apply(const CatalogueUpdate& update) {
+    const std::lock_guard lock(write_mutex_);
+    const std::shared_ptr<const Version> current = Acquire();
+
+    // вся сборка - до публикации: читатели продолжают работать с текущей версией
+    std::shared_ptr<TransportCatalogue> catalogue;
+    std::shared_ptr<TransportRouter> router;
+    try {
+        catalogue = BuildCatalogue(*current->catalogue, update);
+        router = std::make_shared<TransportRouter>(*catalogue);
+        RoutingSettings settings = settings_;
+        if (IsBuiltInBackground()) {
+            // поиск Дейкстры не требует предварительных расчётов
+            settings.router_engine = RouterEngine::DIJKSTRA;
+        }
+        router->SetRoutingSettings(settings);
+        router->InitializeGraph();
+    } catch (const std::invalid_argument&) {
+        throw;
+    } catch (const std::logic_error& error) {
+        // ошибки, которые не нашла проверка изменений (например, в справочнике или графе),
+        // - тоже ошибки в изменениях: текущая версия остаётся
+        throw std::invalid_argument(error.what());
+    }
+
+    auto next = std::make_shared<Version>();
+    next->number = current->number + 1;
+    next->catalogue = std::move(catalogue);
+    next->router = std::move(router);
+    const uint64_t number = next->number;
+    std::shared_ptr<const Version> published(std::move(next));
+    std::atomic_store(&current_, published);
+
+    if (IsBuiltInBackground()) {
+        {
+            const std::lock_guard build_lock(build_mutex_);
+            build_pending_ = std::move(published);
+            // построение для прежней версии больше не нужно
+            build_cancel_ = true;
+        }
+        build_cv_.notify_one();
+    }
+    return number;
+}
+
+bool VersionedCatalogue::IsBuiltInBackground() const {
+    return settings_.router_engine == RouterEngine::ALL_PAIRS
+        || settings_.router_engine == RouterEngine::CONTRACTION_HIERARCHY;
+}
+
+void VersionedCatalogue::BuildLoop() {
+    while (true) {
+        std::shared_ptr<const Version> version;
+        {
+            std::unique_lock lock(build_mutex_);
+            build_cv_.wait(lock, [this] { return build_stop_ || build_pending_; });
+            if (build_stop_) {
+                return;
+            }
+            version = std::move(build_pending_);
+            build_pending_.reset();
+            build_cancel_ = false;
+        }
+
+        std::shared_ptr<const TransportRouter> router;
+        try {
+            router = BuildRouter(*version);
+        } catch (const std::exception&) {
+            // построение отменено выходом следующей версии (graph::BuildCancelled) или
+            // невозможно, например таблица не помещается в компактный формат: версия
+            // остаётся с поиском Дейкстры
+            continue;
+        }
+
+        const std::lock_guard lock(write_mutex_);
+        // версия могла смениться, пока строился маршрутизатор
+        if (Acquire() != version) {
+            continue;
+        }
+        auto upgraded = std::make_shared<Version>();
+        upgraded->number = version->number;
+        upgraded->catalogue = version->catalogue;
+        upgraded->router = std::move(router);
+        std::atomic_store(&current_, std::shared_ptr<const Version>(std::move(upgraded)));
+    }
+}
+
+std::shared_ptr<const TransportRouter> VersionedCatalogue::BuildRouter(const Version& version) const {
+    auto router = std::make_shared<TransportRouter>(*version.catalogue);
+    router->SetRoutingSettings(settings_);
+    router->SetBuildCancel(&build_cancel_);
+    // граф тот же, что у маршрутизатора версии: строится по тому же справочнику и настройкам
+    router->SetGraph(version.router->GetGraph());
+    router->SetBuildCancel(nullptr);
+    return router;
+}
+
+std::shared_ptr<TransportCatalogue> VersionedCatalogue::BuildCatalogue(const TransportCatalogue& previous,
+        const CatalogueUpdate& update) {
+    const auto stop_changes = IndexChanges(update.stops);
+    const auto route_changes = IndexChanges(update.routes);
+    const auto closed_stops = IndexClosed(update.closed_stops, stop_changes, "Stop");
+    const auto closed_routes = IndexClosed(update.closed_routes, route_changes, "Route");
+    for (const std::string_view name : closed_stops) {
+        FindStop(previous, name);
+    }
+    for (const std::string_view name : closed_routes) {
+        if (previous.GetRouteByName(name) == nullptr) {
+            throw std::invalid_argument("Unknown route: " + std::string(name));
+        }
+    }
+
+    auto catalogue = std::make_shared<TransportCatalogue>();
+    // пул названий прежней версии заморожен; его можно взять целиком, если изменения не
+    // добавляют названий (закрытые остановки и маршруты просто не находятся по названию)
+    const NamePool& previous_names = previous.GetNames();
+    const auto is_known = [&previous_names](const auto& change) {
+        return previous_names.Find(change.name) != NamePool::NO_NAME;
+    };
+    if (std::all_of(update.stops.begin(), update.stops.end(), is_known)
+            && std::all_of(update.routes.begin(), update.routes.end(), is_known)) {
+        catalogue->ShareNames(previous);
+    }
+
+    // остановки: прежние по порядку id без закрытых (заменённые - на своём месте), затем новые
+    std::vector<uint32_t> stop_ids(previous.GetNumberStops(), NO_STOP);
+    for (uint32_t id = 0; id < previous.GetNumberStops(); ++id) {
+        const Stop* stop = previous.GetStopById(id);
+        if (closed_stops.count(stop->name) > 0) {
+            continue;
+        }
+        const auto change = stop_changes.find(stop->name);
+        stop_ids[id] = catalogue->GetNumberStops();
+        catalogue->AddStop(stop->name, change != stop_changes.end() ? change->second->coordinates : stop->coordinate,
+                           stop_ids[id]);
+    }
+    for (const StopChange& change : update.stops) {
+        if (stop_changes.at(change.name) == &change && previous.GetStopByName(change.name) == nullptr) {
+            catalogue->AddStop(change.name, change.coordinates, catalogue->GetNumberStops());
+        }
+    }
+
+    // расстояния: заданные прежде, кроме расстояний от заменённых и от закрытых остановок,
+    // затем заданные в изменениях
+    for (const DistanceBeetweenPairStops& distance : previous.GetAllDistanceBeetweenPairStops()) {
+        const uint32_t from = stop_ids[distance.id_stop_from];
+        const uint32_t to = stop_ids[distance.id_stop_to];
+        if (from == NO_STOP || to == NO_STOP
+                || stop_changes.count(previous.GetStopById(distance.id_stop_from)->name) > 0) {
+            continue;
+        }
+        catalogue->SetStopDistance(catalogue->GetStopById(from), catalogue->GetStopById(to), distance.distance);
+    }
+    for (const auto& [name, change] : stop_changes) {
+        const Stop* from = catalogue->GetStopByName(name);
+        for (const auto& [to_name, distance] : change->road_distances) {
+            // расстояния хранятся в 32 битах; отрицательное расстояние из JSON здесь уже очень большое
+            if (distance > std::numeric_limits<uint32_t>::max()) {
+                throw std::invalid_argument("Distance between stops is out of range: " + std::string(name) + " - "
+                                            + to_name);
+            }
+            catalogue->SetStopDistance(from, FindStop(*catalogue, to_name), distance);
+        }
+    }
+
+    // маршруты: прежние по порядку id без закрытых (заменённые - на своём месте), затем новые
+    const auto add_route = [&catalogue](std::string_view name, RouteType type, const std::vector<uint32_t>& ids) {
+        if (catalogue->GetNumberRoutes() > std::numeric_limits<uint16_t>::max()) {
+            throw std::invalid_argument("Too many routes");
+        }
+        catalogue->AddRoute(name, type, ids, static_cast<uint16_t>(catalogue->GetNumberRoutes()));
+    };
+    const auto add_changed_route = [&catalogue, &add_route](const RouteChange& change) {
+        if (change.stops.empty()) {
+            throw std::invalid_argument("Route has no stops: " + change.name);
+        }
+        std::vector<uint32_t> ids;
+        ids.reserve(change.stops.size());
+        for (const std::string& stop_name : change.stops) {
+            ids.push_back(FindStop(*catalogue, stop_name)->id);
+        }
+        add_route(change.name, change.type, ids);
+    };
+    for (uint32_t id = 0; id < previous.GetNumberRoutes(); ++id) {
+        const Route* route = previous.GetRouteById(id);
+        if (closed_routes.count(route->name) > 0) {
+            continue;
+        }
+        if (const auto change = route_changes.find(route->name); change != route_changes.end()) {
+            add_changed_route(*change->second);
+            continue;
+        }
+        std::vector<uint32_t> ids;
+        ids.reserve(route->stops.size());
+        for (const uint32_t* stop_id = route->stops.GetIds(); stop_id != route->stops.GetIds() + route->stops.size(); ++stop_id) {
+            if (stop_ids[*stop_id] == NO_STOP) {
+                throw std::invalid_argument("Route " + std::string(route->name) + " passes closed stop "
+                                            + std::string(previous.GetStopById(*stop_id)->name));
+            }
+            ids.push_back(stop_ids[*stop_id]);
+        }
+        add_route(route->name, route->route_type, ids);
+    }
+    for (const RouteChange& change : update.routes) {
+        if (route_changes.at(change.name) == &change && previous.GetRouteByName(change.name) == nullptr) {
+            add_changed_route(change);
+        }
+    }
+
+    // та же подготовка, что при make_base; неизменившиеся координаты с сеткой и пул остановок
+    // маршрутов берутся у прежней версии. Отдельные маршруты не разделяются: это отрезки пула
+    catalogue->FreezeNames();
+    catalogue->FreezeDistances();
+    catalogue->ShareRouteStops(previous);
+    catalogue->BuildRouteInfos();
+    catalogue->BuildStopRoutes();
+    if (!catalogue->ShareStopGeometry(previous)) {
+        catalogue->BuildStopIndex();
+    }
+    return catalogue;
+}
+
+}  // namespace versioned_catalogue
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "domain.h"
+#include "geo.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+namespace versioned_catalogue {
+
+// новая остановка или замена существующей с тем же названием; расстояния от заменяемой
+// остановки задаются заново, расстояния до неё от других остановок сохраняются
+struct StopChange {
+    std::string name;
+    geo::Coordinates coordinates;
+    std::vector<std::pair<std::string, uint64_t>> road_distances;
+};
+
+// новый маршрут или замена существующего с тем же названием
+struct RouteChange {
+    std::string name;
+    RouteType type = RouteType::UNKNOWN;
+    std::vector<std::string> stops;
+};
+
+// изменения справочника, которые публикуются одной версией
+struct CatalogueUpdate {
+    std::vector<StopChange> stops;
+    std::vector<RouteChange> routes;
+    // закрываемые остановки и маршруты; через закрываемую остановку не должны идти
+    // оставшиеся маршруты
+    std::vector<std::string> closed_stops;
+    std::vector<std::string> closed_routes;
+};
+
+// Version - неизменяемая версия справочника вместе с маршрутизатором, построенным по ней.
+// Маршрутизатор ссылается на справочник и объявлен после него, поэтому удаляется раньше.
+// Версия с тем же номером может быть заменена такой же версией с более быстрым маршрутизатором.
+struct Version {
+    uint64_t number = 0;
+    std::shared_ptr<const transport_catalogue::TransportCatalogue> catalogue;
+    std::shared_ptr<const transport_router::TransportRouter> router;
+};
+
+// VersionedCatalogue - справочник, который можно менять во время обработки запросов.
+// Читатель берёт текущую версию (Acquire) и отвечает по ней, сколько бы версий ни вышло
+// за это время: версия живёт, пока на неё есть ссылки. Писатель строит следующую версию
+// целиком по текущей и изменениям и публикует её атомарной заменой shared_ptr, поэтому
+// читатели никогда не ждут писателя. Писатели выполняются по одному.
+// Новая версия разделяет с предыдущей неизменившиеся названия, координаты с сеткой и пул
+// остановок маршрутов. Таблицу всех пар и иерархию сжатия публикация не ждёт: версия
+// выходит с поиском Дейкстры, а маршрутизатор из настроек строится в фоновом потоке и
+// подменяет его, если за это время не вышла следующая версия (её выход отменяет построение).
+class VersionedCatalogue {
+public:
+    // версия 0 - справочник и маршрутизатор из базы; они не принадлежат VersionedCatalogue
+    // и должны жить, пока живы он и взятые из него версии
+    VersionedCatalogue(const transport_catalogue::TransportCatalogue& base,
+                       const transport_router::TransportRouter& base_router);
+    VersionedCatalogue(const VersionedCatalogue&) = delete;
+    VersionedCatalogue& operator=(const VersionedCatalogue&) = delete;
+    // отменяет фоновое построение и дожидается потока
+    ~VersionedCatalogue();
+
+    // текущая версия
+    std::shared_ptr<const Version> Acquire() const;
+
+    // строит и публикует версию с изменениями update, возвращает её номер. При ошибке
+    // в изменениях (неизвестное название, маршрут без остановок или через закрытую остановку,
+    // расстояние вне диапазона) бросает std::invalid_argument, и текущая версия не меняется
+    uint64_t Apply(const CatalogueUpdate& update);
+
+private:
+    // читается и заменяется через std::atomic_load и std::atomic_store
+    std::shared_ptr<const Version> current_;
+    std::mutex write_mutex_;
+    // настройки маршрутизатора базы, по которым строятся маршрутизаторы версий
+    const RoutingSettings settings_;
+
+    // фоновое построение маршрутизатора из настроек; ждёт только последняя вышедшая версия
+    std::mutex build_mutex_;
+    std::condition_variable build_cv_;
+    std::shared_ptr<const Version> build_pending_;
+    bool build_stop_ = false;
+    std::atomic<bool> build_cancel_{false};
+    std::thread build_thread_;
+
+    // маршрутизатор из настроек строится долго и поэтому в фоне
+    bool IsBuiltInBackground() const;
+    void BuildLoop();
+    // строит маршрутизатор из настроек для версии, граф берётся из её маршрутизатора
+    std::shared_ptr<const transport_router::TransportRouter> BuildRouter(const Version& version) const;
+
+    static std::shared_ptr<transport_catalogue::TransportCatalogue> BuildCatalogue(
+        const transport_catalogue::TransportCatalogue& previous, const CatalogueUpdate& update);
+};
+
+}  // namespace versioned_catalogue